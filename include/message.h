@@ -5,5 +5,6 @@ enum class MESSAGE : int {
   MSG_UPDATE_NOTHING,
   MSG_UPDATE_CLOCK,
   MSG_UPDATE_DOCUMENT,
-  MSG_UPDATE_DIPLAY
+  MSG_UPDATE_DIPLAY,
+  MSG_RESTART
 };
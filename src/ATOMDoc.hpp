@@ -10,51 +10,108 @@
 #include <esp32-hal-log.h>
 
 #include <Connect.hpp>
+#include <MemoryHealth.h>
+#include <Metrics.h>
+#include <AssetBundle.h>
+#include <BoundedStream.hpp>
+#include <JmaForecast.h>
+#include <Replay.hpp>
+#include <Scheduler.hpp>
+#include <SnapshotStore.hpp>
+#include <WeatherApi.hpp>
+#include <WeatherSnapshot.h>
+#include <cmath>
 #include <memory>
 
 class ATOMDoc : public Connect {
  public:
   ATOMDoc(void) : Connect("atom_doc", "ATOM_DOC-G", 80),
+                  _lastEntry(0),
+                  _forecastFetched(false),
                   _url("https://www.jma.go.jp/bosai/forecast/data/forecast/__WEATHER_CODE__0.json"),
-                  _codeDoc(6144) {
-    // R"()" = Raw String Literals(C++)
-    _filter = R"(
-    [
-      {
-        "publishingOffice": true,
-        "reportDatetime": true,
-        "timeSeries": [
-          {
-            "timeDefines": true,
-            "areas": [
-              {
-                "area": true,
-                "weatherCodes": true,
-                "weathers": true,
-                "winds": true,
-                "waves": true
-              }
-            ]
-          }
-        ]
+                  _api((esp_random() & 0xFFFF) << 16),
+                  _codeDoc(DOC_JMA_CAPACITY) {
+    _day[0]  = '\0';
+    _time[0] = '\0';
+
+    clearSnapshot(_weather);
+
+    _scheduler.enable(SOURCE::SOURCE_JMA);
+    _scheduler.enable(SOURCE::SOURCE_THINGSPEAK);
+  }
+
+  void restoreSnapshot(void) {
+    String json;
+
+    if (_store.restore(json)) {
+      DynamicJsonDocument doc(SNAPSHOT_JSON_CAPACITY);
+
+      if (deserializeJson(doc, json) || !deserializeSnapshot(doc, _weather)) {
+        log_e("fail to restore snapshot.");
+        clearSnapshot(_weather);
+        return;
       }
-    ])";
+
+      _weather.stale = true;
+      _api.publish(_weather);
+
+      log_i("restored last snapshot. %d bytes", json.length());
+    }
+  }
+
+  // JSONを作り直すネットワークタスクから呼ぶ
+  void persistSnapshot(void) {
+    if (_weather.publishingOffice[0] == '\0') {
+      return;
+    }
+
+    _store.save(_api.prepareJson(), true);
   }
 
   void startDocAPI(void) {
+    static const char *headers[] = {"If-None-Match"};
+    _server.collectHeaders(headers, 1);
+
     _server.on("/api/v1/weather.json", [&]() {
-      _server.send(200, "application/json", _json);
+      _api.serve(_server);
     });
+
+    _server.on("/api/v1/limits.json", [&]() {
+      _server.send(200, "application/json", _api.stats());
+    });
+  }
+
+  // 公開中の天気情報を取得する
+  uint32_t getSnapshot(WeatherSnapshot &snapshot) {
+    return _api.read(snapshot);
+  }
+
+  bool isDue(void) {
+    return _scheduler.isAnyDue();
+  }
+
+  uint32_t secondsToNextFetch(void) {
+    return _scheduler.secondsToNextFetch();
   }
 
-  void requestWeatherInfomation(void) {
+  String getSchedule(void) {
+    return _scheduler.toJson();
+  }
+
+  bool requestWeatherInfomation(void) {
     log_d("Free Heap : %d", heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
 
     std::unique_ptr<WiFiClientSecure> client(new WiFiClientSecure);
+    MemoryHealth::Track               tls(SUBSYSTEM::SUBSYSTEM_TLS);
 
     client->setCACert(ts_root_ca);
     client->setHandshakeTimeout(180);
+#if defined(ATOM_TAP)
+    TapClient tap(*client, REPLAY_THINGSPEAK_PATH);
+    ThingSpeak.begin(tap);
+#else
     ThingSpeak.begin(*client);
+#endif
 
     int statusCode = ThingSpeak.readMultipleFields(1441019);
 
@@ -68,42 +125,80 @@ class ATOMDoc : public Connect {
 
       log_i("%2.1f*C, %2f%%, %4.1fhPa", degree, humidity, pressure);
 
-      _degree   = degree;
-      _humidity = humidity;
-      _pressure = pressure;
+      // 読めなかった値は前回のままにする
+      if (std::isfinite(degree)) {
+        _weather.degree = degree;
+      }
+
+      if (std::isfinite(humidity)) {
+        _weather.humidity = humidity;
+      }
+
+      if (std::isfinite(pressure)) {
+        _weather.pressure = pressure;
+      }
+
+      clampSnapshot(_weather);
+
+      _lastEntry = Scheduler::parseUtc(ThingSpeak.getCreatedAt().c_str());
+      return true;
     } else {
       log_e("Problem reading channel. HTTP error code %d", statusCode);
+      return false;
     }
   }
 
-  void requestWeatherJson(void) {
+  bool requestWeatherJson(void) {
+    Metrics::Timer timer(METRIC::METRIC_WEATHER_REQUEST);
+
     std::unique_ptr<WiFiClientSecure> _jmaClient(new WiFiClientSecure);
     std::unique_ptr<HTTPClient>       _httpClient(new HTTPClient);
+    MemoryHealth::Track               tls(SUBSYSTEM::SUBSYSTEM_TLS);
+    MemoryHealth::Track               http(SUBSYSTEM::SUBSYSTEM_HTTP);
 
     _jmaClient->setCACert(jma_root_ca);
     _jmaClient->setHandshakeTimeout(180);
     _httpClient->setReuse(true);
     _url.replace("__WEATHER_CODE__", String(_localGovernmentCode));
 
+#if !defined(ATOM_REPLAY)
+    // TLSハンドシェイクを先に済ませておく。HTTPClientは接続済みのクライアントを再利用する
+    {
+      Metrics::Timer handshake(METRIC::METRIC_TLS_HANDSHAKE);
+      _jmaClient->connect("www.jma.go.jp", 443);
+    }
+#endif
+
+#if defined(ATOM_TAP)
+    TapClient tap(*_jmaClient, REPLAY_JMA_PATH);
+    _httpClient->begin(tap, _url.c_str());
+#else
     _httpClient->begin(*_jmaClient, _url.c_str());
+#endif
 
     int httpCode = _httpClient->GET();
     if (httpCode > 0) {
       if (httpCode == HTTP_CODE_OK) {
-        ReadLoggingStream loggingStream(_httpClient->getStream(), Serial);
+        int size = _httpClient->getSize();
+        if (size > DOC_JMA_MAX_BYTES) {
+          log_e("response too large. %d bytes", size);
+          _httpClient->end();
+          return false;
+        }
+
+        BoundedStream     bounded(_httpClient->getStream(), DOC_JMA_MAX_BYTES, DOC_JMA_MAX_MS);
+        ReadLoggingStream loggingStream(bounded, Serial);
 
-        StaticJsonDocument<500> codeFilter;
-        deserializeJson(codeFilter, _filter.c_str());
-        DeserializationError error = deserializeJson(_codeDoc, loggingStream, DeserializationOption::Filter(codeFilter));
+        DeserializationError error = readJmaForecast(_codeDoc, loggingStream);
 
         if (error) {
-          log_e("deserializeJson() failed: %s", error.f_str());
+          log_e("deserializeJson() failed: %s, %d bytes", error.f_str(), bounded.count());
           _httpClient->end();
-          return;
+          return false;
         }
 
         _httpClient->end();
-        return;
+        return true;
       }
     }
 
@@ -111,218 +206,178 @@ class ATOMDoc : public Connect {
     _httpClient->end();
 
     log_e("[HTTP] GET... failed, error: %s", error.c_str());
-    return;
+    return false;
   }
 
-  void parseWeatherJson(void) {
-    JsonObject root_0 = _codeDoc[0];  // 0 or 1
-
-    if (!root_0.isNull()) {
-      const char *publishingOffice = root_0["publishingOffice"];
-      const char *reportDatetime   = root_0["reportDatetime"];
-
-      _publishingOffice = (const char *)publishingOffice;
-      _reportDatetime   = (const char *)reportDatetime;
+  bool parseWeatherJson(void) {
+    Metrics::Timer timer(METRIC::METRIC_WEATHER_PARSE);
 
-      Serial.println("publishingOffice  " + _publishingOffice);
-      Serial.println("  reportDatetime  " + _reportDatetime);
-
-      JsonArray timeSeries = root_0["timeSeries"];
-
-      if (!timeSeries.isNull()) {
-        const char *timedef = timeSeries[0]["timeDefines"][0];
-
-        JsonObject  areas_0   = timeSeries[0]["areas"][0];
-        const char *area_name = areas_0["area"]["name"];
-        const char *area_code = areas_0["area"]["code"];
-
-        _timeDef  = (const char *)timedef;
-        _areaName = (const char *)area_name;
-        _areaCode = (const char *)area_code;
-        // Serial.println("       area_name  " + String((const char *)area_name));
-        // Serial.println("       area_code  " + String((const char *)area_code));
-
-        JsonArray weatherCodes = areas_0["weatherCodes"];
-        JsonArray weathers     = areas_0["weathers"];
-        JsonArray winds        = areas_0["winds"];
-        JsonArray waves        = areas_0["waves"];
-
-        if (!weatherCodes.isNull()) {
-          _todayForecast = (const char *)weatherCodes[0];
-        }
-
-        if (!weathers.isNull()) {
-          _weathers0 = (const char *)weathers[0];
-        }
-
-        if (!winds.isNull()) {
-          _winds0 = (const char *)winds[0];
-        }
+    if (!parseJmaForecast(_codeDoc, _weather)) {
+      return false;
+    }
 
-        if (!waves.isNull()) {
-          _waves0 = (const char *)waves[0];
-        }
-      }
+    lookupCode(_weather);
+    return true;
+  }
 
-      //天気予報コードより、予報文言とアイコンファイル名を取得する
-      String filter(R"({"__CODE__": [true]})");
-      filter.replace("__CODE__", _todayForecast);
+  //天気予報コードより、予報文言とアイコンファイル名を取得する
+  static bool lookupCode(WeatherSnapshot &weather) {
+    // アセットのパーティションにあれば、フラッシュ上のデータをそのまま読む
+    Asset asset;
 
-      StaticJsonDocument<255> forecastDoc;
-      StaticJsonDocument<50>  forecastfilter;
-      deserializeJson(forecastfilter, filter);
+    if (AssetBundle::load("/codes.json", asset)) {
+      return lookupWeatherCode(weather, (const char *)asset.data, asset.size);
+    }
 
-      File file = SPIFFS.open("/codes.json");
+    File file = SPIFFS.open("/codes.json");
 
-      if (file) {
-        DeserializationError error = deserializeJson(forecastDoc,
-                                                     file,
-                                                     DeserializationOption::Filter(forecastfilter));
+    if (!file) {
+      return false;
+    }
 
-        if (error) {
-          log_e("Failed to read codes.json.");
-          file.close();
-          return;
-        }
+    bool result = lookupWeatherCode(weather, file);
+    file.close();
 
-        JsonArray root = forecastDoc[_todayForecast.c_str()];
+    return result;
+  }
 
-        if (!root.isNull()) {
-          _iconFile   = String("/") + String((const char *)root[0]);  // "100.gif"
-          _forecastJP = (const char *)root[3];                        // "晴"
-          _forecastEN = (const char *)root[4];                        // "CLEAR"
+  // 取得した天気情報を公開する。取得に成功した時だけ呼ぶ
+  void saveJson(void) {
+    if (_weather.publishingOffice[0] == '\0') {
+      // まだ一度も取得できていない。復元したスナップショットをそのまま使う
+      return;
+    }
 
-          // log_d("アイコンファイル名:%s\n予報（日本語）:%s\n予報（英語）:%s", _iconFile.c_str(), _forecastJP.c_str(), _forecastEN.c_str());
-        }
+    // 復元した予報は、この起動で予報を取得できるまで古いまま
+    _weather.stale = !_forecastFetched;
+    _api.publish(_weather);
 
-        file.close();
-      }
-    }
-  }
+    const String &json = _api.prepareJson();
+    _store.save(json);
 
-  void saveJson(void) {
-    String json(R"({"publishingOffice": "__OFFICE__", "reportDatetime": "__REPORT__", "timeSeries": [{"timeDefines": "__TIMEDEF__", "areas": [{"area": "__AREA__", "weatherCodes": "__CODES__", "weathers_jp": "__WEATHERSJP__", "weathers_en": "__WEATHERSEN__", "winds": "__WINDS__", "waves": "__WAVES__", "degree": __DEGREE__, "humidity": __HUMID__, "pressure": __PRESS__}]}]})");
-
-    json.replace("__OFFICE__", _publishingOffice);
-    json.replace("__REPORT__", _reportDatetime);
-    json.replace("__TIMEDEF__", _timeDef);
-    json.replace("__AREA__", _areaName);
-    json.replace("__CODES__", _todayForecast);
-    json.replace("__WEATHERSJP__", _forecastJP);
-    json.replace("__WEATHERSEN__", _forecastEN);
-    json.replace("__WINDS__", _winds0);
-    json.replace("__WAVES__", _waves0);
-    json.replace("__DEGREE__", String(_degree));
-    json.replace("__HUMID__", String(_humidity));
-    json.replace("__PRESS__", String(_pressure));
-
-    _json = json;
-
-    log_i("%s", _json.c_str());
+    log_i("%s", json.c_str());
   }
 
   void setAreaCode(uint16_t localGovernmentCode) {
     _localGovernmentCode = localGovernmentCode;
   }
 
-  void setDayTime(String day, String time) {
-    _day  = day;
-    _time = time;
+  void begin(void) {
+    startWiFi();
   }
 
-  String getTodayForecast(void) {
-    return _todayForecast;
+  // 画面が無いので、境界の時刻は使わない
+  void setDayTime(String day, String time, uint32_t boundary) {
+    strlcpy(_day, day.c_str(), sizeof(_day));
+    strlcpy(_time, time.c_str(), sizeof(_time));
   }
 
-  String getNextdayForecast(void) {
-    return _nextdayForecast;
+  String getTodayForecast(void) {
+    return _weather.weatherCodes;
   }
 
   String getWeathersJp(void) {
-    return _forecastJP;
+    return _weather.weathersJP;
   }
 
   String getWeathersEn(void) {
-    return _forecastEN;
+    return _weather.weathersEN;
   }
 
   String getICONFilename(void) {
-    return _iconFile;
+    return _weather.iconFile;
   }
 
   void update(void) {
     switch (_message) {
-      case MESSAGE::MSG_UPDATE_DOCUMENT:
-        requestWeatherInfomation();
-        requestWeatherJson();
-        parseWeatherJson();
-        saveJson();
+      case MESSAGE::MSG_UPDATE_DOCUMENT: {
+        //発表の周期に合わせて、必要な取得元だけ取得する
+        bool fetched = false;
+
+        if (_scheduler.isDue(SOURCE::SOURCE_THINGSPEAK)) {
+          _scheduler.started(SOURCE::SOURCE_THINGSPEAK);
+          if (requestWeatherInfomation()) {
+            _scheduler.succeeded(SOURCE::SOURCE_THINGSPEAK, _lastEntry);
+            fetched = true;
+          } else {
+            _scheduler.failed(SOURCE::SOURCE_THINGSPEAK);
+          }
+        }
+
+        if (_scheduler.isDue(SOURCE::SOURCE_JMA)) {
+          _scheduler.started(SOURCE::SOURCE_JMA);
+          if (requestWeatherJson() && parseWeatherJson()) {
+            _scheduler.succeeded(SOURCE::SOURCE_JMA);
+            _forecastFetched = true;
+            fetched          = true;
+          } else {
+            _scheduler.failed(SOURCE::SOURCE_JMA);
+          }
+        }
+
+        _weather.nextUpdate = _scheduler.nextUpdate();
+
+        // どちらも失敗した時は、公開中のデータ(復元したものならstaleのまま)を変えない
+        if (fetched) {
+          saveJson();
+        }
 
         _debugPrint();
 
         log_i("MESSAGE::MSG_UPDATE_DOCUMENT");
         sendMessage(MESSAGE::MSG_UPDATE_NOTHING);
         break;
+      }
+      case MESSAGE::MSG_RESTART:
+        log_w("restart.");
+        persistSnapshot();
+        MemoryHealth::restarting();
+        ESP.restart();
+        break;
       default:
         break;
     }
 
+    Metrics::Timer timer(METRIC::METRIC_HANDLE_CLIENT);
     _portal.handleClient();
   }
 
  private:
   void _debugPrint(void) {
-    log_i("%s, %s", _day.c_str(), _time.c_str());
+    log_i("%s, %s", _day, _time);
     log_i("%s", _url.c_str());
 
-    log_i("%s, %s, %s, %s, %s",
-          _publishingOffice.c_str(),
-          _reportDatetime.c_str(),
-          _areaName.c_str(),
-          _areaCode.c_str(),
-          _todayForecast.c_str());
-
-    log_i("%s, %s, %s, %s, %s, %s, %f, %f, %f",
-          _weathers0.c_str(),
-          _winds0.c_str(),
-          _waves0.c_str(),
-          _forecastJP.c_str(),
-          _forecastEN.c_str(),
-          _iconFile.c_str(),
-          _degree,
-          _humidity,
-          _pressure);
+    log_i("%s, %s, %s, %s",
+          _weather.publishingOffice,
+          _weather.reportDatetime,
+          _weather.area,
+          _weather.weatherCodes);
+
+    log_i("%s, %s, %s, %s, %s, %f, %f, %f",
+          _weather.winds,
+          _weather.waves,
+          _weather.weathersJP,
+          _weather.weathersEN,
+          _weather.iconFile,
+          _weather.degree,
+          _weather.humidity,
+          _weather.pressure);
   }
 
-  String _day;
-  String _time;
-
-  uint16_t _localGovernmentCode;
-  String   _request;
-  String   _response;
-  String   _url;
-  String   _json;
-
-  String _publishingOffice;
-  String _reportDatetime;
-  String _timeDef;
-  String _areaName;
-  String _areaCode;
-  String _todayForecast;
-  String _nextdayForecast;
-  String _weathers0;
-  String _weathers1;
-  String _winds0;
-  String _waves0;
-  String _forecastJP;
-  String _forecastEN;
-  String _iconFile;
-
-  float _degree;
-  float _humidity;
-  float _pressure;
-
-  String _filter;
+  char _day[24];
+  char _time[16];
+
+  uint16_t  _localGovernmentCode;
+  Scheduler _scheduler;
+  time_t    _lastEntry;
+  bool      _forecastFetched;  // この起動で予報を取得できた
+
+  String _url;
+
+  // ネットワークタスクで更新し、_apiで公開する。版は起動ごとに違う値から始める
+  WeatherSnapshot _weather;
+  WeatherApi      _api;
 
   DynamicJsonDocument _codeDoc;
+  SnapshotStore       _store;
 };
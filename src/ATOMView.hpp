@@ -9,45 +9,168 @@
 #include <WiFiClient.h>
 #include <esp32-hal-log.h>
 
+#include <BoundedStream.hpp>
 #include <Connect.hpp>
+#include <MemoryHealth.h>
+#include <Metrics.h>
+#include <PowerProfile.h>
+#include <Replay.hpp>
+#include <Scheduler.hpp>
+#include <SnapshotStore.hpp>
+#include <WeatherSnapshot.h>
 #include <memory>
 
+#ifndef VIEW_DOC_MAX_MS
+#define VIEW_DOC_MAX_MS 3000
+#endif
+
 class ATOMView : public Connect {
  public:
   ATOMView() : Connect("atom_view", "ATOM_VIEW-G", 80),
-               _doc(600),
-               _apiURI("/api/v1/weather.json") {
+               _doc(SNAPSHOT_JSON_CAPACITY),
+               _apiURI("/api/v1/weather.json"),
+               _restored(false),
+               _lastFresh(0),
+               _docStale(false),
+               _applied(false),
+               _revision(0),
+               _unchanged(false),
+               _fulls(0),
+               _deltas(0),
+               _unchangedCount(0),
+               _bytesFull(0),
+               _bytesDelta(0) {
+    clearSnapshot(_weather);
+    clearSnapshot(_shown);
+
+    _scheduler.enable(SOURCE::SOURCE_DOC);
+  }
+
+  void restoreSnapshot(void) {
+    String json;
+
+    if (_store.restore(json)) {
+      DeserializationError error = deserializeJson(_doc, json);
+
+      if (error) {
+        log_e("fail to restore snapshot: %s", error.c_str());
+        return;
+      }
+
+      parseWeatherJson();
+      _restored = true;
+    }
+  }
+
+  // _weatherを書き換えるネットワークタスクから呼ぶ
+  void persistSnapshot(void) {
+    _saveSnapshot(true);
   }
 
   void begin(void) {
     _disp.begin();
-    Connect::begin(SECRET_SSID, SECRET_PASS);
+
+    //ネットワークに繋がる前に、前回の天気を表示する
+    _applyDisplay(_restored);
+    _disp.startRender();
+
+    startWiFi();
+  }
+
+  // ?overlay=1 で画面にプロファイラの値を重ねる
+  void startDisplayAPI(void) {
+    _server.on("/api/v1/display.json", [&]() {
+      if (_server.hasArg("overlay")) {
+        _disp.setOverlay(_server.arg("overlay") == "1");
+      }
+      _server.send(200, "application/json", _disp.getProfile());
+    });
   }
 
   void sendMessage(MESSAGE message) {
     _message = message;
   }
 
-  void setDayTime(String day, String time) {
-    _day  = day;
-    _time = time;
-    sendMessage(MESSAGE::MSG_UPDATE_CLOCK);
+  void setDayTime(String day, String time, uint32_t boundary) {
+    _disp.setDayTime(day, time, boundary);
+  }
+
+  bool isDue(void) {
+    return _scheduler.isAnyDue();
+  }
+
+  uint32_t secondsToNextFetch(void) {
+    return _scheduler.secondsToNextFetch();
   }
 
-  void requestWeatherJson(void) {
+  String getSchedule(void) {
+    return _scheduler.toJson();
+  }
+
+  bool requestWeatherJson(void) {
+    Metrics::Timer timer(METRIC::METRIC_WEATHER_REQUEST);
+
     std::unique_ptr<HTTPClient> http(new HTTPClient);
     std::unique_ptr<WiFiClient> client(new WiFiClient);
+    MemoryHealth::Track         track(SUBSYSTEM::SUBSYSTEM_HTTP);
 
+    // 今の版を送り、変わったフィールドだけを受け取る
+    String uri(_apiURI);
+    if (_revision && !_restored) {
+      uri += "?since=" + String(_revision);
+    }
+
+#if defined(ATOM_REPLAY)
+    // Docを探しに行かない。宛先は何でもよい
+    IPAddress ip(127, 0, 0, 1);
+#else
     IPAddress ip(MDNS.queryHost("atom_doc"));
-    log_i("%s", ip.toString().c_str());
-    http->begin(*client, ip.toString(), 80, _apiURI.c_str());
+#endif
+    log_i("%s%s", ip.toString().c_str(), uri.c_str());
+#if defined(ATOM_TAP)
+    TapClient tap(*client, REPLAY_DOC_PATH);
+    http->begin(tap, ip.toString(), 80, uri.c_str());
+#else
+    http->begin(*client, ip.toString(), 80, uri.c_str());
+#endif
 
-    int httpCode = http->GET();
+    bool result   = false;
+    int  httpCode = http->GET();
+    _unchanged    = false;
     if (httpCode > 0) {
-      if (httpCode == HTTP_CODE_OK) {
-        ReadLoggingStream loggingStream(http->getStream(), Serial);
+      if (httpCode == HTTP_CODE_NOT_MODIFIED) {
+        _unchanged = true;
+        _unchangedCount++;
+        result = true;
+      } else if (httpCode == HTTP_CODE_OK) {
+        int size = http->getSize();
+
+        // 壊れた応答や大きすぎる応答は、決まった量と時間で読むのをやめる
+        BoundedStream     bounded(http->getStream(), VIEW_DOC_MAX_BYTES, VIEW_DOC_MAX_MS);
+        ReadLoggingStream loggingStream(bounded, Serial);
         _doc.clear();
-        deserializeJson(_doc, loggingStream);
+
+        DeserializationError error = DeserializationError::Ok;
+        if (size > VIEW_DOC_MAX_BYTES) {
+          log_e("response too large. %d bytes", size);
+          error = DeserializationError::NoMemory;
+        } else {
+          error = deserializeJson(_doc, loggingStream, DeserializationOption::NestingLimit(VIEW_DOC_NESTING));
+        }
+
+        if (error) {
+          log_e("deserializeJson() failed: %s, %d bytes", error.c_str(), bounded.count());
+        } else {
+          result = true;
+
+          if (_doc["delta"] | false) {
+            _deltas++;
+            _bytesDelta += size > 0 ? size : 0;
+          } else {
+            _fulls++;
+            _bytesFull += size > 0 ? size : 0;
+          }
+        }
       }
     } else {
       String error(http->errorToString(httpCode));
@@ -55,97 +178,135 @@ class ATOMView : public Connect {
     }
 
     http->end();
-    return;
+    return result;
   }
 
   void parseWeatherJson(void) {
-    _publishingOffice = (const char*)_doc["publishingOffice"];  // "大阪管区気象台"
-    _reportDatetime   = (const char*)_doc["reportDatetime"];    // "2022-05-06T17:00:00+09:00"
-    _timeDefines      = (const char*)_doc["timeSeries"][0]["timeDefines"];
-
-    JsonObject areas_0 = _doc["timeSeries"][0]["areas"][0];
-    if (!areas_0.isNull()) {
-      _area         = (const char*)areas_0["area"];          // "大阪府"
-      _weatherCodes = (const char*)areas_0["weatherCodes"];  // "100"
-      _weathers_jp  = (const char*)areas_0["weathers_jp"];   // "晴"
-      _weathers_en  = (const char*)areas_0["weathers_en"];   // "CLEAR"
-      _winds        = (const char*)areas_0["winds"];         // "南西の風　後　北東の風"
-      _waves        = (const char*)areas_0["waves"];         // "０．５メートル"
-      _degree       = (float)areas_0["degree"];              // 25.4
-      _humidity     = (float)areas_0["humidity"];            // 44.5
-      _pressure     = (float)areas_0["pressure"];            // 1017.2
+    Metrics::Timer timer(METRIC::METRIC_WEATHER_PARSE);
+
+    // staleは表示用に上書きしているので、ATOM Docから受け取った値に戻してから適用する
+    _weather.stale = _docStale;
+
+    if (deserializeSnapshot(_doc, _weather)) {
+      _revision = _doc["revision"] | 0u;
+      _docStale = _weather.stale;
 
       log_i("%s, %s, %s, %s, %s",
-            _publishingOffice.c_str(),
-            _reportDatetime.c_str(),
-            _timeDefines.c_str(),
-            _area.c_str(),
-            _weatherCodes.c_str());
+            _weather.publishingOffice,
+            _weather.reportDatetime,
+            _weather.timeDefines,
+            _weather.area,
+            _weather.weatherCodes);
 
       log_i("%s, %s, %s, %s, %2.1f, %2.0f, %4.1f",
-            _weathers_jp.c_str(),
-            _weathers_en.c_str(),
-            _winds.c_str(),
-            _waves.c_str(),
-            _degree,
-            _humidity,
-            _pressure);
+            _weather.weathersJP,
+            _weather.weathersEN,
+            _weather.winds,
+            _weather.waves,
+            _weather.degree,
+            _weather.humidity,
+            _weather.pressure);
     }
   }
 
   void update(void) {
     switch (_message) {
-      case MESSAGE::MSG_UPDATE_DOCUMENT:
-        requestWeatherJson();
-        parseWeatherJson();
-
-        _disp.setDegree(_degree);
-        _disp.setHumidity(_humidity);
-        _disp.setAtomPressure(_pressure);
-        _disp.setWeatherforcastJP(_weathers_jp);
-        _disp.setWeatherforcastEN(_weathers_en);
-        // _disp.setImageFilename(_filename);
+      case MESSAGE::MSG_UPDATE_DOCUMENT: {
+        _scheduler.started(SOURCE::SOURCE_DOC);
+
+        PowerProfile::beginNetwork();
+        bool result = requestWeatherJson();
+        PowerProfile::endNetwork();
+
+        if (result) {
+          if (!_unchanged) {
+            parseWeatherJson();
+            _saveSnapshot();
+          }
+          _restored  = false;
+          _lastFresh = millis();
+
+          // ATOM Docが次に更新する時刻に合わせる
+          _scheduler.succeeded(SOURCE::SOURCE_DOC, _weather.nextUpdate);
+        } else {
+          _scheduler.failed(SOURCE::SOURCE_DOC);
+        }
+
+        _applyDisplay(_restored || (millis() - _lastFresh) > SNAPSHOT_STALE_MS);
         log_i("MESSAGE::MSG_UPDATE_DOCUMENT");
         sendMessage(MESSAGE::MSG_UPDATE_NOTHING);
-        break;
-      case MESSAGE::MSG_UPDATE_CLOCK:
-        _disp.setYMD(_day);
-        _disp.setNtpTime(_time);
-        // log_i("MESSAGE::MSG_UPDATE_CLOCK");
-        sendMessage(MESSAGE::MSG_UPDATE_NOTHING);
+      } break;
+      case MESSAGE::MSG_RESTART:
+        log_w("restart.");
+        persistSnapshot();
+        MemoryHealth::restarting();
+        ESP.restart();
         break;
       default:
         break;
     }
 
+    Metrics::Timer timer(METRIC::METRIC_HANDLE_CLIENT);
     _portal.handleClient();
-    _disp.update();
+  }
+
+  String getTransfer(void) {
+    DynamicJsonDocument doc(192);
 
-    delay(1);
+    doc["revision"]   = _revision;
+    doc["full"]       = _fulls;
+    doc["delta"]      = _deltas;
+    doc["unchanged"]  = _unchangedCount;
+    doc["bytesFull"]  = _bytesFull;
+    doc["bytesDelta"] = _bytesDelta;
+
+    String json;
+    serializeJson(doc, json);
+
+    return json;
   }
 
  private:
-  Display             _disp;
-  DynamicJsonDocument _doc;
+  // 変わったフィールドだけを描き直してもらう
+  // ATOM Docのデータが古い時も、古いデータとして表示する
+  void _applyDisplay(bool stale) {
+    _weather.stale = stale || _docStale;
 
-  String _day;
-  String _time;
-
-  String _publishingOffice;
-  String _reportDatetime;
-  String _timeDefines;
-  String _area;
-  String _weatherCodes;
-  String _weathers_jp;
-  String _weathers_en;
-  String _winds;
-  String _waves;
+    uint32_t fields = diffSnapshot(_shown, _weather);
+    if (fields || !_applied) {
+      _disp.setWeather(_weather, _applied ? fields : SNAPSHOT_ALL_FIELDS);
+      _shown   = _weather;
+      _applied = true;
+    }
+  }
 
-  float _degree;
-  float _humidity;
-  float _pressure;
+  void _saveSnapshot(bool force = false) {
+    String json;
+    if (serializeSnapshot(_weather, json)) {
+      _store.save(json, force);
+    }
+  }
 
-  String _imageName;
+  Display             _disp;
+  DynamicJsonDocument _doc;
+  SnapshotStore       _store;
+  WeatherSnapshot     _weather;
+  Scheduler           _scheduler;
 
   String _apiURI;
+
+  bool     _restored;
+  uint32_t _lastFresh;
+  bool     _docStale;  // ATOM Docが前回起動時のデータを配っている
+
+  // 差分の受信
+  WeatherSnapshot _shown;  // Displayへ渡した内容
+  bool            _applied;
+  uint32_t        _revision;
+  bool            _unchanged;
+  uint32_t        _fulls;
+  uint32_t        _deltas;
+  uint32_t        _unchangedCount;
+  uint32_t        _bytesFull;
+  uint32_t        _bytesDelta;
 };
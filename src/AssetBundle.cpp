@@ -0,0 +1,186 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#include <ArduinoJson.h>
+#include <AssetBundle.h>
+#include <MemoryHealth.h>
+#include <esp32-hal-log.h>
+#include <esp_partition.h>
+#include <rom/crc.h>
+#include <rom/miniz.h>
+
+#include <new>
+
+const uint8_t    *AssetBundle::_base     = nullptr;
+const AssetEntry *AssetBundle::_entries  = nullptr;
+uint16_t          AssetBundle::_count    = 0;
+uint32_t          AssetBundle::_inflated = 0;
+
+bool AssetBundle::begin(const char *label) {
+  const esp_partition_t *partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA,
+                                                              ESP_PARTITION_SUBTYPE_ANY,
+                                                              label);
+  if (partition == nullptr) {
+    log_w("no %s partition.", label);
+    return false;
+  }
+
+  // 外さずに使い続ける
+  const void             *ptr = nullptr;
+  spi_flash_mmap_handle_t handle;
+  esp_err_t               err = esp_partition_mmap(partition, 0, partition->size, SPI_FLASH_MMAP_DATA, &ptr, &handle);
+  if (err != ESP_OK) {
+    log_e("fail to map %s. %d", label, err);
+    return false;
+  }
+
+  const uint8_t     *base   = static_cast<const uint8_t *>(ptr);
+  const AssetHeader *header = reinterpret_cast<const AssetHeader *>(base);
+
+  if (memcmp(header->magic, ASSET_MAGIC, sizeof(header->magic)) != 0 || header->version != ASSET_VERSION) {
+    log_w("%s has no asset bundle.", label);
+    spi_flash_munmap(handle);
+    return false;
+  }
+
+  // 索引とデータがパーティションに収まっているか、一度だけ確かめる
+  const AssetEntry *entries = reinterpret_cast<const AssetEntry *>(base + sizeof(AssetHeader));
+  size_t            index   = sizeof(AssetHeader) + header->count * sizeof(AssetEntry);
+
+  bool valid = header->size <= partition->size && index <= header->size;
+  for (int i = 0; valid && i < header->count; i++) {
+    const AssetEntry &entry = entries[i];
+    valid = entry.offset >= index && entry.offset <= header->size && entry.offset % 4 == 0 &&
+            entry.size <= header->size - entry.offset &&
+            memchr(entry.name, '\0', sizeof(entry.name)) != nullptr &&
+            (i == 0 || strcmp(entries[i - 1].name, entry.name) < 0);
+  }
+
+  if (!valid) {
+    log_e("broken asset bundle in %s.", label);
+    spi_flash_munmap(handle);
+    return false;
+  }
+
+  _base    = base;
+  _entries = entries;
+  _count   = header->count;
+
+  log_i("%d assets, %d bytes mapped at %p", _count, header->size, _base);
+  return true;
+}
+
+bool AssetBundle::isMounted(void) {
+  return _base != nullptr;
+}
+
+const AssetEntry *AssetBundle::find(const char *name) {
+  int low  = 0;
+  int high = (int)_count - 1;
+
+  while (low <= high) {
+    int mid   = (low + high) / 2;
+    int order = strcmp(_entries[mid].name, name);
+
+    if (order == 0) {
+      return &_entries[mid];
+    } else if (order < 0) {
+      low = mid + 1;
+    } else {
+      high = mid - 1;
+    }
+  }
+
+  return nullptr;
+}
+
+bool AssetBundle::load(const char *name, Asset &asset) {
+  const AssetEntry *entry = find(name);
+  if (entry == nullptr) {
+    return false;
+  }
+
+  if (entry->flags & ASSET_FLAG_DEFLATE) {
+    return _inflate(*entry, asset);
+  }
+
+  asset.data = _base + entry->offset;
+  asset.size = entry->size;
+  asset.buffer.reset();
+  return true;
+}
+
+// ROMのminizで展開する。展開器は11KBほどあるので、タスクのスタックには置かない
+bool AssetBundle::_inflate(const AssetEntry &entry, Asset &asset) {
+  std::unique_ptr<uint8_t[]>          buffer(new (std::nothrow) uint8_t[entry.rawSize]);
+  std::unique_ptr<tinfl_decompressor> inflator(new (std::nothrow) tinfl_decompressor);
+
+  if (!buffer || !inflator) {
+    MemoryHealth::failed(SUBSYSTEM::SUBSYSTEM_ASSET);
+    log_e("fail to inflate %s. %d bytes", entry.name, entry.rawSize);
+    return false;
+  }
+
+  tinfl_init(inflator.get());
+
+  size_t       in     = entry.size;
+  size_t       out    = entry.rawSize;
+  tinfl_status status = tinfl_decompress(inflator.get(),
+                                         _base + entry.offset, &in,
+                                         buffer.get(), buffer.get(), &out,
+                                         TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+
+  if (status != TINFL_STATUS_DONE || out != entry.rawSize || crc32_le(0, buffer.get(), out) != entry.crc) {
+    log_e("broken asset %s. status %d", entry.name, status);
+    return false;
+  }
+
+  _inflated++;
+
+  asset.data   = buffer.get();
+  asset.size   = out;
+  asset.buffer = std::move(buffer);
+  return true;
+}
+
+String AssetBundle::toJson(void) {
+  DynamicJsonDocument doc(256 + _count * 96);
+
+  doc["mounted"]  = isMounted();
+  doc["inflated"] = _inflated;
+
+  JsonArray assets = doc.createNestedArray("assets");
+  for (int i = 0; i < _count; i++) {
+    JsonObject asset    = assets.createNestedObject();
+    asset["name"]       = _entries[i].name;
+    asset["size"]       = _entries[i].size;
+    asset["rawSize"]    = _entries[i].rawSize;
+    asset["compressed"] = (_entries[i].flags & ASSET_FLAG_DEFLATE) != 0;
+  }
+
+  String json;
+  serializeJson(doc, json);
+  return json;
+}
@@ -0,0 +1,91 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <memory>
+
+// アセットを置くパーティションの名前。partitions_assets.csvと合わせる
+#ifndef ASSET_PARTITION
+#define ASSET_PARTITION "assets"
+#endif
+
+#define ASSET_MAGIC   "ATAB"
+#define ASSET_VERSION 1
+
+#define ASSET_FLAG_DEFLATE 0x01
+
+// tools/asset_bundle.py が作る形式。すべてリトルエンディアン
+//   ヘッダ
+//   索引  名前順にcount個
+//   データ 4バイト境界に揃えて並ぶ。offsetは先頭から
+struct AssetHeader {
+  char     magic[4];
+  uint16_t version;
+  uint16_t count;
+  uint32_t size;  // ヘッダからデータの終わりまで
+  uint32_t reserved;
+};
+
+struct AssetEntry {
+  char     name[44];  // "/codes.json"
+  uint32_t offset;
+  uint32_t size;      // 格納した大きさ
+  uint32_t rawSize;   // 展開した大きさ
+  uint32_t flags;
+  uint32_t crc;       // 展開したデータのCRC32
+};
+
+static_assert(sizeof(AssetHeader) == 16, "AssetHeader must match tools/asset_bundle.py");
+static_assert(sizeof(AssetEntry) == 64, "AssetEntry must match tools/asset_bundle.py");
+
+// 圧縮していなければフラッシュ上を直接指す。圧縮していれば展開したバッファを持つ
+struct Asset {
+  const uint8_t             *data;
+  size_t                     size;
+  std::unique_ptr<uint8_t[]> buffer;
+};
+
+// パーティション全体をメモリにマップし、名前の検索は索引の二分探索だけで済ませる
+class AssetBundle {
+ public:
+  static bool begin(const char *label = ASSET_PARTITION);
+  static bool isMounted(void);
+
+  static const AssetEntry *find(const char *name);
+  static bool              load(const char *name, Asset &asset);
+
+  static String toJson(void);
+
+ private:
+  static bool _inflate(const AssetEntry &entry, Asset &asset);
+
+  static const uint8_t     *_base;
+  static const AssetEntry  *_entries;
+  static uint16_t           _count;
+  static uint32_t           _inflated;
+};
@@ -0,0 +1,197 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#if defined(ATOM_BENCHMARK)
+
+#include <ArduinoJson.h>
+#include <Benchmark.h>
+
+#include <algorithm>
+
+#if defined(ARDUINO_ARCH_ESP32)
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+static int64_t benchmarkMicros(void) {
+  return esp_timer_get_time();
+}
+#else
+#include <chrono>
+#include <cstdio>
+#include <new>
+
+// テストの時計(hostMicros)は進まないので、実際の時間を計る
+static int64_t benchmarkMicros(void) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+#endif
+
+std::vector<Benchmark::Result> Benchmark::_results;
+
+volatile uint32_t Benchmark::_allocs     = 0;
+volatile uint32_t Benchmark::_allocBytes = 0;
+
+extern "C" {
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  Benchmark::countAllocation(size);
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  Benchmark::countAllocation(n * size);
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  Benchmark::countAllocation(size);
+  return __real_realloc(ptr, size);
+}
+}
+
+#if !defined(ARDUINO_ARCH_ESP32)
+// libstdc++の中から呼ぶmallocは--wrapで置き換わらないので、newはここでmallocへ回す
+void *operator new(size_t size) {
+  void *ptr = malloc(size);
+  if (ptr == nullptr) {
+    throw std::bad_alloc();
+  }
+  return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+  free(ptr);
+}
+
+void operator delete(void *ptr, size_t size) noexcept {
+  free(ptr);
+}
+#endif
+
+void Benchmark::countAllocation(size_t size) {
+  _allocs     = _allocs + 1;
+  _allocBytes = _allocBytes + size;
+}
+
+void Benchmark::run(const char *name, std::function<void(void)> op, int iterations, size_t bytes) {
+  std::vector<uint32_t> samples;
+  samples.reserve(iterations);
+
+  op();
+
+  uint32_t allocs     = _allocs;
+  uint32_t allocBytes = _allocBytes;
+
+  for (int i = 0; i < iterations; i++) {
+    int64_t start = benchmarkMicros();
+    op();
+    samples.push_back(benchmarkMicros() - start);
+  }
+
+  allocs     = _allocs - allocs;
+  allocBytes = _allocBytes - allocBytes;
+
+  std::sort(samples.begin(), samples.end());
+
+  Result result;
+  result.name       = name;
+  result.iterations = iterations;
+  result.bytes      = bytes;
+  result.min        = samples.front();
+  result.median     = samples[samples.size() / 2];
+  result.p99        = samples[std::min(samples.size() - 1, samples.size() * 99 / 100)];
+  result.max        = samples.back();
+  result.allocs     = (float)allocs / iterations;
+  result.allocBytes = (float)allocBytes / iterations;
+
+  // 結果を残すための確保は数えない
+  _results.push_back(result);
+
+  // 1画素1バイトなので、描画のケースではMB/sがMpixel/sになる
+  float throughput = result.median ? (float)bytes / result.median : 0.0f;
+
+#if defined(ARDUINO_ARCH_ESP32)
+  log_i("%-24s median %6d us, p99 %6d us, %.1f allocs/op, %.1f MB/s",
+        name, result.median, result.p99, result.allocs, throughput);
+#else
+  printf("%-28s median %6u us, p99 %6u us, %.1f allocs/op, %.1f MB/s\n",
+         name, result.median, result.p99, result.allocs, throughput);
+#endif
+}
+
+uint32_t Benchmark::median(const char *name) {
+  for (const auto &result : _results) {
+    if (result.name == name) {
+      return result.median;
+    }
+  }
+  return 0;
+}
+
+String Benchmark::toJson(void) {
+  // 名前はc_str()のまま持つので、文字列の分は要らない。64bitのホストでは値の大きさが倍になる
+  DynamicJsonDocument doc(JSON_OBJECT_SIZE(6) + JSON_ARRAY_SIZE(_results.size()) +
+                          _results.size() * JSON_OBJECT_SIZE(9));
+
+  doc["unit"] = "us";
+#if defined(ARDUINO_ARCH_ESP32)
+  doc["platform"] = "esp32";
+  doc["cpuMHz"]   = getCpuFrequencyMhz();
+  doc["freeHeap"] = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+#else
+  doc["platform"] = "native";
+  doc["cpuMHz"]   = 0;
+  doc["freeHeap"] = 0;
+#endif
+
+  JsonArray cases = doc.createNestedArray("cases");
+  for (const auto &result : _results) {
+    JsonObject item         = cases.createNestedObject();
+    item["name"]            = result.name.c_str();
+    item["iterations"]      = result.iterations;
+    item["bytes"]           = result.bytes;
+    item["min"]             = result.min;
+    item["median"]          = result.median;
+    item["p99"]             = result.p99;
+    item["max"]             = result.max;
+    item["allocsPerOp"]     = result.allocs;
+    item["allocBytesPerOp"] = result.allocBytes;
+  }
+
+  if (doc.overflowed()) {
+    log_e("benchmark result is truncated.");
+  }
+
+  String json;
+  serializeJson(doc, json);
+  return json;
+}
+
+#endif
@@ -0,0 +1,71 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <functional>
+#include <vector>
+
+// 1ケースあたりの繰り返し回数
+#ifndef BENCHMARK_ITERATIONS
+#define BENCHMARK_ITERATIONS 100
+#endif
+
+// 処理時間とヒープの確保回数を計る。-D ATOM_BENCHMARK でだけ使う
+// 確保回数は -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc で数える
+// ホスト(env:native_benchmark)でも同じ形のJSONを出す
+class Benchmark {
+ public:
+  // 最初の1回は数えない（スプライトの確保など）
+  static void run(const char *name, std::function<void(void)> op,
+                  int iterations = BENCHMARK_ITERATIONS, size_t bytes = 0);
+
+  static String toJson(void);
+
+  // 記録したケースの中央値 [us]。無ければ0
+  static uint32_t median(const char *name);
+
+  static void countAllocation(size_t size);
+
+ private:
+  struct Result {
+    String   name;
+    int      iterations;
+    size_t   bytes;
+    uint32_t min;
+    uint32_t median;
+    uint32_t p99;
+    uint32_t max;
+    float    allocs;
+    float    allocBytes;
+  };
+
+  static std::vector<Result> _results;
+
+  static volatile uint32_t _allocs;
+  static volatile uint32_t _allocBytes;
+};
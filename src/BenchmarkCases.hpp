@@ -0,0 +1,200 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp32-hal-log.h>
+
+#include <Benchmark.h>
+#include <JmaForecast.h>
+#include <WeatherSnapshot.h>
+
+#include <functional>
+
+// 実機(env:benchmark)とホスト(env:native_benchmark)で共通のケース
+// 名前を揃えておくと、tools/benchmark.pyで両方の結果を並べられる
+class BenchmarkCases {
+ public:
+  // codes.jsonを引く処理。実機はアセットかSPIFFS、ホストはdata/codes.jsonを読む
+  using Lookup = std::function<bool(WeatherSnapshot &)>;
+
+  // JMAの予報と同じ形で、地域の数だけ大きくする
+  static String makeJma(int areas) {
+    DynamicJsonDocument doc(4096 + areas * 2048);
+
+    JsonObject forecast          = doc.createNestedObject();
+    forecast["publishingOffice"] = "大阪管区気象台";
+    forecast["reportDatetime"]   = "2022-01-01T11:00:00+09:00";
+
+    JsonArray  timeSeries = forecast.createNestedArray("timeSeries");
+    JsonObject today      = timeSeries.createNestedObject();
+    JsonObject pops       = timeSeries.createNestedObject();
+
+    JsonArray timeDefines = today.createNestedArray("timeDefines");
+    timeDefines.add("2022-01-01T11:00:00+09:00");
+    timeDefines.add("2022-01-02T00:00:00+09:00");
+    timeDefines.add("2022-01-03T00:00:00+09:00");
+
+    timeDefines = pops.createNestedArray("timeDefines");
+    for (int i = 0; i < 5; i++) {
+      timeDefines.add("2022-01-01T12:00:00+09:00");
+    }
+
+    JsonArray todayAreas = today.createNestedArray("areas");
+    JsonArray popsAreas  = pops.createNestedArray("areas");
+
+    for (int i = 0; i < areas; i++) {
+      JsonObject area      = todayAreas.createNestedObject();
+      area["area"]["name"] = i ? "北部" : "大阪府";
+      area["area"]["code"] = String(270000 + i);
+
+      JsonArray weatherCodes = area.createNestedArray("weatherCodes");
+      JsonArray weathers     = area.createNestedArray("weathers");
+      JsonArray winds        = area.createNestedArray("winds");
+      JsonArray waves        = area.createNestedArray("waves");
+
+      for (int day = 0; day < 3; day++) {
+        weatherCodes.add("101");
+        weathers.add("晴れ　時々　くもり　所により　夜遅く　雨");
+        winds.add("北の風　後　北東の風　海上　では　北の風　やや強く");
+        waves.add("０．５メートル　後　１メートル");
+      }
+
+      JsonObject pop      = popsAreas.createNestedObject();
+      pop["area"]["name"] = i ? "北部" : "大阪府";
+
+      JsonArray values = pop.createNestedArray("pops");
+      for (int j = 0; j < 5; j++) {
+        values.add("20");
+      }
+    }
+
+    String json;
+    serializeJson(doc, json);
+    return json;
+  }
+
+  // ATOM Docの処理。公開するJSONをjsonに残す
+  static void doc(WeatherSnapshot &weather, String &json, Lookup lookup) {
+    strlcpy(weather.weatherCodes, "101", sizeof(weather.weatherCodes));
+
+    Benchmark::run("codesLookup", [&]() {
+      lookup(weather);
+    });
+
+    // ATOMDocと同じ大きさの文書とフィルタで読む
+    DynamicJsonDocument     doc(DOC_JMA_CAPACITY);
+    StaticJsonDocument<DOC_JMA_FILTER_CAPACITY> filter;
+    deserializeJson(filter, jmaFilter());
+
+    static const int sizes[] = {1, 2, 4, 8};
+    for (int areas : sizes) {
+      String payload = makeJma(areas);
+      String name    = "jmaParse/" + String(areas) + "areas";
+
+      Benchmark::run(name.c_str(), [&]() {
+        DeserializationError error = deserializeJson(doc, payload.c_str(), DeserializationOption::Filter(filter));
+        if (error) {
+          log_e("deserializeJson() failed: %s", error.c_str());
+        }
+        parseJmaForecast(doc, weather);
+      }, BENCHMARK_ITERATIONS, payload.length());
+    }
+
+    lookup(weather);
+    weather.degree   = 12.3;
+    weather.humidity = 45.6;
+    weather.pressure = 1013.2;
+
+    serializeSnapshot(weather, json, SNAPSHOT_ALL_FIELDS, 1);
+    Benchmark::run("saveJson", [&]() {
+      serializeSnapshot(weather, json, SNAPSHOT_ALL_FIELDS, 1);
+    }, BENCHMARK_ITERATIONS, json.length());
+  }
+
+  // ATOM Viewの処理。jsonはdoc()で作ったもの
+  static void view(const String &json) {
+    // ATOMViewと同じ大きさの文書で読む
+    DynamicJsonDocument doc(SNAPSHOT_JSON_CAPACITY);
+    WeatherSnapshot     received;
+
+    Benchmark::run("viewParse", [&]() {
+      deserializeJson(doc, json.c_str(), DeserializationOption::NestingLimit(VIEW_DOC_NESTING));
+      deserializeSnapshot(doc, received);
+    }, BENCHMARK_ITERATIONS, json.length());
+
+    // 壊れた応答でも、上限までで読むのをやめること
+    String deep;
+    for (int i = 0; i < 256; i++) {
+      deep += "[";
+    }
+
+    String large("{\"timeSeries\":[{\"areas\":[{\"winds\":\"");
+    while (large.length() < VIEW_DOC_MAX_BYTES * 2) {
+      large += "風";
+    }
+    large += "\"}]}]}";
+
+    String wrongTypes(R"({"timeSeries":[{"areas":[{"area":1,"degree":"x","humidity":[1e999],"icon":{}}]}],"nextUpdate":-1})");
+
+    const String *hostile[]     = {&deep, &large, &wrongTypes};
+    const char   *hostileName[] = {"viewParse/deep", "viewParse/large", "viewParse/wrongTypes"};
+
+    for (int i = 0; i < 3; i++) {
+      const String &payload = *hostile[i];
+
+      Benchmark::run(hostileName[i], [&]() {
+        deserializeJson(doc, payload.c_str(), DeserializationOption::NestingLimit(VIEW_DOC_NESTING));
+        deserializeSnapshot(doc, received);
+      }, BENCHMARK_ITERATIONS, payload.length());
+    }
+  }
+
+  // 取得を除いた一連の流れ。Docで読んで公開し、Viewで受け取る
+  static void pipeline(Lookup lookup) {
+    DynamicJsonDocument     jmaDoc(DOC_JMA_CAPACITY);
+    DynamicJsonDocument     viewDoc(SNAPSHOT_JSON_CAPACITY);
+    StaticJsonDocument<DOC_JMA_FILTER_CAPACITY> filter;
+    deserializeJson(filter, jmaFilter());
+
+    String          payload = makeJma(2);
+    WeatherSnapshot weather;
+    WeatherSnapshot received;
+    String          json;
+    clearSnapshot(weather);
+
+    Benchmark::run("pipeline", [&]() {
+      deserializeJson(jmaDoc, payload.c_str(), DeserializationOption::Filter(filter));
+      if (parseJmaForecast(jmaDoc, weather)) {
+        lookup(weather);
+      }
+      serializeSnapshot(weather, json, SNAPSHOT_ALL_FIELDS, 1);
+
+      deserializeJson(viewDoc, json.c_str());
+      deserializeSnapshot(viewDoc, received);
+    }, BENCHMARK_ITERATIONS, payload.length());
+  }
+};
@@ -0,0 +1,76 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <SPIFFS.h>
+#include <esp32-hal-log.h>
+
+#include <ATOMDoc.hpp>
+#include <ATOMView.hpp>
+#include <AssetBundle.h>
+#include <Benchmark.h>
+#include <BenchmarkCases.hpp>
+#include <Display.h>
+#include <WeatherSnapshot.h>
+
+// 取得から描画までの各段を実機で計り、結果をJSONでシリアルへ出す
+// ネットワークは使わない。JMAの応答は同じ形のデータを作って使う
+// 描画以外のケースはBenchmarkCasesにあり、ホストでも同じものを計る
+class BenchmarkSuite {
+ public:
+  void begin(void) {
+    Serial.begin(115200);
+
+    if (!SPIFFS.begin()) {
+      log_e("fail to mount.");
+    }
+    AssetBundle::begin();
+
+    WeatherSnapshot weather;
+    clearSnapshot(weather);
+
+    BenchmarkCases::doc(weather, _json, ATOMDoc::lookupCode);
+    BenchmarkCases::view(_json);
+    BenchmarkCases::pipeline(ATOMDoc::lookupCode);
+
+    _display.begin();
+    _display.benchmark(weather);
+
+    Serial.println("BENCHMARK_BEGIN");
+    Serial.println(Benchmark::toJson());
+    Serial.println("BENCHMARK_END");
+  }
+
+  void update(void) {
+    delay(1000);
+  }
+
+ private:
+  String  _json;
+  Display _display;
+};
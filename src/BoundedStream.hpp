@@ -0,0 +1,102 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <Arduino.h>
+#include <esp32-hal-log.h>
+
+#include <algorithm>
+
+// 読み出す量と時間に上限をかけるStream
+// どちらかを超えたら入力の終わりとして扱い、deserializeJson()をIncompleteInputで止める
+class BoundedStream : public Stream {
+ public:
+  BoundedStream(Stream &stream, size_t maxBytes, uint32_t maxMs) : _stream(stream),
+                                                                   _maxBytes(maxBytes),
+                                                                   _maxMs(maxMs),
+                                                                   _start(millis()),
+                                                                   _count(0),
+                                                                   _exceeded(false) {
+  }
+
+  int available(void) {
+    if (_isExceeded()) {
+      return 0;
+    }
+
+    return std::min((size_t)_stream.available(), _maxBytes - _count);
+  }
+
+  int read(void) {
+    if (_isExceeded()) {
+      return -1;
+    }
+
+    int data = _stream.read();
+    if (data >= 0) {
+      _count++;
+    }
+
+    return data;
+  }
+
+  int peek(void) {
+    if (_isExceeded()) {
+      return -1;
+    }
+
+    return _stream.peek();
+  }
+
+  size_t write(uint8_t data) {
+    return 0;
+  }
+
+  bool exceeded(void) const {
+    return _exceeded;
+  }
+
+  size_t count(void) const {
+    return _count;
+  }
+
+ private:
+  bool _isExceeded(void) {
+    if (!_exceeded && (_count >= _maxBytes || millis() - _start >= _maxMs)) {
+      _exceeded = true;
+      log_w("stream budget exceeded. %d bytes in %d ms", _count, millis() - _start);
+    }
+
+    return _exceeded;
+  }
+
+  Stream  &_stream;
+  size_t   _maxBytes;
+  uint32_t _maxMs;
+  uint32_t _start;
+  size_t   _count;
+  bool     _exceeded;
+};
@@ -0,0 +1,158 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <Ticker.h>
+#include <esp32-hal-log.h>
+#include <sys/time.h>
+
+// 分だけを表示する省電力モード
+#ifndef CLOCK_MINUTES_ONLY
+#define CLOCK_MINUTES_ONLY false
+#endif
+
+// タイマーが境界の直前に発火しないように少し遅らせる [ms]
+#ifndef CLOCK_EDGE_MARGIN_MS
+#define CLOCK_EDGE_MARGIN_MS 2
+#endif
+
+// 秒(または分)の境界ちょうどに時刻を更新する
+class ClockService {
+ public:
+  ClockService(void) : _minutesOnly(CLOCK_MINUTES_ONLY),
+                       _boundary(0) {
+    _ymd[0]  = '\0';
+    _time[0] = '\0';
+  }
+
+  // 通知を受け取るタスク(loopTask)から呼ぶ
+  void begin(void) {
+    _task = xTaskGetCurrentTaskHandle();
+    _schedule();
+  }
+
+  void setMinutesOnly(bool minutesOnly) {
+    _minutesOnly = minutesOnly;
+  }
+
+  bool isMinutesOnly(void) {
+    return _minutesOnly;
+  }
+
+  bool isTicked(void) {
+    return _ticked;
+  }
+
+  // 表示が変わった時だけtrueを返す
+  bool update(void) {
+    const char *wday[] = {"Sun.", "Mon.", "Tue.", "Wed.", "Thu.", "Fri.", "Sat."};
+
+    struct timeval tv;
+    struct tm      info;
+
+    _ticked = false;
+
+    gettimeofday(&tv, nullptr);
+    localtime_r(&tv.tv_sec, &info);
+
+    // 表示する境界をmicros()で覚える。画面に出るまでの時間はDisplayが測る
+    uint32_t now = micros();
+    _boundary    = tv.tv_usec < 500000 ? now - tv.tv_usec : now + (1000000 - tv.tv_usec);
+
+    _schedule();
+
+    if (info.tm_year + 1900 < 2020) {
+      // NTPの同期待ち
+      return false;
+    }
+
+    char time[16] = {0};
+    char ymd[16]  = {0};
+
+    if (_minutesOnly) {
+      snprintf(time, sizeof(time), "%02d:%02d", info.tm_hour, info.tm_min);
+    } else {
+      snprintf(time, sizeof(time), "%02d:%02d:%02d", info.tm_hour, info.tm_min, info.tm_sec);
+    }
+    snprintf(ymd, sizeof(ymd), "%s %02d %02d %04d", wday[info.tm_wday], info.tm_mon + 1, info.tm_mday, info.tm_year + 1900);
+
+    if (strcmp(time, _time) == 0 && strcmp(ymd, _ymd) == 0) {
+      return false;
+    }
+
+    strlcpy(_time, time, sizeof(_time));
+    strlcpy(_ymd, ymd, sizeof(_ymd));
+
+    return true;
+  }
+
+  const char *getYMD(void) {
+    return _ymd;
+  }
+
+  const char *getTime(void) {
+    return _time;
+  }
+
+  // 今の表示が始まる境界の時刻 [micros()]
+  uint32_t getBoundary(void) {
+    return _boundary;
+  }
+
+ private:
+  static void _onTick(void) {
+    _ticked = true;
+
+    if (_task) {
+      xTaskNotifyGive(_task);
+    }
+  }
+
+  void _schedule(void) {
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+
+    uint32_t delay = 1000 - tv.tv_usec / 1000;
+
+    if (_minutesOnly) {
+      delay += (59 - tv.tv_sec % 60) * 1000;
+    }
+
+    _ticker.once_ms(delay + CLOCK_EDGE_MARGIN_MS, _onTick);
+  }
+
+  Ticker   _ticker;
+  bool     _minutesOnly;
+  uint32_t _boundary;
+  char     _ymd[16];
+  char     _time[16];
+
+  static volatile bool _ticked;
+  static TaskHandle_t  _task;
+};
+
+volatile bool ClockService::_ticked = false;
+TaskHandle_t  ClockService::_task   = nullptr;
@@ -24,14 +24,20 @@ SOFTWARE.
 
 #pragma once
 
+#include <FastConnect.hpp>
+#include <Metrics.h>
+#include <PowerProfile.h>
 #include <Task.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
+#include <atomic>
+#include <functional>
 #include <memory>
 
 #if defined(ARDUINO_ARCH_ESP32)
 #include <Arduino.h>
+#include <ArduinoJson.h>
 #include <AutoConnect.h>
 #include <ESPmDNS.h>
 #include <WebServer.h>
@@ -45,13 +51,25 @@ using WiFiWebServer = WebServer;
 
 #include <esp32-hal-log.h>
 
+// ポータルで設定を待つ時間 [ms]。過ぎても接続は裏で続ける
+#ifndef CONNECT_PORTAL_TIMEOUT_MS
+#define CONNECT_PORTAL_TIMEOUT_MS (3 * 60 * 1000)
+#endif
+
+// AutoConnectはWebServerを前提にしているので、同期のWebServerをこのタスクで回す
 class Connect : public Task {
  public:
   Connect(String hostName, String apName, uint16_t httpPort) : _portal(_server),
                                                                _hostName(hostName),
                                                                _apName(apName),
                                                                _httpPort(httpPort),
-                                                               _message(MESSAGE::MSG_UPDATE_NOTHING) {
+                                                               _message(MESSAGE::MSG_UPDATE_NOTHING),
+                                                               _connected(false),
+                                                               _gotIP(false),
+                                                               _connectedMs(0),
+                                                               _reconnects(0),
+                                                               _fastConnected(false),
+                                                               _beginMs(0) {
     // TODO
     _content = String(R"(
     <!DOCTYPE html>
@@ -71,15 +89,29 @@ class Connect : public Task {
     _message = message;
   }
 
+  bool isIdle(void) {
+    return _message == MESSAGE::MSG_UPDATE_NOTHING;
+  }
+
+  // WebServer、天気の取得、mDNSはCORE0のこのタスクで処理する
+  // 接続もこのタスクの中で待つので、呼び出し側はすぐに戻る
   void startWiFi(void) {
     setTaskName("AutoConnect");
-    setTaskSize(4096 * 1);
+    setTaskSize(4096 * 2);  // TLSハンドシェイクとJSONの解析を行うため
     setTaskPriority(2);
     setCore(0);
-    begin(SECRET_SSID, SECRET_PASS);
+
+    WiFi.onEvent([this](WiFiEvent_t event, WiFiEventInfo_t info) {
+      _onWiFiEvent(event);
+    });
+
     start(nullptr);
   }
 
+  bool isConnected(void) {
+    return _connected;
+  }
+
   void begin(void) {
     begin("", "");
   }
@@ -91,10 +123,16 @@ class Connect : public Task {
     _config.ota           = AC_OTA_BUILTIN;
     _config.apid          = _apName;
     _config.hostName      = _hostName;
+    _config.portalTimeout = CONNECT_PORTAL_TIMEOUT_MS;
+    _config.retainPortal  = true;  // 時間切れの後もポータルを残し、裏で繋ぎ直す
 
     _portal.config(_config);
 
-    bool result = false;
+    bool     result = false;
+    uint32_t start  = millis();
+
+    // 前回の接続先へ直接繋ぐ。繋がっていれば、AutoConnectは接続をやり直さない
+    _fastConnected = _fastConnect.connect();
 
     if (String(ssid).isEmpty() || String(password).isEmpty()) {
       result = _portal.begin();
@@ -102,20 +140,38 @@ class Connect : public Task {
       result = _portal.begin(ssid, password);
     }
 
-    if (result) {
-      log_i("WiFi connected: %s", WiFi.localIP().toString().c_str());
+    _beginMs = millis() - start;
+    log_i("WiFi begin : %lu ms (%s)", _beginMs, _fastConnected ? "fast" : "AutoConnect");
 
-      if (MDNS.begin(_hostName.c_str())) {
-        MDNS.addService("http", "tcp", _httpPort);
-        log_i("HTTP Server ready! Open http://%s.local/ in your browser\n", _hostName.c_str());
-      } else
-        log_e("Error setting up MDNS responder");
-    } else {
-      log_e("ESP32 can't connect to AP.");
-      ESP.restart();
+    if (!result) {
+      log_w("WiFi is not connected yet. the portal is still open.");
     }
   }
 
+  String getConnectivity(void) {
+    DynamicJsonDocument doc(256);
+
+    doc["connected"]   = isConnected();
+    doc["connectedMs"] = _connectedMs.load();
+    doc["reconnects"]  = _reconnects.load();
+    doc["fastConnect"] = _fastConnected;
+    doc["associateMs"] = _fastConnect.getAssociateMs();
+    doc["beginMs"]     = _beginMs;
+    doc["rssi"]        = WiFi.RSSI();
+    doc["ip"]          = WiFi.localIP().toString();
+
+    String json;
+    serializeJson(doc, json);
+
+    return json;
+  }
+
+  void addAPI(const char *uri, const char *contentType, std::function<String(void)> content) {
+    _server.on(uri, [this, contentType, content]() {
+      _server.send(200, contentType, content());
+    });
+  }
+
   virtual void update(void) = 0;
 
  protected:
@@ -126,26 +182,58 @@ class Connect : public Task {
     });
   }
 
+  // Wi-Fiのイベントタスクから呼ばれる。ここではフラグを立てるだけ
+  void _onWiFiEvent(WiFiEvent_t event) {
+    switch (event) {
+      case SYSTEM_EVENT_STA_GOT_IP:
+        _connected = true;
+        _gotIP     = true;
+        break;
+      case SYSTEM_EVENT_STA_DISCONNECTED:
+      case SYSTEM_EVENT_STA_LOST_IP:
+        if (_connected.exchange(false)) {
+          _reconnects++;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+
+  void _onConnected(void) {
+    uint32_t expected = 0;
+    if (_connectedMs.compare_exchange_strong(expected, millis())) {
+      log_i("Boot to connected : %lu ms", millis());
+    }
+
+    log_i("WiFi connected: %s", WiFi.localIP().toString().c_str());
+
+    _fastConnect.save();
+
+    if (PowerProfile::isLowPower()) {
+      WiFi.setSleep(true);
+    }
+
+    MDNS.end();
+    if (MDNS.begin(_hostName.c_str())) {
+      MDNS.addService("http", "tcp", _httpPort);
+      log_i("HTTP Server ready! Open http://%s.local/ in your browser\n", _hostName.c_str());
+    } else
+      log_e("Error setting up MDNS responder");
+  }
+
   void run(void *data) {
+    begin(SECRET_SSID, SECRET_PASS);
+
     for (;;) {
-      switch (_message) {
-        case MESSAGE::MSG_UPDATE_DOCUMENT:
-          log_i("MESSAGE::MSG_UPDATE_DOCUMENT");
-          break;
-        case MESSAGE::MSG_UPDATE_DIPLAY:
-          log_i("MESSAGE::MSG_UPDATE_DIPLAY");
-          break;
-        case MESSAGE::MSG_UPDATE_CLOCK:
-          log_i("MESSAGE::MSG_UPDATE_CLOCK");
-          break;
-        case MESSAGE::MSG_UPDATE_NOTHING:
-          break;
-        default:
-          break;
+      loopTick();
+
+      if (_gotIP.exchange(false)) {
+        _onConnected();
       }
 
-      _portal.handleClient();
-      delay(1);
+      update();
+      delay(PowerProfile::isLowPower() ? 10 : 1);
     }
   }
 
@@ -158,5 +246,14 @@ class Connect : public Task {
   String   _apName;
   uint16_t _httpPort;
 
-  MESSAGE _message;
+  std::atomic<MESSAGE> _message;
+
+  std::atomic<bool>     _connected;
+  std::atomic<bool>     _gotIP;
+  std::atomic<uint32_t> _connectedMs;
+  std::atomic<uint32_t> _reconnects;
+
+  FastConnect _fastConnect;
+  bool        _fastConnected;
+  uint32_t    _beginMs;
 };
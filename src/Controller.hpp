@@ -25,12 +25,27 @@ SOFTWARE.
 #pragma once
 
 #include <Arduino.h>
+#include <AssetBundle.h>
+#include <ClockService.hpp>
+#include <MemoryHealth.h>
+#include <Metrics.h>
+#include <PowerProfile.h>
 #include <Ticker.h>
 #include <message.h>
 #include <secrets.h>
 
 #include <memory>
 
+// ATOM Viewを省電力で動かす
+#ifndef ATOM_LOW_POWER
+#define ATOM_LOW_POWER false
+#endif
+
+// 次の取得までこの秒数 [s] 以上ある時だけ再起動する。起動と再接続に使う時間
+#ifndef RESTART_FETCH_MARGIN
+#define RESTART_FETCH_MARGIN 30
+#endif
+
 #if defined(ATOM_DOC)
 #include <ATOMDoc.hpp>
 using ATOM = ATOMDoc;
@@ -41,72 +56,104 @@ using ATOM = ATOMView;
 
 class Controller {
  public:
-  Controller() {}
+  Controller() : _lastTaskStatus(0) {}
 
   static void sendMessage(MESSAGE message) {
     _message = message;
   }
 
-  static void setNtpTime(void) {
-    _clock = true;
-  }
-
   static void updatePeriod(void) {
     sendMessage(MESSAGE::MSG_UPDATE_DOCUMENT);
   }
 
   void setNtpClock(void) {
-    char        time[16] = {0};
-    char        ymd[16]  = {0};
-    const char *wday[]   = {"Sun.", "Mon.", "Tue.", "Wed.", "Thu.", "Fri.", "Sat."};
-
-    struct tm info;
-
-    if (getLocalTime(&info)) {
-      sprintf(time, "%02d:%02d:%02d", info.tm_hour, info.tm_min, info.tm_sec);
-      sprintf(ymd, "%s %02d %02d %04d", wday[info.tm_wday], info.tm_mon + 1, info.tm_mday, info.tm_year + 1900);
-      // log_i("%s %s", ymd, time);
-
-      if (info.tm_hour == 23 && info.tm_min == 59 && info.tm_sec == 59) {
-        ESP.restart();
-        delay(1000);
-        return;
-      }
+    //表示が変わった時だけ描画タスクへ渡す
+    if (_clockService.update()) {
+      _atom.setDayTime(_clockService.getYMD(), _clockService.getTime(), _clockService.getBoundary());
     }
-
-    _atom.setDayTime(ymd, time);
-
-    _clock = false;
   }
 
   void begin(void) {
+    Task::setLoopTask();
+
+    //続けて再起動した回数を読み、次に再起動してよい時間を決める
+    MemoryHealth::begin();
+
     if (!SPIFFS.begin()) {
       log_e("fail to mount.");
     }
+
+    //無ければSPIFFSのファイルを使う
+    AssetBundle::begin();
     // Serial.begin(115200);
 
+    //前回の天気をフラッシュから復元する
+    _atom.restoreSnapshot();
+
+    _atom.addAPI("/api/v1/memory.json", "application/json", []() {
+      return MemoryHealth::toJson();
+    });
+
+    _atom.addAPI("/api/v1/metrics", "text/plain; version=0.0.4", []() {
+      return Metrics::toPrometheus();
+    });
+
+    _atom.addAPI("/api/v1/tasks.json", "application/json", []() {
+      return String(Task::toJson().c_str());
+    });
+
+    _atom.addAPI("/api/v1/schedule.json", "application/json", [this]() {
+      return _atom.getSchedule();
+    });
+
+    _atom.addAPI("/api/v1/assets.json", "application/json", []() {
+      return AssetBundle::toJson();
+    });
+
+    _atom.addAPI("/api/v1/power.json", "application/json", []() {
+      return PowerProfile::toJson();
+    });
+
+    _atom.addAPI("/api/v1/connect.json", "application/json", [this]() {
+      return _atom.getConnectivity();
+    });
+
 #if defined(ATOM_DOC)
     _atom.startDocAPI();
     _atom.setAreaCode(27000);
-    _atom.begin(SECRET_SSID, SECRET_PASS);
-#else
-    _atom.begin();
+#elif defined(ATOM_VIEW)
+    _atom.startDisplayAPI();
+    _atom.addAPI("/api/v1/transfer.json", "application/json", [this]() {
+      return _atom.getTransfer();
+    });
 #endif
 
-    //_serverChecker.attach(60 * 10, updatePeriod);
-    _serverChecker.attach(30, updatePeriod);
+    // ATOM ViewはCORE1で描画タスクを、どちらもCORE0でネットワークタスクを開始する
+    // Wi-Fiの接続は待たない
+    _atom.begin();
+
+    PowerProfile::begin(ATOM_LOW_POWER ? POWER::POWER_LOW : POWER::POWER_PERFORMANCE);
+    if (PowerProfile::isLowPower()) {
+      //秒を描かなければ、描画タスクは1分に1回しか起きない
+      _clockService.setMinutesOnly(true);
+    }
+
+    //取得するかどうかは各取得元のスケジュールで決める
+    _serverChecker.attach(1, updatePeriod);
 
     configTzTime(TIME_ZONE, NTP_SERVER1, NTP_SERVER2, NTP_SERVER3);
-    _ntpClocker.attach_ms(500, setNtpTime);
+    _clockService.begin();
 
     log_d("Free Heap : %d", heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
   }
 
+  // loop()から呼ぶ。取得と描画はそれぞれのタスクが行うので、ここではメッセージを渡すだけ
   void update(void) {
     switch (_message) {
       case MESSAGE::MSG_UPDATE_DOCUMENT:
-        _atom.sendMessage(_message);
-        _atom.update();
+        if (_atom.isConnected() && _atom.isIdle() && _atom.isDue()) {
+          _atom.sendMessage(_message);
+        }
 
         sendMessage(MESSAGE::MSG_UPDATE_NOTHING);
         break;
@@ -114,26 +161,37 @@ class Controller {
         break;
     }
 
-    if (_clock) {
+    if (_clockService.isTicked()) {
       setNtpClock();
-      _atom.sendMessage(MESSAGE::MSG_UPDATE_CLOCK);
     }
 
-    _atom.update();
+    MemoryHealth::sample();
+    PowerProfile::update();
+
+    //取得中でなく、次の取得まで時間がある時に、ネットワークタスクでスナップショットを保存してから再起動する
+    if (MemoryHealth::restartRequired() && _atom.isIdle() && _atom.secondsToNextFetch() > RESTART_FETCH_MARGIN) {
+      log_w("Heap is fragmented. restart.");
+      _atom.sendMessage(MESSAGE::MSG_RESTART);
+    }
+
+    if (millis() - _lastTaskStatus > TASK_STATUS_PERIOD_MS) {
+      _lastTaskStatus = millis();
+      Task::logStatus();
+    }
 
-    delay(1);
+    // 時刻の境界で起こしてもらう
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PowerProfile::isLowPower() ? 1000 : 10));
   }
 
   static MESSAGE _message;
-  static bool    _clock;
 
  private:
-  Ticker _serverChecker;
-  Ticker _ntpClocker;
-  ATOM   _atom;
+  Ticker       _serverChecker;
+  ClockService _clockService;
+  ATOM         _atom;
 
-  String _ntpTime;
+  String   _ntpTime;
+  uint32_t _lastTaskStatus;
 };
 
 MESSAGE Controller::_message = MESSAGE::MSG_UPDATE_NOTHING;
-bool    Controller::_clock   = false;
@@ -22,9 +22,23 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#include <Benchmark.h>
 #include <Display.h>
+#include <GifBlit.h>
+#include <MemoryHealth.h>
+#include <Metrics.h>
+#include <PowerProfile.h>
 #include <esp32-hal-log.h>
 
+#include <algorithm>
+
+// ページごとに使うフィールド
+static const uint32_t pageFields[] = {
+    SNAPSHOT_FIELD(FIELD_WEATHERS_JP) | SNAPSHOT_FIELD(FIELD_WEATHERS_EN) |
+        SNAPSHOT_FIELD(FIELD_DEGREE) | SNAPSHOT_FIELD(FIELD_HUMIDITY) | SNAPSHOT_FIELD(FIELD_PRESSURE),
+    SNAPSHOT_FIELD(FIELD_WINDS) | SNAPSHOT_FIELD(FIELD_WAVES),
+    SNAPSHOT_FIELD(FIELD_DEGREE) | SNAPSHOT_FIELD(FIELD_HUMIDITY) | SNAPSHOT_FIELD(FIELD_PRESSURE)};
+
 MESSAGE Display::_message = MESSAGE::MSG_UPDATE_NOTHING;
 
 ESP32_8BIT_CVBS Display::_display;
@@ -35,20 +49,43 @@ File Display::_file;
 int Display::_width  = 0;
 int Display::_height = 0;
 
-Display::Display() : _time(""),
-                     _day(""),
+uint8_t   Display::_lut[256] = {0};
+uint16_t *Display::_palette  = nullptr;
+
+Display::Display() : Task("Render", 4096 * 2, 3),
                      _daytimeFormat("__YMD__ __NTP__"),
-                     _degree(0.0),
-                     _humidity(0.0),
-                     _pressure(0.0),
-                     _forecastJP(""),
-                     _forecastEN(""),
                      _filename(""),
-                     _bgColor(0x10cd),
-                     _bgTitle(0x0019),
-                     _bgTemperature(0x1c43),
-                     _bgPressure(0x1c43),
-                     _bgHumidity(0x1c43) {
+                     _firstFrame(true),
+                     _firstFrameMs(0),
+                     _clockVersion(UINT32_MAX),
+                     _weatherVersion(UINT32_MAX),
+                     _titleDirty(0),
+                     _weatherDirty(0),
+                     _lateFrames(0),
+                     _page(0),
+                     _next(0),
+                     _slide(0),
+                     _trendHead(0),
+                     _trendCount(0),
+                     _lastRaster(0),
+                     _lastPush(0),
+                     _lastSwap(0),
+                     _lastLatency(0),
+                     _changedAt(0),
+                     _weatherFields(SNAPSHOT_ALL_FIELDS),
+                     _frames(0),
+                     _droppedFrames(0),
+                     _tornFrames(0),
+                     _fps(0),
+                     _fpsFrames(0),
+                     _fpsStart(0),
+                     _overlay(false),
+                     _overlayShown(false),
+                     _lastOverlay(0),
+                     _overlayDirty(0) {
+  memset(&_clock, 0, sizeof(_clock));
+  memset(_trend, 0, sizeof(_trend));
+  clearSnapshot(_weather);
 }
 
 void Display::sendMessage(MESSAGE message) {
@@ -59,138 +96,525 @@ void Display::begin(void) {
   _display.begin();
   _display.startWrite();
 
-  _width  = 140;
-  _height = 160;
+  _width  = DisplayLayout::animation().w;
+  _height = DisplayLayout::animation().h;
 
   //描画エリア
-  _display.fillScreen(_bgColor);
+  _display.fillScreen(rgb332(DisplayLayout::theme().background));
   _display.setRotation(0);
   _display.setColorDepth(8);
 
   //スプライト
-  _animation.fillSprite(_bgColor);
+  _animation.fillSprite(rgb332(DisplayLayout::theme().background));
   //_animation.setTextWrap(true, true);
   _animation.setPsram(false);
   _animation.setColorDepth(8);
 
-  _data.fillSprite(_bgColor);
-  _data.setFont(&fonts::efont);
-  _data.setTextWrap(true, true);
-  _data.setPsram(false);
-  _data.setColorDepth(8);
+  // パレットはリトルエンディアンのRGB565で受け取り、_GIFDrawでRGB332へ変換する
+  _gif.begin(LITTLE_ENDIAN_PIXELS);
+
+  constexpr LayoutRect data = DisplayLayout::data();
+  constexpr LayoutRow  row  = DisplayLayout::weatherENRow();
+  _marquee.begin({data.x, (int16_t)(data.y + row.y), data.w, (int16_t)(16 * row.size)});
 
-  _title.fillSprite(_bgColor);
+  for (auto &page : _pages) {
+    page.setFont(&fonts::efont);
+    page.setTextWrap(true, true);
+    page.setPsram(false);
+    page.setColorDepth(8);
+  }
+
+  _title.fillSprite(rgb332(DisplayLayout::theme().background));
   _title.setFont(&fonts::efont);
   _title.setTextWrap(true, true);
   _title.setPsram(false);
   _title.setColorDepth(8);
+
+  _overlayCanvas.setFont(&fonts::efont);
+  _overlayCanvas.setPsram(false);
+  _overlayCanvas.setColorDepth(8);
 }
 
-void Display::setNtpTime(String ntpTime) {
-  _time = ntpTime;
+// 描画はCORE1、ネットワークはCORE0
+void Display::startRender(void) {
+  setCore(1);
+  start(nullptr);
+
+  _pageTicker.attach_ms(DISPLAY_PAGE_MS, _onPage, this);
 }
 
-void Display::setYMD(String ymd) {
-  _day = ymd;
+void Display::_onPage(Display *display) {
+  sendMessage(MESSAGE::MSG_UPDATE_DIPLAY);
+  display->notify();
 }
 
-void Display::displayTitle(void) {
-  if (!_title.createSprite(239, 32)) {
-    log_e("title allocation failed");
+void Display::run(void *data) {
+  TickType_t wake = xTaskGetTickCount();
+  uint32_t   last = micros();
+
+  for (;;) {
+    loopTick();
+
+    // 省電力時は、描き直すものが無ければ通知が来るまで眠る
+    bool slept = false;
+    if (PowerProfile::isLowPower() && !_isDirty()) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      PowerProfile::wake();
+
+      wake  = xTaskGetTickCount();
+      slept = true;
+    }
+
+    uint32_t now    = micros();
+    uint32_t period = now - last;
+    uint32_t frame  = DISPLAY_FRAME_MS * 1000;
+    last            = now;
+
+    // 周期のずれ。1フレームを超えたら遅延として数える
+    uint32_t jitter = period > frame ? period - frame : frame - period;
+    if (!slept) {
+      Metrics::observe(METRIC::METRIC_RENDER_JITTER, jitter);
+
+      // 次の周期にも間に合わなかった分は、落としたフレームとして数える
+      if (period >= frame * 2) {
+        _droppedFrames += period / frame - 1;
+      }
+
+      if (jitter > frame) {
+        _lateFrames++;
+        log_w("late frame : period %d us, %d late frames", period, _lateFrames);
+      }
+    }
+
+    update();
+
+    PowerProfile::busy(micros() - now);
+
+    vTaskDelayUntil(&wake, pdMS_TO_TICKS(DISPLAY_FRAME_MS));
+  }
+}
+
+bool Display::_isDirty(void) {
+  return _titleDirty || _weatherDirty || _overlayDirty || _slide || _isMarqueeDue() || _isOverlayDue() ||
+         _message == MESSAGE::MSG_UPDATE_DIPLAY ||
+         _clockLock.version() != _clockVersion ||
+         _weatherLock.version() != _weatherVersion;
+}
+
+// 今日のページが出ている間だけ流す。省電力時は止めておく
+bool Display::_isMarqueeDue(void) {
+  return _page == (int)PAGE::PAGE_TODAY && _slide == 0 &&
+         _marquee.isScrolling() && !PowerProfile::isLowPower();
+}
+
+bool Display::_isOverlayDue(void) {
+  bool overlay = _overlay.load(std::memory_order_relaxed);
+
+  if (overlay != _overlayShown) {
+    return true;
+  }
+
+  return overlay && (millis() - _lastOverlay) >= DISPLAY_OVERLAY_MS;
+}
+
+void Display::setOverlay(bool enable) {
+  _overlay.store(enable, std::memory_order_relaxed);
+  _markChanged();
+}
+
+String Display::getProfile(void) {
+  DynamicJsonDocument doc(384);
+
+  doc["firstFrameMs"]  = _firstFrameMs;
+  doc["overlay"]       = _overlay.load(std::memory_order_relaxed);
+  doc["fps"]           = _fps;
+  doc["frames"]        = _frames;
+  doc["droppedFrames"] = _droppedFrames;
+  doc["tornFrames"]    = _tornFrames;
+  doc["lateFrames"]    = _lateFrames;
+
+  JsonObject last = doc.createNestedObject("lastFrameUs");
+  last["rasterize"] = _lastRaster;
+  last["push"]      = _lastPush;
+  last["swap"]      = _lastSwap;
+  last["latency"]   = _lastLatency;
+
+  JsonObject marquee = doc.createNestedObject("marquee");
+  marquee["frames"]    = _marquee.getFrames();
+  marquee["lastUs"]    = _marquee.getLastUs();
+  marquee["averageUs"] = _marquee.getAverageUs();
+  marquee["maxUs"]     = _marquee.getMaxUs();
+
+  String json;
+  serializeJson(doc, json);
+
+  return json;
+}
+
+// 直前のフレームの処理時間 [us] とfpsを画面に重ねる
+void Display::_drawOverlay(void) {
+  constexpr LayoutRect area       = DisplayLayout::overlay();
+  constexpr uint8_t    background = rgb332(DisplayLayout::theme().background);
+  constexpr uint8_t    text       = rgb332(0xFFE0);
+
+  if (!_createSprite(_overlayCanvas, area)) {
     return;
   }
 
-  _title.fillSprite(_bgTitle);
+  _overlayCanvas.fillSprite(background);
 
-  _title.setTextColor(0xFFFF, _bgTitle);
-  _title.setTextSize(1);
-  _title.setCursor(0, 16 * 0);
-  _title.print(" Osaka Weather Station");
+  // 消す時は背景で塗るだけ
+  if (_overlayShown) {
+    char line[48];
+    snprintf(line, sizeof(line), "%2ufps r%u p%u s%u d%u t%u",
+             _fps, _lastRaster, _lastPush, _lastSwap, _droppedFrames, _tornFrames);
 
-  String format(_daytimeFormat);
-  format.replace("__NTP__", _time);
-  format.replace("__YMD__", _day);
-  _title.setCursor(16, 16 * 1);
-  _title.print(format.c_str());
+    _overlayCanvas.setTextColor(text, background);
+    _overlayCanvas.setTextSize(1);
+    _overlayCanvas.setCursor(0, 0);
+    _overlayCanvas.print(line);
+  }
+}
+
+// スプライトは作ったまま残し、フレームバッファの枚数分だけ転送に使う
+bool Display::_createSprite(M5Canvas &canvas, const LayoutRect &area) {
+  if (canvas.getBuffer() != nullptr) {
+    return true;
+  }
+
+  if (!canvas.createSprite(area.w, area.h)) {
+    MemoryHealth::failed(SUBSYSTEM::SUBSYSTEM_SPRITE);
+    log_e("sprite allocation failed : %dx%d", area.w, area.h);
+    return false;
+  }
+
+  MemoryHealth::allocated(SUBSYSTEM::SUBSYSTEM_SPRITE);
 
-  _title.pushSprite(&_display, 2, 9);
-  _title.deleteSprite();
+  return true;
 }
 
-void Display::setDegree(float degree) {
-  _degree = degree;
+// 描き直した領域だけをバックバッファへ送る
+void Display::_present(void) {
+  constexpr LayoutRect title   = DisplayLayout::title();
+  constexpr LayoutRect data    = DisplayLayout::data();
+  constexpr LayoutRect overlay = DisplayLayout::overlay();
+
+  if (_titleDirty) {
+    _title.pushSprite(&_display, title.x, title.y);
+    _titleDirty--;
+  }
+
+  if (_slide) {
+    // 1フレームの転送量は、ページを1枚送るのと同じ
+    int offset = data.w * _slide / DISPLAY_SLIDE_FRAMES;
+
+    _display.setClipRect(data.x, data.y, data.w, data.h);
+    _pages[_page].pushSprite(&_display, data.x - offset, data.y);
+    _pages[_next].pushSprite(&_display, data.x + data.w - offset, data.y);
+    _display.clearClipRect();
+
+    if (++_slide > DISPLAY_SLIDE_FRAMES) {
+      _page         = _next;
+      _slide        = 0;
+      _weatherDirty = DISPLAY_BUFFERS;  // 両方のバッファへ、予報の行も含めて送り直す
+    }
+  } else if (_weatherDirty) {
+    _pages[_page].pushSprite(&_display, data.x, data.y);
+    _weatherDirty--;
+
+    if (_page == (int)PAGE::PAGE_TODAY) {
+      _marquee.present(&_display, false);
+    }
+  } else if (_isMarqueeDue()) {
+    _marquee.present(&_display, true);
+  }
+
+  if (_overlayDirty) {
+    _overlayCanvas.pushSprite(&_display, overlay.x, overlay.y);
+    _overlayDirty--;
+  }
+}
+
+void Display::_markChanged(void) {
+  // 表示されていない変更のうち、最初の時刻を残す
+  uint32_t expected = 0;
+  _changedAt.compare_exchange_strong(expected, micros() | 1);
+
+  notify();
 }
 
-void Display::setHumidity(float humidity) {
-  _humidity = humidity;
+void Display::setDayTime(String ymd, String ntpTime, uint32_t boundary) {
+  ClockFrame clock;
+
+  strlcpy(clock.day, ymd.c_str(), sizeof(clock.day));
+  strlcpy(clock.time, ntpTime.c_str(), sizeof(clock.time));
+  clock.boundary = boundary;
+
+  _clockLock.write(clock);
+  _markChanged();
 }
-void Display::setAtomPressure(float pressure) {
-  _pressure = pressure;
+
+void Display::displayTitle(void) {
+  _drawTitle<DisplayLayout>();
 }
-void Display::setWeatherforcastJP(String forecastJP) {
-  _forecastJP = forecastJP;
+
+template <typename L>
+void Display::_drawTitle(void) {
+  constexpr LayoutRect area       = L::title();
+  constexpr uint8_t    background = rgb332(L::theme().title);
+  constexpr uint8_t    text       = rgb332(L::theme().text);
+  constexpr uint8_t    stale      = rgb332(L::theme().stale);
+
+  if (!_createSprite(_title, area)) {
+    return;
+  }
+
+  _title.fillSprite(background);
+
+  _title.setTextColor(text, background);
+  _title.setTextSize(L::titleRow().size);
+  _title.setCursor(0, L::titleRow().y);
+  _title.print(L::titleText());
+
+  if (_weather.stale) {
+    _title.setTextColor(stale, background);
+    _title.setCursor(area.w - 8 * 2, L::titleRow().y);
+    _title.print("*");
+    _title.setTextColor(text, background);
+  }
+
+  String format(_daytimeFormat);
+  format.replace("__NTP__", _clock.time);
+  format.replace("__YMD__", _clock.day);
+  _title.setTextSize(L::clockRow().size);
+  _title.setCursor(L::clockX(), L::clockRow().y);
+  _title.print(format.c_str());
 }
-void Display::setWeatherforcastEN(String forecastEN) {
-  _forecastEN = forecastEN;
+
+void Display::setWeather(const WeatherSnapshot &weather, uint32_t fields) {
+  _weatherFields.fetch_or(fields);
+  _weatherLock.write(weather);
+  _markChanged();
 }
+
 void Display::displayWeather(void) {
-  if (!_data.createSprite(174, 96)) {
-    log_e("data allocation failed");
+  _renderPages(SNAPSHOT_ALL_FIELDS);
+  _weatherDirty = DISPLAY_BUFFERS;
+}
+
+// 変わったフィールドを使うページだけ描き直す。表示中のページが変わればtrue
+bool Display::_renderPages(uint32_t fields) {
+  constexpr LayoutRect area = DisplayLayout::data();
+
+  for (auto &page : _pages) {
+    if (!_createSprite(page, area)) {
+      return false;
+    }
+  }
+
+  bool visible = false;
+
+  for (int i = 0; i < (int)PAGE::PAGE_MAX; i++) {
+    if ((fields & pageFields[i]) == 0) {
+      continue;
+    }
+
+    switch ((PAGE)i) {
+      case PAGE::PAGE_TODAY:
+        _drawToday<DisplayLayout>(_pages[i]);
+        break;
+      case PAGE::PAGE_WIND_WAVE:
+        _drawWindWave<DisplayLayout>(_pages[i]);
+        break;
+      case PAGE::PAGE_TREND:
+        _drawTrend<DisplayLayout>(_pages[i]);
+        break;
+      default:
+        break;
+    }
+
+    if (i == _page || (_slide && i == _next)) {
+      visible = true;
+    }
+  }
+
+  return visible;
+}
+
+void Display::_addTrend(void) {
+  _trend[(int)TREND::TREND_DEGREE][_trendHead]   = _weather.degree;
+  _trend[(int)TREND::TREND_HUMIDITY][_trendHead] = _weather.humidity;
+  _trend[(int)TREND::TREND_PRESSURE][_trendHead] = _weather.pressure;
+
+  _trendHead = (_trendHead + 1) % DISPLAY_TREND_SIZE;
+  if (_trendCount < DISPLAY_TREND_SIZE) {
+    _trendCount++;
+  }
+}
+
+void Display::_nextPage(void) {
+  if (_slide) {
     return;
   }
 
-  char tempe[10] = {0};
-  char humid[10] = {0};
-  char press[10] = {0};
+  _next = (_page + 1) % (int)PAGE::PAGE_MAX;
+
+  // 省電力時はスライドしない
+  if (DISPLAY_SLIDE_FRAMES == 0 || PowerProfile::isLowPower()) {
+    _page         = _next;
+    _weatherDirty = DISPLAY_BUFFERS;
+  } else {
+    _slide = 1;
+  }
+}
 
-  sprintf(tempe, "%2.1f", _degree);
-  sprintf(humid, "%2.0f", _humidity);
-  sprintf(press, "%4.1f", _pressure);
+template <typename L>
+void Display::_drawToday(M5Canvas &canvas) {
+  constexpr uint8_t    background  = rgb332(L::theme().background);
+  constexpr uint8_t    text        = rgb332(L::theme().text);
+  constexpr uint8_t    temperature = rgb332(L::theme().temperature);
+  constexpr uint8_t    humidity    = rgb332(L::theme().humidity);
+  constexpr uint8_t    pressure    = rgb332(L::theme().pressure);
 
-  _data.fillSprite(_bgColor);
+  SnapshotText number;
+  formatSnapshot(_weather, number);
+
+  canvas.fillSprite(background);
 
   // 予報（日本語）
-  _data.setCursor(0, 16 * 0);
-  _data.setTextColor(0xFFFF, _bgColor);
-  _data.setTextSize(2);
-  _data.print(" ");
-  _data.print(_forecastJP.c_str());
-
-  // 予報（英語）
-  _data.setCursor(0, 16 * 2);
-  _data.setTextColor(0xFFFF, _bgColor);
-  _data.setTextSize(1);
-  _data.print("  ");
-  _data.print(_forecastEN.c_str());
+  canvas.setCursor(0, L::weatherJPRow().y);
+  canvas.setTextColor(text, background);
+  canvas.setTextSize(L::weatherJPRow().size);
+  canvas.print(" ");
+  canvas.print(_weather.weathersJP);
+  fontCheckGlyphs("weathers_jp", _weather.weathersJP);
+
+  // 予報（英語）は_marqueeが描く
+  String english("  ");
+  english += _weather.weathersEN;
+  _marquee.setText(english.c_str(), L::weatherENRow().size, text, background);
 
   // 気温
-  _data.setCursor(0, 16 * 3);
-  _data.setTextColor(0xFFFF, _bgTemperature);
-  _data.setTextSize(1);
-  _data.print("   Degree:");
-  _data.print(tempe);
-  _data.print("*C     ");
+  canvas.setCursor(0, L::degreeRow().y);
+  canvas.setTextColor(text, temperature);
+  canvas.setTextSize(L::degreeRow().size);
+  canvas.print("   Degree:");
+  canvas.print(number.degree);
+  canvas.print("*C     ");
 
   // 湿度
-  _data.setCursor(0, 16 * 4);
-  _data.setTextColor(0xFFFF, _bgHumidity);
-  _data.setTextSize(1);
-  _data.print(" Humidity:");
-  _data.print(humid);
-  _data.print("%        ");
+  canvas.setCursor(0, L::humidityRow().y);
+  canvas.setTextColor(text, humidity);
+  canvas.setTextSize(L::humidityRow().size);
+  canvas.print(" Humidity:");
+  canvas.print(number.humidity);
+  canvas.print("%        ");
 
   // 大気圧
-  _data.setCursor(0, 16 * 5);
-  _data.setTextColor(0xFFFF, _bgPressure);
-  _data.setTextSize(1);
-  _data.print(" Pressure:");
-  _data.print(press);
-  _data.print("hPa  ");
+  canvas.setCursor(0, L::pressureRow().y);
+  canvas.setTextColor(text, pressure);
+  canvas.setTextSize(L::pressureRow().size);
+  canvas.print(" Pressure:");
+  canvas.print(number.pressure);
+  canvas.print("hPa  ");
 
   // log_d("%2.1f*C, %2.1f%%, %4.1fhPa", _degree, _humidity, _pressure);
+}
+
+template <typename L>
+void Display::_drawWindWave(M5Canvas &canvas) {
+  constexpr uint8_t background = rgb332(L::theme().background);
+  constexpr uint8_t text       = rgb332(L::theme().text);
+  constexpr uint8_t label      = rgb332(L::theme().stale);
+
+  canvas.fillSprite(background);
+  canvas.setTextSize(1);
+
+  // 風
+  canvas.setCursor(0, 0);
+  canvas.setTextColor(label, background);
+  canvas.print(" Wind");
+  canvas.setCursor(0, 16);
+  canvas.setTextColor(text, background);
+  canvas.print(_weather.winds);
+  fontCheckGlyphs("winds", _weather.winds);
+
+  // 波。風の文が折り返した分だけ下げる
+  canvas.setCursor(0, canvas.getCursorY() + 16 + 4);
+  canvas.setTextColor(label, background);
+  canvas.print(" Waves");
+  canvas.setCursor(0, canvas.getCursorY() + 16);
+  canvas.setTextColor(text, background);
+  canvas.print(_weather.waves);
+  fontCheckGlyphs("waves", _weather.waves);
+}
+
+template <typename L>
+void Display::_drawTrend(M5Canvas &canvas) {
+  constexpr LayoutRect area   = L::data();
+  constexpr uint8_t    text   = rgb332(L::theme().text);
+  constexpr uint8_t    line   = rgb332(L::theme().stale);
+  constexpr int        height = area.h / (int)TREND::TREND_MAX;
+  constexpr int        graphX = 72;
+  constexpr int        graphW = area.w - graphX - 2;
+
+  constexpr uint8_t rowColor[] = {
+      rgb332(L::theme().temperature),
+      rgb332(L::theme().humidity),
+      rgb332(L::theme().pressure)};
+  static const char *format[] = {"%5.1f*C", "%5.0f%%", "%6.1fhPa"};
+
+  canvas.fillSprite(rgb332(L::theme().background));
+  canvas.setTextSize(1);
+
+  for (int i = 0; i < (int)TREND::TREND_MAX; i++) {
+    int top = i * height;
+    canvas.fillRect(0, top, area.w, height - 1, rowColor[i]);
+
+    if (_trendCount == 0) {
+      continue;
+    }
 
-  _data.pushSprite(&_display, 2, 140);
-  _data.deleteSprite();
+    // 古い順に並べる
+    float values[DISPLAY_TREND_SIZE];
+    int   oldest = (_trendHead - _trendCount + DISPLAY_TREND_SIZE) % DISPLAY_TREND_SIZE;
+    float low    = _trend[i][oldest];
+    float high   = low;
+
+    for (int k = 0; k < _trendCount; k++) {
+      values[k] = _trend[i][(oldest + k) % DISPLAY_TREND_SIZE];
+      low       = std::min(low, values[k]);
+      high      = std::max(high, values[k]);
+    }
+
+    char label[16];
+    snprintf(label, sizeof(label), format[i], values[_trendCount - 1]);
+    canvas.setTextColor(text, rowColor[i]);
+    canvas.setCursor(0, top + (height - 16) / 2);
+    canvas.print(label);
+
+    if (_trendCount < 2) {
+      continue;
+    }
+
+    float range = high - low;
+    if (range <= 0.0f) {
+      range = 1.0f;
+    }
+
+    int px = 0;
+    int py = 0;
+    for (int k = 0; k < _trendCount; k++) {
+      int x = graphX + k * (graphW - 1) / (_trendCount - 1);
+      int y = top + height - 3 - (int)((values[k] - low) * (height - 5) / range);
+
+      if (k) {
+        canvas.drawLine(px, py, x, y, line);
+      }
+      px = x;
+      py = y;
+    }
+  }
 }
 
 void Display::setImageFilename(String filename) {
@@ -199,11 +623,13 @@ void Display::setImageFilename(String filename) {
 
 void Display::displayImage(void) {
   if (!_animation.createSprite(_width, _height)) {
+    MemoryHealth::failed(SUBSYSTEM::SUBSYSTEM_SPRITE);
     log_e("image allocation failed");
     return;
   }
+  MemoryHealth::Track track(SUBSYSTEM::SUBSYSTEM_SPRITE);
 
-  _animation.fillSprite(_bgColor);
+  _animation.fillSprite(rgb332(DisplayLayout::theme().background));
   // if (_gif.open(_filename.c_str(), _GIFOpenFile, _GIFCloseFile, _GIFReadFile, _GIFSeekFile, _GIFDraw)) {
   //   log_d("success to open %s", _filename.c_str());
   //   _gif.playFrame(true, NULL);
@@ -213,19 +639,126 @@ void Display::displayImage(void) {
 
   // _gif.close();
 
-  _animation.pushSprite(&_display, 110, 70);
+  _animation.pushSprite(&_display, DisplayLayout::animation().x, DisplayLayout::animation().y);
   _animation.deleteSprite();
 }
 
 void Display::update() {
+  // 変わった領域だけスプライトへ描き、それをフレームバッファの枚数分送る
+  uint32_t changedAt      = _changedAt.exchange(0);
+  uint32_t fields         = _weatherFields.exchange(0);
+  uint32_t clockVersion   = _clockLock.version();
+  uint32_t weatherVersion = _weatherLock.version();
+
+  bool clock   = false;
+  bool title   = false;
+  bool weather = false;
+  bool overlay = false;
+
+  if (clockVersion != _clockVersion) {
+    _clockVersion = _clockLock.read(_clock);
+    clock         = true;
+    title         = true;
+  }
+
+  if (weatherVersion != _weatherVersion || fields) {
+    _weatherVersion = _weatherLock.read(_weather);
+
+    // 版とビットの受け渡しがずれた時は、全部描き直す
+    if (fields == 0) {
+      fields = SNAPSHOT_ALL_FIELDS;
+    }
+
+    title   = title || (fields & SNAPSHOT_FIELD(FIELD_STALE));
+    weather = true;
+
+    if (!_weather.stale && (fields & pageFields[(int)PAGE::PAGE_TREND])) {
+      _addTrend();
+    }
+  }
+
+  if (_message == MESSAGE::MSG_UPDATE_DIPLAY) {
+    _message = MESSAGE::MSG_UPDATE_NOTHING;
+    _nextPage();
+  }
+
+  if (_isOverlayDue()) {
+    _overlayShown = _overlay.load(std::memory_order_relaxed);
+    _lastOverlay  = millis();
+    overlay       = true;
+  }
+
+  if (!title && !weather && !overlay && !_titleDirty && !_weatherDirty && !_overlayDirty && !_slide && !_isMarqueeDue()) {
+    return;
+  }
+
+  Metrics::Timer timer(METRIC::METRIC_DISPLAY_UPDATE);
+
+  uint32_t start = micros();
+
   // to Sprite buffer
   // displayImage();
-  displayTitle();
-  displayWeather();
+  if (title) {
+    displayTitle();
+    _titleDirty = DISPLAY_BUFFERS;
+  }
+
+  if (weather && _renderPages(fields)) {
+    _weatherDirty = DISPLAY_BUFFERS;
+  }
+
+  if (overlay) {
+    _drawOverlay();
+    _overlayDirty = DISPLAY_BUFFERS;
+  }
+
+  // to CVBS back buffer
+  uint32_t pushed = micros();
+  _present();
 
-  // to CVBS buffer
+  // 垂直帰線期間でバッファを入れ替える
+  uint32_t swapped = micros();
   _display.display();
-  delay(1);
+  uint32_t shown = micros();
+
+  _lastRaster = pushed - start;
+  _lastPush   = swapped - pushed;
+  _lastSwap   = shown - swapped;
+
+  Metrics::observe(METRIC::METRIC_DISPLAY_RASTERIZE, _lastRaster);
+  Metrics::observe(METRIC::METRIC_DISPLAY_PUSH, _lastPush);
+  Metrics::observe(METRIC::METRIC_DISPLAY_SWAP, _lastSwap);
+
+  // 状態が変わってから画面に出るまで
+  if (changedAt) {
+    _lastLatency = shown - changedAt;
+    Metrics::observe(METRIC::METRIC_PRESENT_LATENCY, _lastLatency);
+  }
+
+  // 秒の境界から、その時刻が画面に出るまで
+  if (clock && _clock.boundary) {
+    int32_t skew = (int32_t)(shown - _clock.boundary);
+    Metrics::observe(METRIC::METRIC_CLOCK_SKEW, skew < 0 ? -skew : skew);
+  }
+
+  // 描画が1フィールドに収まらなければ、途中の画面が出た可能性がある
+  if (swapped - start > DISPLAY_FIELD_US) {
+    _tornFrames++;
+  }
+
+  _frames++;
+  _fpsFrames++;
+  if (millis() - _fpsStart >= 1000) {
+    _fps       = _fpsFrames * 1000 / (millis() - _fpsStart);
+    _fpsFrames = 0;
+    _fpsStart  = millis();
+  }
+
+  if (_firstFrame) {
+    _firstFrame   = false;
+    _firstFrameMs = millis();
+    log_i("Boot to first frame : %lu ms", _firstFrameMs);
+  }
 }
 
 void *Display::_GIFOpenFile(const char *fname, int32_t *pSize) {
@@ -273,79 +806,113 @@ int32_t Display::_GIFSeekFile(GIFFILE *pFile, int32_t iPosition) {
   return pFile->iPos;
 }
 
+// スプライトのバッファ(RGB332)へ、1ライン分のバイトを直接書き込む
 void Display::_GIFDraw(GIFDRAW *pDraw) {
-  uint8_t  *s;
-  uint16_t *d, *usPalette, usTemp[240];
-  int       x, y, iWidth;
+  int y      = pDraw->iY + pDraw->y;  // current line
+  int iWidth = pDraw->iWidth;
 
-  iWidth = pDraw->iWidth;
-  if (iWidth > _width)
-    iWidth = _width;
+  if (y >= _height || pDraw->iX >= _width) {
+    return;
+  }
+
+  if (pDraw->iX + iWidth > _width)
+    iWidth = _width - pDraw->iX;
+
+  // パレットはフレームの最初のラインで一度だけ変換する
+  if (pDraw->y == 0 || pDraw->pPalette != _palette) {
+    _palette = pDraw->pPalette;
+    for (int i = 0; i < 256; i++) {
+      _lut[i] = rgb332(_palette[i]);
+    }
+  }
 
-  usPalette = pDraw->pPalette;
-  y         = pDraw->iY + pDraw->y;  // current line
+  uint8_t *buffer = static_cast<uint8_t *>(_animation.getBuffer());
+  if (buffer == nullptr) {
+    return;
+  }
+
+  uint8_t *s = pDraw->pPixels;
+  uint8_t *d = buffer + y * _width + pDraw->iX;
 
-  s = pDraw->pPixels;
   if (pDraw->ucDisposalMethod == 2)  // restore to background color
   {
-    for (x = 0; x < iWidth; x++) {
+    for (int x = 0; x < iWidth; x++) {
       if (s[x] == pDraw->ucTransparent)
         s[x] = pDraw->ucBackground;
     }
     pDraw->ucHasTransparency = 0;
   }
 
-  // Apply the new pixels to the main image
-  if (pDraw->ucHasTransparency)  // if transparency used
-  {
-    uint8_t *pEnd, c, ucTransparent = pDraw->ucTransparent;
-    int      x, iCount;
-    pEnd   = s + iWidth;
-    x      = 0;
-    iCount = 0;  // count non-transparent pixels
-    while (x < iWidth) {
-      c = ucTransparent - 1;
-      d = usTemp;
-      while (c != ucTransparent && s < pEnd) {
-        c = *s++;
-        if (c == ucTransparent)  // done, stop
-        {
-          s--;  // back up to treat it like transparent
-        } else  // opaque
-        {
-          *d++ = usPalette[c];
-          iCount++;
-        }
-      }              // while looking for opaque pixels
-      if (iCount) {  // any opaque pixels?
-        _animation.setWindow(pDraw->iX + x, y, iCount, 1);
-        _animation.pushPixels((uint16_t *)usTemp, iCount, true);
-        x += iCount;
-        iCount = 0;
-      }
-
-      // no, look for a run of transparent pixels
-      c = ucTransparent;
-      while (c == ucTransparent && s < pEnd) {
-        c = *s++;
-        if (c == ucTransparent)
-          iCount++;
-        else
-          s--;
-      }
-      if (iCount) {
-        x += iCount;  // skip these
-        iCount = 0;
-      }
-    }
+  if (pDraw->ucHasTransparency) {
+    gifBlitTransparent(d, s, iWidth, pDraw->ucTransparent, _lut);
   } else {
-    s = pDraw->pPixels;
-    // Translate the 8-bit pixels through the RGB565 palette (already byte reversed)
-    for (x = 0; x < iWidth; x++) {
-      usTemp[x] = usPalette[*s++];
+    gifBlitOpaque(d, s, iWidth, _lut);
+  }
+}
+
+#if defined(ATOM_BENCHMARK)
+void Display::benchmark(const WeatherSnapshot &weather) {
+  _weather = weather;
+  strlcpy(_clock.day, "2022/01/01(Sat)", sizeof(_clock.day));
+  strlcpy(_clock.time, "12:34:56", sizeof(_clock.time));
+
+  Benchmark::run("displayTitle", [this]() {
+    displayTitle();
+  });
+
+  Benchmark::run("displayWeather", [this]() {
+    displayWeather();
+  });
+
+  Benchmark::run("drawToday", [this]() {
+    _drawToday<DisplayLayout>(_pages[(int)PAGE::PAGE_TODAY]);
+  });
+
+  // GIFの1フレーム分のラインを_GIFDrawへ渡す
+  if (!_animation.createSprite(_width, _height)) {
+    log_e("image allocation failed");
+    return;
+  }
+
+  std::unique_ptr<uint8_t[]>  pixels(new uint8_t[_width]);
+  std::unique_ptr<uint16_t[]> palette(new uint16_t[256]);
+
+  for (int i = 0; i < 256; i++) {
+    palette[i] = i * 257;
+  }
+
+  GIFDRAW draw;
+  memset(&draw, 0, sizeof(draw));
+  draw.iWidth        = _width;
+  draw.iCanvasWidth  = _width;
+  draw.pPixels       = pixels.get();
+  draw.pPalette      = palette.get();
+  draw.ucTransparent = 0;
+
+  auto frame = [&]() {
+    for (int y = 0; y < _height; y++) {
+      draw.y = y;
+      _GIFDraw(&draw);
     }
+  };
 
-    _animation.setWindow(pDraw->iX, y, iWidth, 1);
-    _animation.pushPixels((uint16_t *)usTemp, iWidth, true);
+  size_t bytes = _width * _height;
+
+  for (int x = 0; x < _width; x++) {
+    pixels[x] = 1 + x % 255;
+  }
+  draw.ucHasTransparency = 0;
+  Benchmark::run("gifDraw/opaque", frame, BENCHMARK_ITERATIONS, bytes);
+
+  draw.ucHasTransparency = 1;
+  Benchmark::run("gifDraw/noTransparent", frame, BENCHMARK_ITERATIONS, bytes);
+
+  // 半分が透明。4画素ずつの判定が効かない並び
+  for (int x = 0; x < _width; x++) {
+    pixels[x] = x % 2 ? 1 + x % 255 : 0;
   }
+  Benchmark::run("gifDraw/halfTransparent", frame, BENCHMARK_ITERATIONS, bytes);
+
+  _animation.deleteSprite();
 }
+#endif
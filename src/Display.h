@@ -24,33 +24,94 @@ SOFTWARE.
 
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <Arduino.h>
 #include <AnimatedGIF.h>
 #include <ArduinoJson.h>
 #include <SPIFFS.h>
+#include <Ticker.h>
+#include <Layout.h>
+#include <Marquee.hpp>
 #include <message.h>
+#include <Seqlock.h>
+#include <Task.h>
+#include <WeatherSnapshot.h>
 
-#include <efontEnableJaMini.h>
-#include <efontFontData.h>
+#include <Font.h>
 #include <M5Unified.h>
 #include <ESP32_8BIT_CVBS.h>
 
-class Display {
+// 映像の方式。-D DISPLAY_PAL でPAL(50Hz)、既定はNTSC(59.94Hz)
+// ESP32_8BIT_CVBS側の設定と合わせること
+#if defined(DISPLAY_PAL)
+#define DISPLAY_FIELD_US 20000
+#else
+#define DISPLAY_FIELD_US 16683
+#endif
+
+// 何フィールドごとに1フレーム描くか
+#ifndef DISPLAY_FIELDS_PER_FRAME
+#define DISPLAY_FIELDS_PER_FRAME 3
+#endif
+
+// 描画タスクの周期 [ms]。フィールドの整数倍にする
+#ifndef DISPLAY_FRAME_MS
+#define DISPLAY_FRAME_MS ((DISPLAY_FIELD_US * DISPLAY_FIELDS_PER_FRAME + 500) / 1000)
+#endif
+
+// CVBSのフレームバッファの枚数。変更はこの回数だけ描く
+#ifndef DISPLAY_BUFFERS
+#define DISPLAY_BUFFERS 2
+#endif
+
+// デバッグ表示の更新周期 [ms]
+#ifndef DISPLAY_OVERLAY_MS
+#define DISPLAY_OVERLAY_MS 1000
+#endif
+
+// ページを切り替える周期 [ms]
+#ifndef DISPLAY_PAGE_MS
+#define DISPLAY_PAGE_MS 10000
+#endif
+
+// スライドにかけるフレーム数。0なら瞬時に切り替える
+#ifndef DISPLAY_SLIDE_FRAMES
+#define DISPLAY_SLIDE_FRAMES 6
+#endif
+
+// 推移ページに残す観測値の数
+#ifndef DISPLAY_TREND_SIZE
+#define DISPLAY_TREND_SIZE 24
+#endif
+
+enum class PAGE : int {
+  PAGE_TODAY,
+  PAGE_WIND_WAVE,
+  PAGE_TREND,
+  PAGE_MAX
+};
+
+enum class TREND : int {
+  TREND_DEGREE,
+  TREND_HUMIDITY,
+  TREND_PRESSURE,
+  TREND_MAX
+};
+
+class Display : public Task {
  public:
   Display(void);
   void begin(void);
+  void startRender(void);
   void update(void);
 
-  void setNtpTime(String ntpTime);
-  void setYMD(String ymd);
+  void setDayTime(String ymd, String ntpTime, uint32_t boundary = 0);
   void displayTitle(void);
 
-  void setDegree(float degree);
-  void setHumidity(float humidity);
-  void setAtomPressure(float pressure);
-  void setWeatherforcastJP(String forecastJP);
-  void setWeatherforcastEN(String forecastEN);
+  // ネットワークタスクから呼ぶ。描画タスクは次のフレームで受け取る
+  // fieldsは変わったフィールド(SNAPSHOT_FIELD)。使うページだけを描き直す
+  void setWeather(const WeatherSnapshot &weather, uint32_t fields = SNAPSHOT_ALL_FIELDS);
   void displayWeather(void);
 
   void setImageFilename(String filename);
@@ -58,39 +119,119 @@ class Display {
 
   static void sendMessage(MESSAGE message);
 
+  // 各段の処理時間とフレーム数。Webから画面上の表示を切り替える
+  void   setOverlay(bool enable);
+  String getProfile(void);
+
+#if defined(ATOM_BENCHMARK)
+  // 描画とGIFのライン転送を計る。描画タスクを動かす前に呼ぶ
+  void benchmark(const WeatherSnapshot &weather);
+#endif
+
+ protected:
+  void run(void *data);
+
  private:
+  struct ClockFrame {
+    char     day[24];
+    char     time[16];
+    uint32_t boundary;  // この時刻になった境界 [micros()]。不明なら0
+  };
+
   AnimatedGIF _gif;
 
+  bool _isDirty(void);
+  bool _isOverlayDue(void);
+  void _drawOverlay(void);
+  bool _createSprite(M5Canvas &canvas, const LayoutRect &area);
+  void _present(void);
+  void _markChanged(void);
+
+  // レイアウトごとに実体化する
+  template <typename L>
+  void _drawTitle(void);
+  template <typename L>
+  void _drawToday(M5Canvas &canvas);
+  template <typename L>
+  void _drawWindWave(M5Canvas &canvas);
+  template <typename L>
+  void _drawTrend(M5Canvas &canvas);
+
+  bool        _isMarqueeDue(void);
+  bool        _renderPages(uint32_t fields);
+  void        _addTrend(void);
+  void        _nextPage(void);
+  static void _onPage(Display *display);
+
   static inline void    _GIFDraw(GIFDRAW *pDraw);
   static inline void   *_GIFOpenFile(const char *fname, int32_t *pSize);
   static inline void    _GIFCloseFile(void *pHandle);
   static inline int32_t _GIFReadFile(GIFFILE *pFile, uint8_t *pBuf, int32_t iLen);
   static inline int32_t _GIFSeekFile(GIFFILE *pFile, int32_t iPosition);
 
-  String _time;
-  String _day;
-  String _daytimeFormat;
-
-  float  _degree;
-  float  _humidity;
-  float  _pressure;
-  String _forecastJP;
-  String _forecastEN;
-  String _filename;  // Weather Animation GIF
-
-  uint16_t _bgColor;
-  uint16_t _bgTitle;
-  uint16_t _bgTemperature;
-  uint16_t _bgPressure;
-  uint16_t _bgHumidity;
+  String   _daytimeFormat;
+  String   _filename;  // Weather Animation GIF
+  bool     _firstFrame;
+  uint32_t _firstFrameMs;
+
+  // 描画タスクとの受け渡し
+  Seqlock<ClockFrame>      _clockLock;
+  Seqlock<WeatherSnapshot> _weatherLock;
+
+  // 描画タスク側のコピー
+  ClockFrame      _clock;
+  WeatherSnapshot _weather;
+  uint32_t        _clockVersion;
+  uint32_t        _weatherVersion;
+  uint8_t         _titleDirty;
+  uint8_t         _weatherDirty;
+
+  uint32_t _lateFrames;
+
+  // ページは天気が変わった時に全部描いておき、切り替えは転送だけにする
+  int     _page;
+  int     _next;
+  uint8_t _slide;
+  Ticker  _pageTicker;
+  Marquee _marquee;  // 予報（英語）の行
+
+  float _trend[(int)TREND::TREND_MAX][DISPLAY_TREND_SIZE];
+  int   _trendHead;
+  int   _trendCount;
+
+  // プロファイラ
+  uint32_t          _lastRaster;
+  uint32_t          _lastPush;
+  uint32_t          _lastSwap;
+  uint32_t          _lastLatency;
+
+  // まだ画面に出ていない最初の変更の時刻 [us]
+  std::atomic<uint32_t> _changedAt;
+  std::atomic<uint32_t> _weatherFields;
+
+  uint32_t          _frames;
+  uint32_t          _droppedFrames;
+  uint32_t          _tornFrames;
+  uint32_t          _fps;
+  uint32_t          _fpsFrames;
+  uint32_t          _fpsStart;
+  std::atomic<bool> _overlay;
+  bool              _overlayShown;
+  uint32_t          _lastOverlay;
+  uint8_t           _overlayDirty;
 
   static File    _file;
   static int     _width;
   static int     _height;
+
+  // GIFのパレット(RGB565)からRGB332への変換表
+  static uint8_t   _lut[256];
+  static uint16_t *_palette;
   static MESSAGE _message;
 
   static ESP32_8BIT_CVBS _display;
   static M5Canvas        _animation;
   M5Canvas               _title;
-  M5Canvas               _data;
+  M5Canvas               _pages[(int)PAGE::PAGE_MAX];
+  M5Canvas               _overlayCanvas;
 };
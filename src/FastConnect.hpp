@@ -0,0 +1,207 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <AutoConnect.h>
+#include <Preferences.h>
+#include <WiFi.h>
+#include <esp32-hal-log.h>
+
+// 前回のアクセスポイントへ直接繋ぐ時に待つ時間 [ms]
+#ifndef FASTCONNECT_TIMEOUT_MS
+#define FASTCONNECT_TIMEOUT_MS 2000
+#endif
+
+// 固定IPにする場合は -D FASTCONNECT_STATIC_IP=\"192.168.1.50\" のように指定する
+// 指定が無ければ、アドレスは普段通りDHCPで受け取る
+#ifndef FASTCONNECT_STATIC_IP
+#define FASTCONNECT_STATIC_IP ""
+#endif
+
+#ifndef FASTCONNECT_GATEWAY
+#define FASTCONNECT_GATEWAY ""
+#endif
+
+#ifndef FASTCONNECT_SUBNET
+#define FASTCONNECT_SUBNET "255.255.255.0"
+#endif
+
+#ifndef FASTCONNECT_DNS
+#define FASTCONNECT_DNS FASTCONNECT_GATEWAY
+#endif
+
+// 前回繋がったBSSIDとチャンネルをNVSに残し、次回はスキャンを飛ばして繋ぐ
+// パスワードはここには持たず、AutoConnectが保存した認証情報から読む
+class FastConnect {
+ public:
+  FastConnect(const char *name = "fastconnect") : _name(name),
+                                                  _valid(false),
+                                                  _associateMs(0) {
+    memset(&_cache, 0, sizeof(_cache));
+  }
+
+  bool restore(void) {
+    Preferences prefs;
+
+    if (!prefs.begin(_name, true)) {
+      return false;
+    }
+
+    // 大きさが違うとgetBytes()は何も読まないので、先に長さを見る
+    size_t length = prefs.getBytesLength("cache");
+    if (length == sizeof(_cache)) {
+      prefs.getBytes("cache", &_cache, sizeof(_cache));
+    }
+    prefs.end();
+
+    _valid = length == sizeof(_cache) && _cache.version == CACHE_VERSION && _cache.ssid[0] != '\0';
+
+    // 古い形式はパスワードを平文で持っていたので、残さず消す
+    if (!_valid && length > 0) {
+      invalidate();
+    }
+
+    return _valid;
+  }
+
+  // 繋がった後に呼ぶ。変わった時だけ書き込む
+  void save(void) {
+    Cache cache;
+    memset(&cache, 0, sizeof(cache));
+
+    cache.version = CACHE_VERSION;
+    cache.channel = WiFi.channel();
+    memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+    strlcpy(cache.ssid, WiFi.SSID().c_str(), sizeof(cache.ssid));
+
+    if (_valid && memcmp(&cache, &_cache, sizeof(cache)) == 0) {
+      return;
+    }
+
+    Preferences prefs;
+
+    if (!prefs.begin(_name, false)) {
+      log_e("fail to open %s", _name);
+      return;
+    }
+
+    prefs.putBytes("cache", &cache, sizeof(cache));
+    prefs.end();
+
+    _cache = cache;
+    _valid = true;
+
+    log_d("fast connect cache saved. channel %d", _cache.channel);
+  }
+
+  void invalidate(void) {
+    Preferences prefs;
+
+    if (prefs.begin(_name, false)) {
+      prefs.remove("cache");
+      prefs.end();
+    }
+
+    _valid = false;
+  }
+
+  // 失敗したらAutoConnectに任せる
+  bool connect(void) {
+    if (!_valid && !restore()) {
+      return false;
+    }
+
+    AutoConnectCredential credential;
+    station_config_t      config;
+
+    if (credential.load(_cache.ssid, &config) < 0) {
+      log_w("no credential for %s. fall back to AutoConnect.", _cache.ssid);
+      invalidate();
+      return false;
+    }
+
+    // AutoConnectのパスワードは終端が無いことがある
+    char password[sizeof(config.password) + 1];
+    memcpy(password, config.password, sizeof(config.password));
+    password[sizeof(config.password)] = '\0';
+    memset(&config, 0, sizeof(config));
+
+    bool static_ip = !String(FASTCONNECT_STATIC_IP).isEmpty();
+
+    uint32_t start = millis();
+
+    WiFi.mode(WIFI_STA);
+    if (static_ip) {
+      IPAddress ip, gateway, subnet, dns;
+      ip.fromString(FASTCONNECT_STATIC_IP);
+      gateway.fromString(FASTCONNECT_GATEWAY);
+      subnet.fromString(FASTCONNECT_SUBNET);
+      dns.fromString(FASTCONNECT_DNS);
+      WiFi.config(ip, gateway, subnet, dns);
+    }
+    WiFi.begin(_cache.ssid, password, _cache.channel, _cache.bssid, true);
+    memset(password, 0, sizeof(password));
+
+    while (WiFi.status() != WL_CONNECTED) {
+      if (millis() - start > FASTCONNECT_TIMEOUT_MS) {
+        log_w("fast connect timed out. fall back to AutoConnect.");
+
+        WiFi.disconnect();
+        if (static_ip) {
+          WiFi.config(IPAddress(), IPAddress(), IPAddress());
+        }
+        invalidate();
+        return false;
+      }
+      delay(10);
+    }
+
+    _associateMs = millis() - start;
+    log_i("fast connect : %lu ms, channel %d", _associateMs, _cache.channel);
+
+    return true;
+  }
+
+  uint32_t getAssociateMs(void) {
+    return _associateMs;
+  }
+
+ private:
+  static const uint8_t CACHE_VERSION = 2;
+
+  // アドレスは残さない。DHCPを飛ばすと、期限切れのリースを使い続けてしまう
+  struct Cache {
+    uint8_t version;
+    uint8_t channel;
+    uint8_t bssid[6];
+    char    ssid[33];
+  };
+
+  const char *_name;
+  Cache       _cache;
+  bool        _valid;
+  uint32_t    _associateMs;
+};
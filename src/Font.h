@@ -0,0 +1,76 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+// fonts::efontはこのデータを使うので、LovyanGFX(M5Unified)より先に読み込む
+// FONT_SUBSETはtools/font_subset.pyが、使う文字だけのヘッダを作った時に付ける
+#if defined(FONT_SUBSET)
+#include <efontSubset.h>
+#else
+#include <efontEnableJaMini.h>
+#include <efontFontData.h>
+#endif
+
+#include <esp32-hal-log.h>
+
+#include <algorithm>
+
+// フォントに無い最初の文字。すべてあれば0
+// efontFontListは文字コードの昇順。4バイトのUTF-8はefontに無いので、そのまま返す
+inline uint32_t fontMissingGlyph(const char *text) {
+  const uint16_t *first = efontFontList;
+  const uint16_t *last  = efontFontList + sizeof(efontFontList) / sizeof(efontFontList[0]);
+  const uint8_t  *p     = (const uint8_t *)text;
+
+  while (p && *p) {
+    uint32_t code = *p++;
+    int      more = code >= 0xF0 ? 3 : code >= 0xE0 ? 2 : code >= 0xC0 ? 1 : 0;
+
+    code &= more == 3 ? 0x07 : more == 2 ? 0x0F : more == 1 ? 0x1F : 0x7F;
+    while (more-- > 0 && (*p & 0xC0) == 0x80) {
+      code = (code << 6) | (*p++ & 0x3F);
+    }
+
+    if (code < 0x20) {
+      continue;
+    }
+
+    if (code > 0xFFFF || !std::binary_search(first, last, (uint16_t)code)) {
+      return code;
+    }
+  }
+
+  return 0;
+}
+
+// 足りない文字は空白で描かれる。tools/font_chars.txt か test/corpus/jma に加える
+inline void fontCheckGlyphs(const char *name, const char *text) {
+  uint32_t code = fontMissingGlyph(text);
+
+  if (code) {
+    log_w("no glyph for U+%04X in %s: %s", code, name, text);
+  }
+}
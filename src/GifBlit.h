@@ -0,0 +1,76 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+
+// GIFのインデックスをRGB332のLUTで変換して書き込む
+// ESP32に依存しないので、ホストのテストからも使う
+
+inline void gifBlitOpaque(uint8_t *d, const uint8_t *s, int width, const uint8_t *lut) {
+  for (int x = 0; x < width; x++) {
+    d[x] = lut[s[x]];
+  }
+}
+
+// 透明な画素は書かずに残す。4画素ずつまとめて透明かどうかを調べる
+inline void gifBlitTransparent(uint8_t *d, const uint8_t *s, int width, uint8_t transparent, const uint8_t *lut) {
+  const uint32_t ones    = 0x01010101;
+  const uint32_t pattern = transparent * ones;
+
+  int x = 0;
+  for (; x + 4 <= width; x += 4) {
+    uint32_t word;
+    memcpy(&word, s + x, sizeof(word));  // 境界が揃っていなくても読める
+
+    // 透明な画素のバイトが0になる
+    uint32_t diff = word ^ pattern;
+
+    if (diff == 0) {
+      continue;  // 4画素とも透明
+    }
+
+    if (((diff - ones) & ~diff & 0x80808080) == 0) {
+      // 4画素とも不透明
+      d[x + 0] = lut[s[x + 0]];
+      d[x + 1] = lut[s[x + 1]];
+      d[x + 2] = lut[s[x + 2]];
+      d[x + 3] = lut[s[x + 3]];
+      continue;
+    }
+
+    for (int i = x; i < x + 4; i++) {
+      if (s[i] != transparent)
+        d[i] = lut[s[i]];
+    }
+  }
+
+  for (; x < width; x++) {
+    if (s[x] != transparent)
+      d[x] = lut[s[x]];
+  }
+}
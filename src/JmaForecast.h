@@ -0,0 +1,183 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp32-hal-log.h>
+
+#include <WeatherSnapshot.h>
+
+#include <cctype>
+#include <utility>
+
+// 入れ子の深さ。JMAの予報は7段
+#ifndef DOC_JMA_NESTING
+#define DOC_JMA_NESTING 8
+#endif
+
+// JMAの応答を読む上限。超えたら壊れた応答として捨てる
+#ifndef DOC_JMA_MAX_BYTES
+#define DOC_JMA_MAX_BYTES (64 * 1024)
+#endif
+
+#ifndef DOC_JMA_MAX_MS
+#define DOC_JMA_MAX_MS 10000
+#endif
+
+// フィルタを通した予報を読む大きさ。256個の値と2KBの文字列(ESP32では6144バイト)
+#define DOC_JMA_CAPACITY (JSON_ARRAY_SIZE(256) + 2048)
+
+// jmaFilter()を読む大きさ。キーの文字列は100バイト
+#define DOC_JMA_FILTER_CAPACITY (JSON_ARRAY_SIZE(1) + JSON_OBJECT_SIZE(3) + JSON_ARRAY_SIZE(1) + JSON_OBJECT_SIZE(2) + JSON_ARRAY_SIZE(1) + JSON_OBJECT_SIZE(5) + 128)
+
+// codes.jsonの1項目 {"220": [アイコン, 夜のアイコン, 代表コード, 日本語, 英語]}
+// 文字列は一番長い項目で122バイト
+#define DOC_CODES_CAPACITY (JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(5) + 160)
+#define DOC_CODES_FILTER_CAPACITY (JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(1) + 8)
+
+// 気象庁の予報(forecast/data/forecast/NNNNNN.json)から、表示に使う項目を取り出す
+// ArduinoJsonとStringだけを使うので、ホストのテストとファジングからも呼べる
+
+// JMAの応答から使う項目だけを残すフィルタ
+inline const char *jmaFilter(void) {
+  // R"()" = Raw String Literals(C++)
+  return R"(
+    [
+      {
+        "publishingOffice": true,
+        "reportDatetime": true,
+        "timeSeries": [
+          {
+            "timeDefines": true,
+            "areas": [
+              {
+                "area": true,
+                "weatherCodes": true,
+                "weathers": true,
+                "winds": true,
+                "waves": true
+              }
+            ]
+          }
+        ]
+      }
+    ])";
+}
+
+// JMAの応答をフィルタを通して読む
+// inputは応答の本文(HTTPClientのStream、再生したClient、const char *とサイズ)
+template <typename... TInput>
+inline DeserializationError readJmaForecast(JsonDocument &doc, TInput &&...input) {
+  StaticJsonDocument<DOC_JMA_FILTER_CAPACITY> filter;
+  deserializeJson(filter, jmaFilter());
+
+  return deserializeJson(doc,
+                         std::forward<TInput>(input)...,
+                         DeserializationOption::Filter(filter),
+                         DeserializationOption::NestingLimit(DOC_JMA_NESTING));
+}
+
+inline bool parseJmaForecast(JsonDocument &doc, WeatherSnapshot &weather) {
+  JsonObject root_0 = doc[0];  // 0 or 1
+
+  if (root_0.isNull()) {
+    return false;
+  }
+
+  setSnapshotField(weather.publishingOffice, root_0["publishingOffice"]);
+  setSnapshotField(weather.reportDatetime, root_0["reportDatetime"]);
+
+  log_i("publishingOffice  %s", weather.publishingOffice);
+  log_i("  reportDatetime  %s", weather.reportDatetime);
+
+  JsonArray timeSeries = root_0["timeSeries"];
+
+  if (!timeSeries.isNull()) {
+    JsonObject areas_0 = timeSeries[0]["areas"][0];
+
+    setSnapshotField(weather.timeDefines, timeSeries[0]["timeDefines"][0]);
+    setSnapshotField(weather.area, areas_0["area"]["name"]);
+
+    JsonArray weatherCodes = areas_0["weatherCodes"];
+    JsonArray winds        = areas_0["winds"];
+    JsonArray waves        = areas_0["waves"];
+
+    if (!weatherCodes.isNull()) {
+      setSnapshotField(weather.weatherCodes, weatherCodes[0]);
+    }
+
+    if (!winds.isNull()) {
+      setSnapshotField(weather.winds, winds[0]);
+    }
+
+    if (!waves.isNull()) {
+      setSnapshotField(weather.waves, waves[0]);
+    }
+  }
+
+  return true;
+}
+
+//天気予報コードより、予報文言とアイコンファイル名を取得する
+// inputはcodes.jsonの中身(const char *とサイズ、またはStream)
+template <typename... TInput>
+inline bool lookupWeatherCode(WeatherSnapshot &weather, TInput &&...input) {
+  // 天気予報コードは数字3桁。フィルタの文字列に埋め込むので、それ以外は使わない
+  const char *code = weather.weatherCodes;
+  if (strlen(code) != 3 || !isdigit(code[0]) || !isdigit(code[1]) || !isdigit(code[2])) {
+    log_w("invalid weather code. %s", code);
+    return false;
+  }
+
+  String filter(R"({"__CODE__": [true]})");
+  filter.replace("__CODE__", weather.weatherCodes);
+
+  StaticJsonDocument<DOC_CODES_CAPACITY>        forecastDoc;
+  StaticJsonDocument<DOC_CODES_FILTER_CAPACITY> forecastfilter;
+  deserializeJson(forecastfilter, filter);
+
+  DeserializationError error = deserializeJson(forecastDoc,
+                                               std::forward<TInput>(input)...,
+                                               DeserializationOption::Filter(forecastfilter));
+
+  if (error) {
+    log_e("Failed to read codes.json.");
+    return false;
+  }
+
+  JsonArray root = forecastDoc[(const char *)weather.weatherCodes];
+
+  if (root.isNull()) {
+    return false;
+  }
+
+  snprintf(weather.iconFile, sizeof(weather.iconFile), "/%s", (const char *)root[0]);  // "100.gif"
+  setSnapshotField(weather.weathersJP, root[3]);                                       // "晴"
+  setSnapshotField(weather.weathersEN, root[4]);                                       // "CLEAR"
+
+  return true;
+}
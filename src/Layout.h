@@ -0,0 +1,117 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// 画面の配置と色。すべてコンパイル時に決まるので、描画時に表を引く処理は残らない
+struct LayoutRect {
+  int16_t x;
+  int16_t y;
+  int16_t w;
+  int16_t h;
+};
+
+// スプライト内の1行。yはピクセル、sizeは文字の倍率
+struct LayoutRow {
+  int16_t y;
+  uint8_t size;
+};
+
+struct LayoutTheme {
+  uint16_t background;
+  uint16_t title;
+  uint16_t text;
+  uint16_t stale;
+  uint16_t temperature;
+  uint16_t humidity;
+  uint16_t pressure;
+};
+
+// スプライトは8bit(RGB332)なので、色はコンパイル時に変換しておく
+// lgfxはuint8_tの色をRGB332として、そのまま書き込む
+constexpr uint8_t rgb332(uint16_t rgb565) {
+  return ((rgb565 >> 8) & 0xE0) | ((rgb565 >> 6) & 0x1C) | ((rgb565 >> 3) & 0x03);
+}
+
+// これまでの配置
+struct LayoutStation {
+  static constexpr const char *titleText(void) { return " Osaka Weather Station"; }
+
+  static constexpr LayoutRect title(void) { return {2, 9, 239, 32}; }
+  static constexpr LayoutRect data(void) { return {2, 140, 174, 96}; }
+  static constexpr LayoutRect animation(void) { return {110, 70, 140, 160}; }
+  static constexpr LayoutRect overlay(void) { return {2, 44, 239, 16}; }
+
+  static constexpr LayoutRow titleRow(void) { return {16 * 0, 1}; }
+  static constexpr LayoutRow clockRow(void) { return {16 * 1, 1}; }
+  static constexpr int16_t   clockX(void) { return 16; }
+
+  static constexpr LayoutRow weatherJPRow(void) { return {16 * 0, 2}; }
+  static constexpr LayoutRow weatherENRow(void) { return {16 * 2, 1}; }
+  static constexpr LayoutRow degreeRow(void) { return {16 * 3, 1}; }
+  static constexpr LayoutRow humidityRow(void) { return {16 * 4, 1}; }
+  static constexpr LayoutRow pressureRow(void) { return {16 * 5, 1}; }
+
+  static constexpr LayoutTheme theme(void) {
+    return {0x10cd, 0x0019, 0xFFFF, 0xFFE0, 0x1c43, 0x1c43, 0x1c43};
+  }
+};
+
+// 文字を小さくして、天気を画面の下半分に並べる
+struct LayoutCompact {
+  static constexpr const char *titleText(void) { return " Osaka Weather"; }
+
+  static constexpr LayoutRect title(void) { return {0, 0, 240, 32}; }
+  static constexpr LayoutRect data(void) { return {0, 144, 240, 96}; }
+  static constexpr LayoutRect animation(void) { return {50, 36, 140, 104}; }
+  static constexpr LayoutRect overlay(void) { return {0, 36, 240, 16}; }
+
+  static constexpr LayoutRow titleRow(void) { return {16 * 0, 1}; }
+  static constexpr LayoutRow clockRow(void) { return {16 * 1, 1}; }
+  static constexpr int16_t   clockX(void) { return 8; }
+
+  static constexpr LayoutRow weatherJPRow(void) { return {16 * 0, 1}; }
+  static constexpr LayoutRow weatherENRow(void) { return {16 * 1, 1}; }
+  static constexpr LayoutRow degreeRow(void) { return {16 * 3, 1}; }
+  static constexpr LayoutRow humidityRow(void) { return {16 * 4, 1}; }
+  static constexpr LayoutRow pressureRow(void) { return {16 * 5, 1}; }
+
+  static constexpr LayoutTheme theme(void) {
+    return {0x0000, 0x2104, 0xFFFF, 0xFD20, 0x18e3, 0x18e3, 0x18e3};
+  }
+};
+
+// -D DISPLAY_LAYOUT=LayoutCompact のように選ぶ
+#ifndef DISPLAY_LAYOUT
+#define DISPLAY_LAYOUT LayoutStation
+#endif
+
+using DisplayLayout = DISPLAY_LAYOUT;
+
+static_assert(DisplayLayout::title().w > 0 && DisplayLayout::title().h > 0, "empty title area");
+static_assert(DisplayLayout::data().w > 0 && DisplayLayout::data().h > 0, "empty data area");
+static_assert(DisplayLayout::overlay().w > 0 && DisplayLayout::overlay().h > 0, "empty overlay area");
+static_assert(DisplayLayout::animation().w > 0 && DisplayLayout::animation().h > 0, "empty animation area");
@@ -0,0 +1,182 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <Layout.h>
+#include <MemoryHealth.h>
+
+#include <Font.h>
+#include <M5Unified.h>
+#include <esp32-hal-log.h>
+
+#include <algorithm>
+
+// 1フレームに進める量 [px]
+#ifndef MARQUEE_SPEED
+#define MARQUEE_SPEED 2
+#endif
+
+// 文の末尾と先頭の間隔 [px]
+#ifndef MARQUEE_GAP
+#define MARQUEE_GAP 32
+#endif
+
+#ifndef MARQUEE_MAX_WIDTH
+#define MARQUEE_MAX_WIDTH 1024
+#endif
+
+// 長い文を1行で流す。文字は帯のスプライトに一度だけ描き、
+// 毎フレームは表示する幅だけを行ごとにmemcpyする
+class Marquee {
+ public:
+  Marquee(void) : _area({0, 0, 0, 0}),
+                  _offset(0),
+                  _stripWidth(0),
+                  _frames(0),
+                  _lastUs(0),
+                  _maxUs(0),
+                  _totalUs(0) {
+  }
+
+  void begin(const LayoutRect &area) {
+    _area = area;
+
+    _strip.setFont(&fonts::efont);
+    _strip.setTextWrap(false, false);
+    _strip.setPsram(false);
+    _strip.setColorDepth(8);
+
+    _window.setPsram(false);
+    _window.setColorDepth(8);
+  }
+
+  void setText(const char *text, float size, uint8_t fg, uint8_t bg) {
+    _strip.setTextSize(size);
+
+    int width = _strip.textWidth(text);
+    int strip = width > _area.w ? std::min(width + MARQUEE_GAP, MARQUEE_MAX_WIDTH) : _area.w;
+
+    if (strip != _stripWidth) {
+      if (_stripWidth) {
+        _strip.deleteSprite();
+        MemoryHealth::released(SUBSYSTEM::SUBSYSTEM_SPRITE);
+        _stripWidth = 0;
+      }
+
+      if (!_strip.createSprite(strip, _area.h)) {
+        MemoryHealth::failed(SUBSYSTEM::SUBSYSTEM_SPRITE);
+        log_e("marquee allocation failed : %dx%d", strip, _area.h);
+        return;
+      }
+      MemoryHealth::allocated(SUBSYSTEM::SUBSYSTEM_SPRITE);
+      _stripWidth = strip;
+    }
+
+    if (_window.getBuffer() == nullptr) {
+      if (!_window.createSprite(_area.w, _area.h)) {
+        MemoryHealth::failed(SUBSYSTEM::SUBSYSTEM_SPRITE);
+        log_e("marquee allocation failed : %dx%d", _area.w, _area.h);
+        return;
+      }
+      MemoryHealth::allocated(SUBSYSTEM::SUBSYSTEM_SPRITE);
+    }
+
+    _strip.fillSprite(bg);
+    _strip.setTextColor(fg, bg);
+    _strip.setCursor(0, 0);
+    _strip.print(text);
+
+    _offset = 0;
+  }
+
+  bool isScrolling(void) {
+    return _stripWidth > _area.w;
+  }
+
+  // 表示する幅を切り出してdstへ送る。advanceなら次のフレームの位置へ進める
+  void present(LovyanGFX *dst, bool advance) {
+    uint8_t *src    = static_cast<uint8_t *>(_strip.getBuffer());
+    uint8_t *window = static_cast<uint8_t *>(_window.getBuffer());
+
+    if (src == nullptr || window == nullptr) {
+      return;
+    }
+
+    uint32_t start = micros();
+
+    int first = std::min<int>(_area.w, _stripWidth - _offset);
+
+    for (int y = 0; y < _area.h; y++) {
+      const uint8_t *line = src + y * _stripWidth;
+      uint8_t       *d    = window + y * _area.w;
+
+      memcpy(d, line + _offset, first);
+      if (first < _area.w) {
+        memcpy(d + first, line, _area.w - first);
+      }
+    }
+
+    _window.pushSprite(dst, _area.x, _area.y);
+
+    if (advance && isScrolling()) {
+      _offset = (_offset + MARQUEE_SPEED) % _stripWidth;
+    }
+
+    _lastUs = micros() - start;
+    _maxUs  = std::max(_maxUs, _lastUs);
+    _totalUs += _lastUs;
+    _frames++;
+  }
+
+  uint32_t getFrames(void) {
+    return _frames;
+  }
+
+  uint32_t getLastUs(void) {
+    return _lastUs;
+  }
+
+  uint32_t getMaxUs(void) {
+    return _maxUs;
+  }
+
+  uint32_t getAverageUs(void) {
+    return _frames ? (uint32_t)(_totalUs / _frames) : 0;
+  }
+
+ private:
+  LayoutRect _area;
+  M5Canvas   _strip;
+  M5Canvas   _window;
+
+  int _offset;
+  int _stripWidth;
+
+  uint32_t _frames;
+  uint32_t _lastUs;
+  uint32_t _maxUs;
+  uint64_t _totalUs;
+};
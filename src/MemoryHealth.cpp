@@ -0,0 +1,196 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <ArduinoJson.h>
+#include <MemoryHealth.h>
+#include <Preferences.h>
+#include <esp32-hal-log.h>
+#include <esp_heap_caps.h>
+#include <esp_timer.h>
+
+#include <algorithm>
+
+MemoryHealth::Counter MemoryHealth::_counters[(int)SUBSYSTEM::SUBSYSTEM_MAX];
+MemoryHealth::Sample  MemoryHealth::_history[MEMORY_HISTORY_SIZE];
+
+size_t   MemoryHealth::_head       = 0;
+size_t   MemoryHealth::_count      = 0;
+uint32_t MemoryHealth::_lastSample = 0;
+uint32_t MemoryHealth::_unhealthy  = 0;
+uint32_t MemoryHealth::_restarts   = 0;
+
+static const char *subsystemName[] = {"tls", "http", "sprite", "asset"};
+
+void MemoryHealth::allocated(SUBSYSTEM subsystem) {
+  _counters[(int)subsystem].allocs.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryHealth::released(SUBSYSTEM subsystem) {
+  _counters[(int)subsystem].frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryHealth::failed(SUBSYSTEM subsystem) {
+  _counters[(int)subsystem].failures.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryHealth::begin(void) {
+  _head      = 0;
+  _count     = 0;
+  _unhealthy = 0;
+
+  Preferences prefs;
+
+  if (prefs.begin("memory", true)) {
+    _restarts = prefs.getUInt("restarts", 0);
+    prefs.end();
+  } else {
+    _restarts = 0;
+  }
+
+  if (_restarts) {
+    log_w("restarted %d times by heap health. wait %d s before the next restart.", _restarts, minUptime() / 1000);
+  }
+}
+
+// millis()は49日で一周するので使わない
+uint64_t MemoryHealth::_uptime(void) {
+  return (uint64_t)esp_timer_get_time() / 1000;
+}
+
+void MemoryHealth::_saveRestarts(void) {
+  Preferences prefs;
+
+  if (!prefs.begin("memory", false)) {
+    log_e("fail to open memory");
+    return;
+  }
+
+  prefs.putUInt("restarts", _restarts);
+  prefs.end();
+}
+
+uint32_t MemoryHealth::minUptime(void) {
+  return (uint32_t)MEMORY_MIN_UPTIME_MS << std::min<uint32_t>(_restarts, MEMORY_RESTART_BACKOFF_MAX);
+}
+
+void MemoryHealth::restarting(void) {
+  _restarts++;
+  _saveRestarts();
+}
+
+uint32_t MemoryHealth::_fragmentation(const Sample &sample) {
+  if (sample.freeHeap == 0) {
+    return 100;
+  }
+
+  return 100 - (uint32_t)((uint64_t)sample.largestBlock * 100 / sample.freeHeap);
+}
+
+void MemoryHealth::sample(void) {
+  if (_count && (millis() - _lastSample) < MEMORY_SAMPLE_PERIOD_MS) {
+    return;
+  }
+
+  _lastSample = millis();
+
+  Sample &sample      = _history[_head];
+  sample.time         = _lastSample / 1000;
+  sample.freeHeap     = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+  sample.largestBlock = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+  sample.minFreeHeap  = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+
+  _head = (_head + 1) % MEMORY_HISTORY_SIZE;
+  if (_count < MEMORY_HISTORY_SIZE) {
+    _count++;
+  }
+
+  // 長く動き続けたので、続けての再起動ではない
+  if (_restarts && _uptime() >= MEMORY_RESTART_RESET_MS) {
+    _restarts = 0;
+    _saveRestarts();
+  }
+
+  uint32_t fragmentation = _fragmentation(sample);
+
+  if (fragmentation >= MEMORY_FRAGMENTATION_THRESHOLD || sample.largestBlock < MEMORY_MIN_LARGEST_BLOCK) {
+    _unhealthy++;
+    log_w("Heap unhealthy(%d/%d) : free %d, largest %d, fragmentation %d%%",
+          _unhealthy,
+          MEMORY_UNHEALTHY_COUNT,
+          sample.freeHeap,
+          sample.largestBlock,
+          fragmentation);
+  } else {
+    _unhealthy = 0;
+    log_d("Free Heap : %d, largest %d, fragmentation %d%%", sample.freeHeap, sample.largestBlock, fragmentation);
+  }
+}
+
+bool MemoryHealth::restartRequired(void) {
+  return _unhealthy >= MEMORY_UNHEALTHY_COUNT && _uptime() >= minUptime();
+}
+
+String MemoryHealth::toJson(void) {
+  DynamicJsonDocument doc(1024 + MEMORY_HISTORY_SIZE * 64);
+
+  doc["uptime"]           = (uint32_t)(_uptime() / 1000);
+  doc["freeHeap"]         = heap_caps_get_free_size(MALLOC_CAP_INTERNAL);
+  doc["largestBlock"]     = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL);
+  doc["minFreeHeap"]      = heap_caps_get_minimum_free_size(MALLOC_CAP_INTERNAL);
+  doc["unhealthy"]        = _unhealthy;
+  doc["restartRequired"]  = restartRequired();
+  doc["restarts"]         = _restarts;
+  doc["minUptime"]        = minUptime() / 1000;
+  doc["thresholdPercent"] = MEMORY_FRAGMENTATION_THRESHOLD;
+  doc["minLargestBlock"]  = MEMORY_MIN_LARGEST_BLOCK;
+
+  JsonObject subsystems = doc.createNestedObject("subsystems");
+  for (int i = 0; i < (int)SUBSYSTEM::SUBSYSTEM_MAX; i++) {
+    uint32_t allocs = _counters[i].allocs.load(std::memory_order_relaxed);
+    uint32_t frees  = _counters[i].frees.load(std::memory_order_relaxed);
+
+    JsonObject counter  = subsystems.createNestedObject(subsystemName[i]);
+    counter["allocs"]   = allocs;
+    counter["frees"]    = frees;
+    counter["live"]     = allocs - frees;
+    counter["failures"] = _counters[i].failures.load(std::memory_order_relaxed);
+  }
+
+  // 古い順に並べる
+  JsonArray history = doc.createNestedArray("history");
+  for (size_t i = 0; i < _count; i++) {
+    const Sample &sample = _history[(_head + MEMORY_HISTORY_SIZE - _count + i) % MEMORY_HISTORY_SIZE];
+
+    JsonArray item = history.createNestedArray();
+    item.add(sample.time);
+    item.add(sample.freeHeap);
+    item.add(sample.largestBlock);
+    item.add(_fragmentation(sample));
+  }
+
+  String json;
+  serializeJson(doc, json);
+
+  return json;
+}
@@ -0,0 +1,136 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <atomic>
+
+// 断片化率 [%] = 100 - 最大連続領域 / 空きヒープ
+#ifndef MEMORY_FRAGMENTATION_THRESHOLD
+#define MEMORY_FRAGMENTATION_THRESHOLD 70
+#endif
+
+// TLSハンドシェイクに必要な連続領域 [byte]
+#ifndef MEMORY_MIN_LARGEST_BLOCK
+#define MEMORY_MIN_LARGEST_BLOCK (20 * 1024)
+#endif
+
+#ifndef MEMORY_SAMPLE_PERIOD_MS
+#define MEMORY_SAMPLE_PERIOD_MS (60 * 1000)
+#endif
+
+// 連続してこの回数だけ閾値を超えたら再起動を要求する
+#ifndef MEMORY_UNHEALTHY_COUNT
+#define MEMORY_UNHEALTHY_COUNT 5
+#endif
+
+// 起動してからこの時間 [ms] は再起動しない
+// 起動直後から断片化していても、再起動を繰り返さない
+#ifndef MEMORY_MIN_UPTIME_MS
+#define MEMORY_MIN_UPTIME_MS (30 * 60 * 1000)
+#endif
+
+// 続けて再起動するたびに最低の稼働時間を倍にする。倍にするのはこの回数まで(30分なら16時間)
+#ifndef MEMORY_RESTART_BACKOFF_MAX
+#define MEMORY_RESTART_BACKOFF_MAX 5
+#endif
+
+// この時間 [ms] 動き続けたら、再起動の回数を0に戻す
+#ifndef MEMORY_RESTART_RESET_MS
+#define MEMORY_RESTART_RESET_MS (24 * 60 * 60 * 1000)
+#endif
+
+#define MEMORY_HISTORY_SIZE 60
+
+enum class SUBSYSTEM : int {
+  SUBSYSTEM_TLS,
+  SUBSYSTEM_HTTP,
+  SUBSYSTEM_SPRITE,
+  SUBSYSTEM_ASSET,
+  SUBSYSTEM_MAX
+};
+
+class MemoryHealth {
+ public:
+  // スコープの間だけ確保されるオブジェクトを数える
+  class Track {
+   public:
+    Track(SUBSYSTEM subsystem) : _subsystem(subsystem) {
+      MemoryHealth::allocated(_subsystem);
+    }
+
+    ~Track() {
+      MemoryHealth::released(_subsystem);
+    }
+
+   private:
+    SUBSYSTEM _subsystem;
+  };
+
+  static void allocated(SUBSYSTEM subsystem);
+  static void released(SUBSYSTEM subsystem);
+  static void failed(SUBSYSTEM subsystem);
+
+  // 起動時に一度呼ぶ。続けて再起動した回数をNVSから読む
+  static void begin(void);
+
+  static void sample(void);
+  static bool restartRequired(void);
+
+  // ESP.restart()の直前に呼ぶ。再起動した回数をNVSに残す
+  static void restarting(void);
+
+  // この起動で再起動してよくなるまでの稼働時間 [ms]
+  static uint32_t minUptime(void);
+
+  static String toJson(void);
+
+ private:
+  struct Sample {
+    uint32_t time;
+    uint32_t freeHeap;
+    uint32_t largestBlock;
+    uint32_t minFreeHeap;
+  };
+
+  struct Counter {
+    std::atomic<uint32_t> allocs;
+    std::atomic<uint32_t> frees;
+    std::atomic<uint32_t> failures;
+  };
+
+  static uint32_t _fragmentation(const Sample &sample);
+  static uint64_t _uptime(void);
+  static void     _saveRestarts(void);
+
+  static Counter  _counters[(int)SUBSYSTEM::SUBSYSTEM_MAX];
+  static Sample   _history[MEMORY_HISTORY_SIZE];
+  static size_t   _head;
+  static size_t   _count;
+  static uint32_t _lastSample;
+  static uint32_t _unhealthy;
+  static uint32_t _restarts;
+};
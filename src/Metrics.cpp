@@ -0,0 +1,156 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <Metrics.h>
+#include <esp_heap_caps.h>
+
+Metrics::Histogram Metrics::_histograms[(int)METRIC::METRIC_MAX][portNUM_PROCESSORS];
+
+// バケットの上限 [us]。最後はそれ以外(+Inf)
+static const uint32_t bucketBounds[METRICS_BUCKETS - 1] = {
+    100, 500, 1000, 5000, 10000, 50000, 100000, 500000, 1000000, 5000000};
+
+static const char *metricName[] = {
+    "atom_display_update_seconds",
+    "atom_weather_request_seconds",
+    "atom_tls_handshake_seconds",
+    "atom_weather_parse_seconds",
+    "atom_handle_client_seconds",
+    "atom_render_jitter_seconds",
+    "atom_clock_skew_seconds",
+    "atom_display_rasterize_seconds",
+    "atom_display_push_seconds",
+    "atom_display_swap_seconds",
+    "atom_present_latency_seconds"};
+
+static const char *metricHelp[] = {
+    "Time spent in Display::update().",
+    "Time spent fetching the weather document.",
+    "Time spent in the TLS handshake with JMA.",
+    "Time spent parsing the weather document.",
+    "Time spent in AutoConnect handleClient().",
+    "Deviation of the render task period from DISPLAY_FRAME_MS.",
+    "Time from the second boundary to the frame that shows it.",
+    "Time spent drawing into the sprites in one frame.",
+    "Time spent pushing the sprites to the CVBS buffer in one frame.",
+    "Time spent in ESP32_8BIT_CVBS::display() in one frame.",
+    "Time from a clock or weather change to the frame that shows it."};
+
+static_assert(sizeof(metricName) / sizeof(metricName[0]) == (int)METRIC::METRIC_MAX, "metricName");
+static_assert(sizeof(metricHelp) / sizeof(metricHelp[0]) == (int)METRIC::METRIC_MAX, "metricHelp");
+
+// 固定の文字列はそのまま足す。lineには数値を含む短い行だけを書く
+static void appendHeader(String &text, const char *name, const char *help, const char *type) {
+  text += "# HELP ";
+  text += name;
+  text += " ";
+  text += help;
+  text += "\n# TYPE ";
+  text += name;
+  text += " ";
+  text += type;
+  text += "\n";
+}
+
+void Metrics::observe(METRIC metric, uint32_t us) {
+  Histogram &histogram = _histograms[(int)metric][xPortGetCoreID()];
+
+  int bucket = 0;
+  while (bucket < METRICS_BUCKETS - 1 && us > bucketBounds[bucket]) {
+    bucket++;
+  }
+
+  histogram.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  histogram.count.fetch_add(1, std::memory_order_relaxed);
+
+  // 32bitの合計が溢れたら上位に繰り上げる
+  uint32_t low = histogram.sumLow.fetch_add(us, std::memory_order_relaxed);
+  if (low + us < low) {
+    histogram.sumHigh.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+
+String Metrics::toPrometheus(void) {
+  String text;
+  char   line[128];
+
+  text.reserve(4096);
+
+  for (int i = 0; i < (int)METRIC::METRIC_MAX; i++) {
+    uint32_t buckets[METRICS_BUCKETS] = {0};
+    uint32_t count                    = 0;
+    uint64_t sum                      = 0;
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+      Histogram &histogram = _histograms[i][core];
+
+      for (int bucket = 0; bucket < METRICS_BUCKETS; bucket++) {
+        buckets[bucket] += histogram.buckets[bucket].load(std::memory_order_relaxed);
+      }
+
+      count += histogram.count.load(std::memory_order_relaxed);
+      sum += ((uint64_t)histogram.sumHigh.load(std::memory_order_relaxed) << 32) |
+             histogram.sumLow.load(std::memory_order_relaxed);
+    }
+
+    appendHeader(text, metricName[i], metricHelp[i], "histogram");
+
+    uint32_t cumulative = 0;
+    for (int bucket = 0; bucket < METRICS_BUCKETS - 1; bucket++) {
+      cumulative += buckets[bucket];
+      snprintf(line, sizeof(line), "%s_bucket{le=\"%g\"} %u\n", metricName[i], bucketBounds[bucket] / 1000000.0, cumulative);
+      text += line;
+    }
+
+    snprintf(line, sizeof(line), "%s_bucket{le=\"+Inf\"} %u\n", metricName[i], count);
+    text += line;
+    snprintf(line, sizeof(line), "%s_sum %.6f\n", metricName[i], sum / 1000000.0);
+    text += line;
+    snprintf(line, sizeof(line), "%s_count %u\n", metricName[i], count);
+    text += line;
+  }
+
+  appendHeader(text, "atom_observations_total", "Observations per metric and core.", "counter");
+  for (int i = 0; i < (int)METRIC::METRIC_MAX; i++) {
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+      snprintf(line, sizeof(line), "atom_observations_total{metric=\"%s\",core=\"%d\"} %u\n",
+               metricName[i],
+               core,
+               _histograms[i][core].count.load(std::memory_order_relaxed));
+      text += line;
+    }
+  }
+
+  appendHeader(text, "atom_heap_free_bytes", "Free internal heap.", "gauge");
+  snprintf(line, sizeof(line), "atom_heap_free_bytes %u\n", (uint32_t)heap_caps_get_free_size(MALLOC_CAP_INTERNAL));
+  text += line;
+  appendHeader(text, "atom_heap_largest_block_bytes", "Largest free block of internal heap.", "gauge");
+  snprintf(line, sizeof(line), "atom_heap_largest_block_bytes %u\n", (uint32_t)heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL));
+  text += line;
+  appendHeader(text, "atom_uptime_seconds", "Seconds since boot.", "counter");
+  snprintf(line, sizeof(line), "atom_uptime_seconds %lu\n", (unsigned long)(millis() / 1000));
+  text += line;
+
+  return text;
+}
@@ -0,0 +1,79 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <atomic>
+
+enum class METRIC : int {
+  METRIC_DISPLAY_UPDATE,
+  METRIC_WEATHER_REQUEST,
+  METRIC_TLS_HANDSHAKE,
+  METRIC_WEATHER_PARSE,
+  METRIC_HANDLE_CLIENT,
+  METRIC_RENDER_JITTER,
+  METRIC_CLOCK_SKEW,
+  METRIC_DISPLAY_RASTERIZE,
+  METRIC_DISPLAY_PUSH,
+  METRIC_DISPLAY_SWAP,
+  METRIC_PRESENT_LATENCY,
+  METRIC_MAX
+};
+
+#define METRICS_BUCKETS 11
+
+// 計測はコアごとのカウンタに加算するだけ。集計と整形はスクレイプ時に行う
+class Metrics {
+ public:
+  class Timer {
+   public:
+    Timer(METRIC metric) : _metric(metric),
+                           _start(micros()) {
+    }
+
+    ~Timer() {
+      Metrics::observe(_metric, micros() - _start);
+    }
+
+   private:
+    METRIC   _metric;
+    uint32_t _start;
+  };
+
+  static void observe(METRIC metric, uint32_t us);
+
+  static String toPrometheus(void);
+
+ private:
+  struct Histogram {
+    std::atomic<uint32_t> buckets[METRICS_BUCKETS];
+    std::atomic<uint32_t> count;
+    std::atomic<uint32_t> sumLow;
+    std::atomic<uint32_t> sumHigh;
+  };
+
+  static Histogram _histograms[(int)METRIC::METRIC_MAX][portNUM_PROCESSORS];
+};
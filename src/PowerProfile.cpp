@@ -0,0 +1,257 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#include <ArduinoJson.h>
+#include <PowerProfile.h>
+#include <WiFi.h>
+#include <esp32-hal-log.h>
+
+#include <algorithm>
+#include <memory>
+
+// Wi-Fiを使うので80MHzより下げない
+static const uint32_t frequencies[] = {80, 160, 240};
+
+std::mutex            PowerProfile::_lock;
+POWER                 PowerProfile::_profile = POWER::POWER_PERFORMANCE;
+std::atomic<uint32_t> PowerProfile::_busy[portNUM_PROCESSORS];
+std::atomic<uint32_t> PowerProfile::_wakes(0);
+
+uint32_t PowerProfile::_networkWakes                 = 0;
+bool     PowerProfile::_inNetwork                    = false;
+uint32_t PowerProfile::_networkStart                 = 0;
+uint32_t PowerProfile::_networkWindow                = 0;
+uint64_t PowerProfile::_networkTime                  = 0;
+uint32_t PowerProfile::_networkDuty                  = 0;
+uint32_t PowerProfile::_windowStart                  = 0;
+uint32_t PowerProfile::_duty[portNUM_PROCESSORS]     = {0};
+bool     PowerProfile::_idleStats                    = false;
+uint32_t PowerProfile::_lastIdle[portNUM_PROCESSORS] = {0};
+uint32_t PowerProfile::_lastTotal                    = 0;
+int      PowerProfile::_frequency                    = 2;
+uint64_t PowerProfile::_timeAt[3]                    = {0};
+uint32_t PowerProfile::_lastChange                   = 0;
+uint32_t PowerProfile::_since                        = 0;
+
+void PowerProfile::begin(POWER profile) {
+  std::lock_guard<std::mutex> lock(_lock);
+
+  _profile       = profile;
+  _windowStart   = millis();
+  _lastChange    = millis();
+  _since         = millis();
+  _networkWindow = 0;
+  _networkTime   = 0;
+
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    _busy[core].store(0, std::memory_order_relaxed);
+    _duty[core] = 0;
+  }
+
+  // 最初の区間も、起動からではなくここから数える
+  _idleStats = _readIdle(_lastIdle, _lastTotal);
+
+  // モデムスリープはWi-Fiが繋がってから入れる
+  if (_profile == POWER::POWER_LOW) {
+    log_i("Low power profile.");
+  }
+}
+
+bool PowerProfile::isLowPower(void) {
+  return _profile == POWER::POWER_LOW;
+}
+
+void PowerProfile::wake(void) {
+  _wakes.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PowerProfile::busy(uint32_t us) {
+  _busy[xPortGetCoreID()].fetch_add(us, std::memory_order_relaxed);
+}
+
+void PowerProfile::beginNetwork(void) {
+  std::lock_guard<std::mutex> lock(_lock);
+
+  _networkWakes++;
+  _networkStart = micros();
+  _inNetwork    = true;
+
+  if (_profile == POWER::POWER_LOW) {
+    WiFi.setSleep(false);
+    _setFrequency(2);
+  }
+}
+
+void PowerProfile::endNetwork(void) {
+  std::lock_guard<std::mutex> lock(_lock);
+
+  uint32_t elapsed = micros() - _networkStart;
+
+  // 通信の大半は応答を待っている時間なので、CPU使用率には数えない
+  _networkWindow += elapsed;
+  _networkTime += elapsed;
+  _inNetwork = false;
+
+  if (_profile == POWER::POWER_LOW) {
+    WiFi.setSleep(true);
+  }
+}
+
+// IDLE0/IDLE1の実行時間と全体の時間。FreeRTOSの実行時間の統計が無ければfalse
+bool PowerProfile::_readIdle(uint32_t *idle, uint32_t &total) {
+#if (configUSE_TRACE_FACILITY == 1) && (configGENERATE_RUN_TIME_STATS == 1)
+  UBaseType_t                     count = uxTaskGetNumberOfTasks();
+  std::unique_ptr<TaskStatus_t[]> status(new TaskStatus_t[count]);
+
+  count = uxTaskGetSystemState(status.get(), count, &total);
+
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    TaskHandle_t handle = xTaskGetIdleTaskHandleForCPU(core);
+
+    idle[core] = 0;
+    for (UBaseType_t i = 0; i < count; i++) {
+      if (status[i].xHandle == handle) {
+        idle[core] = status[i].ulRunTimeCounter;
+        break;
+      }
+    }
+  }
+
+  return true;
+#else
+  return false;
+#endif
+}
+
+// loop()から呼ぶ。一定時間ごとのコアごとのCPU使用率でクロックを決める
+void PowerProfile::update(void) {
+  uint32_t elapsed = millis() - _windowStart;
+
+  if (elapsed < POWER_WINDOW_MS) {
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(_lock);
+
+  uint32_t idle[portNUM_PROCESSORS];
+  uint32_t total  = 0;
+  uint32_t window = 0;
+
+  _idleStats = _readIdle(idle, total);
+  if (_idleStats) {
+    window     = total - _lastTotal;
+    _lastTotal = total;
+  }
+
+  uint32_t busiest = 0;
+
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    uint32_t busy = _busy[core].exchange(0, std::memory_order_relaxed);
+
+    if (_idleStats) {
+      // IDLEタスクが動いていなかった時間
+      uint32_t idleTime = std::min(idle[core] - _lastIdle[core], window);
+
+      _duty[core]     = window ? 100 - (uint32_t)((uint64_t)idleTime * 100 / window) : 0;
+      _lastIdle[core] = idle[core];
+    } else {
+      _duty[core] = std::min<uint32_t>(busy / 10 / elapsed, 100);  // us / (ms * 1000) * 100
+    }
+
+    busiest = std::max(busiest, _duty[core]);
+  }
+
+  // 区間をまたいで通信中なら、ここまでをこの区間に数える
+  if (_inNetwork) {
+    uint32_t now = micros();
+
+    _networkWindow += now - _networkStart;
+    _networkTime += now - _networkStart;
+    _networkStart = now;
+  }
+
+  _networkDuty   = std::min<uint32_t>(_networkWindow / 10 / elapsed, 100);
+  _networkWindow = 0;
+  _windowStart   = millis();
+
+  if (_profile != POWER::POWER_LOW) {
+    return;
+  }
+
+  if (busiest > POWER_DUTY_HIGH && _frequency < 2) {
+    _setFrequency(_frequency + 1);
+  } else if (busiest < POWER_DUTY_LOW && _frequency > 0) {
+    _setFrequency(_frequency - 1);
+  }
+}
+
+// _lockを持って呼ぶ
+void PowerProfile::_setFrequency(int index) {
+  if (index == _frequency) {
+    return;
+  }
+
+  _timeAt[_frequency] += millis() - _lastChange;
+  _lastChange = millis();
+  _frequency  = index;
+
+  setCpuFrequencyMhz(frequencies[_frequency]);
+
+  log_d("CPU %d MHz, duty %d%% %d%%", frequencies[_frequency], _duty[0], _duty[portNUM_PROCESSORS - 1]);
+}
+
+String PowerProfile::toJson(void) {
+  DynamicJsonDocument         doc(512);
+  std::lock_guard<std::mutex> lock(_lock);
+
+  uint32_t uptime = millis() - _since;
+
+  doc["profile"] = isLowPower() ? "low" : "performance";
+  doc["cpuMHz"]  = getCpuFrequencyMhz();
+
+  // コアごとの使用率 [%]。idleはIDLEタスクの実行時間から、busyはbusy()で数えた時間から求めた
+  JsonArray duty = doc.createNestedArray("duty");
+  for (int core = 0; core < portNUM_PROCESSORS; core++) {
+    duty.add(_duty[core]);
+  }
+  doc["dutySource"] = _idleStats ? "idle" : "busy";
+
+  doc["renderWakes"]  = _wakes.load(std::memory_order_relaxed);
+  doc["networkWakes"] = _networkWakes;
+
+  // 通信していた時間の割合(それ以外はモデムスリープ)。直近の区間と起動から
+  doc["networkDuty"] = _networkDuty;
+  doc["radioDuty"]   = uptime ? (uint32_t)(_networkTime / 10 / uptime) : 0;
+
+  JsonObject timeAt = doc.createNestedObject("timeAtMHz");
+  for (int i = 0; i < 3; i++) {
+    uint64_t time = _timeAt[i] + (i == _frequency ? millis() - _lastChange : 0);
+    timeAt[String(frequencies[i])] = (uint32_t)(time / 1000);
+  }
+
+  String json;
+  serializeJson(doc, json);
+
+  return json;
+}
@@ -0,0 +1,95 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <atomic>
+#include <mutex>
+
+// 負荷を評価する間隔 [ms]
+#ifndef POWER_WINDOW_MS
+#define POWER_WINDOW_MS 5000
+#endif
+
+// CPU使用率 [%]。一番忙しいコアがこれを超えたらクロックを上げ、下回ったら下げる
+#ifndef POWER_DUTY_HIGH
+#define POWER_DUTY_HIGH 60
+#endif
+
+#ifndef POWER_DUTY_LOW
+#define POWER_DUTY_LOW 20
+#endif
+
+enum class POWER : int {
+  POWER_PERFORMANCE,
+  POWER_LOW
+};
+
+// Wi-Fiのモデムスリープ、CPUクロックの切り替え、描画タスクの起床回数を管理する
+class PowerProfile {
+ public:
+  static void begin(POWER profile);
+  static bool isLowPower(void);
+
+  // 描画タスクが起きた回数
+  static void wake(void);
+  // 処理にかかった時間 [us]。呼んだタスクのコアに数える
+  // IDLEタスクの実行時間が取れる時は、そちらでコアごとの使用率を求める
+  static void busy(uint32_t us);
+
+  // 通信の間だけモデムスリープを止め、クロックを上げる
+  // 通信の時間はCPU使用率に含めず、別に数える
+  static void beginNetwork(void);
+  static void endNetwork(void);
+
+  static void   update(void);
+  static String toJson(void);
+
+ private:
+  static void _setFrequency(int index);
+  static bool _readIdle(uint32_t *idle, uint32_t &total);
+
+  // クロックと滞在時間は、ネットワークタスクとloop()の両方から変わる
+  static std::mutex            _lock;
+  static POWER                 _profile;
+  static std::atomic<uint32_t> _busy[portNUM_PROCESSORS];
+  static std::atomic<uint32_t> _wakes;
+  static uint32_t              _networkWakes;
+  static bool                  _inNetwork;
+  static uint32_t              _networkStart;
+  static uint32_t              _networkWindow;
+  static uint64_t              _networkTime;
+  static uint32_t              _networkDuty;
+  static uint32_t              _windowStart;
+  static uint32_t              _duty[portNUM_PROCESSORS];
+  static bool                  _idleStats;
+  static uint32_t              _lastIdle[portNUM_PROCESSORS];
+  static uint32_t              _lastTotal;
+  static int                   _frequency;
+  static uint64_t              _timeAt[3];
+  static uint32_t              _lastChange;
+  static uint32_t              _since;
+};
@@ -0,0 +1,97 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+
+#include <algorithm>
+
+// 覚えておくクライアントの数。溢れたら一番古いものを捨てる
+#ifndef RATE_LIMIT_CLIENTS
+#define RATE_LIMIT_CLIENTS 16
+#endif
+
+// トークンバケット。keyごとにrate [回/秒] で貯まり、burst回まで続けて使える
+class RateLimiter {
+ public:
+  RateLimiter(uint32_t rate, uint32_t burst) : _rate(rate),
+                                               _burst(burst) {
+    memset(_buckets, 0, sizeof(_buckets));
+  }
+
+  bool allow(uint32_t key) {
+    uint32_t now    = millis();
+    Bucket  *bucket = _find(key, now);
+
+    // 1トークン = 1000
+    uint32_t elapsed = now - bucket->last;
+    uint32_t tokens  = bucket->tokens + std::min<uint32_t>(elapsed, 60000) * _rate;
+
+    bucket->tokens = std::min<uint32_t>(tokens, _burst * 1000);
+    bucket->last   = now;
+
+    if (bucket->tokens < 1000) {
+      return false;
+    }
+
+    bucket->tokens -= 1000;
+
+    return true;
+  }
+
+ private:
+  struct Bucket {
+    uint32_t key;
+    uint32_t tokens;
+    uint32_t last;
+    bool     used;
+  };
+
+  Bucket *_find(uint32_t key, uint32_t now) {
+    Bucket *oldest = &_buckets[0];
+
+    for (auto &bucket : _buckets) {
+      if (bucket.used && bucket.key == key) {
+        return &bucket;
+      }
+
+      if (!bucket.used || (oldest->used && (now - bucket.last) > (now - oldest->last))) {
+        oldest = &bucket;
+      }
+    }
+
+    // 新しいクライアントは満タンから始める
+    oldest->used   = true;
+    oldest->key    = key;
+    oldest->tokens = _burst * 1000;
+    oldest->last   = now;
+
+    return oldest;
+  }
+
+  uint32_t _rate;
+  uint32_t _burst;
+  Bucket   _buckets[RATE_LIMIT_CLIENTS];
+};
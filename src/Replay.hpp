@@ -0,0 +1,357 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <Arduino.h>
+#include <FS.h>
+#include <SPIFFS.h>
+#include <WiFiClient.h>
+#include <esp32-hal-log.h>
+
+#include <algorithm>
+
+// 受信データを記録/再生する。どちらも指定しなければ何もしない
+//   ATOM_RECORD : 本物のクライアントが受信したバイト列を時刻付きでSPIFFSへ保存する
+//   ATOM_REPLAY : ネットワークを使わず、保存したバイト列を受信したことにする
+#if defined(ATOM_RECORD) || defined(ATOM_REPLAY)
+#define ATOM_TAP
+#endif
+
+// 再生速度の倍率。1で記録した時と同じ間隔、0で待たずに全部流す
+#ifndef REPLAY_SPEED
+#define REPLAY_SPEED 1
+#endif
+
+// 1レコードにまとめる最大バイト数と時間
+#ifndef REPLAY_CHUNK_SIZE
+#define REPLAY_CHUNK_SIZE 512
+#endif
+
+#ifndef REPLAY_CHUNK_MS
+#define REPLAY_CHUNK_MS 5
+#endif
+
+#define REPLAY_JMA_PATH        "/replay_jma.bin"
+#define REPLAY_THINGSPEAK_PATH "/replay_ts.bin"
+#define REPLAY_DOC_PATH        "/replay_doc.bin"
+
+// ファイル形式。先頭から次のレコードが並ぶだけ（リトルエンディアン）
+//   uint32_t offset  接続してから最初の1バイトを受け取るまでの時間 [ms]
+//   uint16_t length
+//   uint8_t  data[length]
+struct ReplayRecord {
+  uint32_t offset;
+  uint16_t length;
+} __attribute__((packed));
+
+// 元のクライアントから読んだものを、そのまま記録ファイルにも書く
+class RecordingClient : public WiFiClient {
+ public:
+  RecordingClient(WiFiClient &client, const char *path) : _client(client),
+                                                         _path(path),
+                                                         _start(millis()),
+                                                         _chunkAt(0),
+                                                         _length(0),
+                                                         _bytes(0) {
+    _file = SPIFFS.open(_path, "w");
+    if (!_file) {
+      log_e("fail to open %s", _path);
+    }
+  }
+
+  ~RecordingClient() {
+    _close();
+  }
+
+  int connect(IPAddress ip, uint16_t port) {
+    _start = millis();
+    return _client.connect(ip, port);
+  }
+
+  int connect(const char *host, uint16_t port) {
+    _start = millis();
+    return _client.connect(host, port);
+  }
+
+  int connect(IPAddress ip, uint16_t port, int32_t timeout) {
+    _start = millis();
+    return _client.connect(ip, port, timeout);
+  }
+
+  int connect(const char *host, uint16_t port, int32_t timeout) {
+    _start = millis();
+    return _client.connect(host, port, timeout);
+  }
+
+  size_t write(uint8_t data) {
+    return _client.write(data);
+  }
+
+  size_t write(const uint8_t *buf, size_t size) {
+    return _client.write(buf, size);
+  }
+
+  int available(void) {
+    return _client.available();
+  }
+
+  int read(void) {
+    int data = _client.read();
+    if (data >= 0) {
+      uint8_t byte = data;
+      _tee(&byte, 1);
+    }
+    return data;
+  }
+
+  int read(uint8_t *buf, size_t size) {
+    int length = _client.read(buf, size);
+    if (length > 0) {
+      _tee(buf, length);
+    }
+    return length;
+  }
+
+  int peek(void) {
+    return _client.peek();
+  }
+
+  void flush(void) {
+    _client.flush();
+  }
+
+  void stop(void) {
+    _client.stop();
+    _close();
+  }
+
+  uint8_t connected(void) {
+    return _client.connected();
+  }
+
+  operator bool(void) {
+    return (bool)_client;
+  }
+
+ private:
+  void _tee(const uint8_t *buf, size_t size) {
+    if (!_file) {
+      return;
+    }
+
+    while (size) {
+      uint32_t now = millis() - _start;
+
+      if (_length && (_length == sizeof(_chunk) || now - _chunkAt >= REPLAY_CHUNK_MS)) {
+        _flushChunk();
+      }
+
+      if (_length == 0) {
+        _chunkAt = now;
+      }
+
+      size_t length = std::min(size, sizeof(_chunk) - _length);
+      memcpy(_chunk + _length, buf, length);
+
+      _length += length;
+      buf += length;
+      size -= length;
+    }
+  }
+
+  void _flushChunk(void) {
+    ReplayRecord record = {_chunkAt, (uint16_t)_length};
+
+    _file.write((const uint8_t *)&record, sizeof(record));
+    _file.write(_chunk, _length);
+
+    _bytes += _length;
+    _length = 0;
+  }
+
+  void _close(void) {
+    if (!_file) {
+      return;
+    }
+
+    if (_length) {
+      _flushChunk();
+    }
+
+    _file.close();
+    log_i("recorded %s. %d bytes", _path, _bytes);
+  }
+
+  WiFiClient &_client;
+  const char *_path;
+  File        _file;
+  uint32_t    _start;
+  uint32_t    _chunkAt;
+  size_t      _length;
+  size_t      _bytes;
+  uint8_t     _chunk[REPLAY_CHUNK_SIZE];
+};
+
+// 記録ファイルを、ネットワークから届いたように読ませる
+// 書き込んだもの(リクエスト)は捨てる。ホストではtest/hostのFS.hでファイルを読む
+class ReplayClient : public WiFiClient {
+ public:
+  ReplayClient(WiFiClient &client, const char *path, uint32_t speed = REPLAY_SPEED) : _path(path),
+                                                                                     _speed(speed),
+                                                                                     _start(millis()),
+                                                                                     _remaining(0),
+                                                                                     _bytes(0) {
+    (void)client;
+    _open();
+  }
+
+  ~ReplayClient() {
+    _close();
+  }
+
+  int connect(IPAddress ip, uint16_t port) {
+    return _open();
+  }
+
+  int connect(const char *host, uint16_t port) {
+    return _open();
+  }
+
+  int connect(IPAddress ip, uint16_t port, int32_t timeout) {
+    return _open();
+  }
+
+  int connect(const char *host, uint16_t port, int32_t timeout) {
+    return _open();
+  }
+
+  size_t write(uint8_t data) {
+    return 1;
+  }
+
+  size_t write(const uint8_t *buf, size_t size) {
+    return size;
+  }
+
+  // 記録した時刻になるまでは何も届いていないことにする
+  int available(void) {
+    if (_remaining == 0 && _file && _file.available() >= (int)sizeof(ReplayRecord)) {
+      ReplayRecord record;
+      size_t       position = _file.position();
+      _file.read((uint8_t *)&record, sizeof(record));
+
+      if (_speed && (millis() - _start) < record.offset / _speed) {
+        _file.seek(position);
+      } else {
+        _remaining = record.length;
+      }
+    }
+
+    return _remaining;
+  }
+
+  int read(void) {
+    if (!available()) {
+      return -1;
+    }
+
+    _remaining--;
+    _bytes++;
+    return _file.read();
+  }
+
+  int read(uint8_t *buf, size_t size) {
+    size_t length = std::min(size, (size_t)available());
+    if (length == 0) {
+      return -1;
+    }
+
+    length = _file.read(buf, length);
+    _remaining -= length;
+    _bytes += length;
+    return length;
+  }
+
+  int peek(void) {
+    return available() ? _file.peek() : -1;
+  }
+
+  void flush(void) {
+  }
+
+  void stop(void) {
+    _close();
+  }
+
+  // 残りがある間は接続しているものとする
+  uint8_t connected(void) {
+    return _file && (_remaining || _file.available());
+  }
+
+  operator bool(void) {
+    return connected();
+  }
+
+ private:
+  int _open(void) {
+    if (_file) {
+      return 1;
+    }
+
+    _file = SPIFFS.open(_path, "r");
+    if (!_file) {
+      log_e("fail to open %s", _path);
+      return 0;
+    }
+
+    _start     = millis();
+    _remaining = 0;
+    _bytes     = 0;
+    return 1;
+  }
+
+  void _close(void) {
+    if (!_file) {
+      return;
+    }
+
+    _file.close();
+    log_i("replayed %s. %d bytes in %d ms", _path, _bytes, millis() - _start);
+  }
+
+  const char *_path;
+  uint32_t    _speed;
+  File        _file;
+  uint32_t    _start;
+  size_t      _remaining;
+  size_t      _bytes;
+};
+
+#if defined(ATOM_REPLAY)
+using TapClient = ReplayClient;
+#elif defined(ATOM_RECORD)
+using TapClient = RecordingClient;
+#endif
@@ -0,0 +1,319 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp32-hal-log.h>
+#include <esp_timer.h>
+#include <time.h>
+
+// 気象庁の天気予報の発表時刻(JST)。発表からSCHEDULE_JMA_DELAY秒後に取得する
+#ifndef SCHEDULE_JMA_REPORT_HOURS
+#define SCHEDULE_JMA_REPORT_HOURS \
+  { 5, 11, 17 }
+#endif
+
+#ifndef SCHEDULE_JMA_DELAY
+#define SCHEDULE_JMA_DELAY (5 * 60)
+#endif
+
+// ThingSpeakチャンネルの更新間隔 [s]
+#ifndef SCHEDULE_THINGSPEAK_PERIOD
+#define SCHEDULE_THINGSPEAK_PERIOD (5 * 60)
+#endif
+
+// ATOM Docの更新が終わるまでの余裕と、ATOM View同士を分散させる幅 [s]
+#ifndef SCHEDULE_DOC_MARGIN
+#define SCHEDULE_DOC_MARGIN 15
+#endif
+
+#ifndef SCHEDULE_DOC_SPREAD
+#define SCHEDULE_DOC_SPREAD 10
+#endif
+
+// 時刻が分からない時の取得間隔 [s]
+#ifndef SCHEDULE_FALLBACK_PERIOD
+#define SCHEDULE_FALLBACK_PERIOD 60
+#endif
+
+// 失敗した時の再試行間隔 [s]。失敗するたびに倍にする
+#ifndef SCHEDULE_BACKOFF_BASE
+#define SCHEDULE_BACKOFF_BASE 10
+#endif
+
+#ifndef SCHEDULE_BACKOFF_MAX
+#define SCHEDULE_BACKOFF_MAX (30 * 60)
+#endif
+
+enum class SOURCE : int {
+  SOURCE_JMA,
+  SOURCE_THINGSPEAK,
+  SOURCE_DOC,
+  SOURCE_MAX
+};
+
+// 取得元ごとの次回取得時刻を管理する
+// 時刻は起動からの秒数で持ち、壁時計(JST)との変換はNTP同期後だけ行う
+class Scheduler {
+ public:
+  Scheduler(void) {
+    memset(_entries, 0, sizeof(_entries));
+  }
+
+  void enable(SOURCE source) {
+    Entry &entry  = _entries[(int)source];
+    entry.enabled = true;
+    entry.next    = _now();  // 起動直後にすぐ取得する
+  }
+
+  bool isDue(SOURCE source) const {
+    const Entry &entry = _entries[(int)source];
+
+    return entry.enabled && (int32_t)(_now() - entry.next) >= 0;
+  }
+
+  bool isAnyDue(void) const {
+    for (int i = 0; i < (int)SOURCE::SOURCE_MAX; i++) {
+      if (isDue((SOURCE)i)) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  void started(SOURCE source) {
+    _entries[(int)source].requests++;
+  }
+
+  // timestamp : ThingSpeakは最終更新時刻、ATOM Docは次回更新時刻(どちらもUTC epoch)
+  void succeeded(SOURCE source, time_t timestamp = 0) {
+    Entry &entry      = _entries[(int)source];
+    entry.failures    = 0;
+    entry.lastSuccess = _now();
+
+    uint32_t delay = SCHEDULE_FALLBACK_PERIOD;
+
+    switch (source) {
+      case SOURCE::SOURCE_JMA:
+        if (isClockValid()) {
+          delay = _secondsToNextReport();
+        }
+        break;
+      case SOURCE::SOURCE_THINGSPEAK:
+        delay = SCHEDULE_THINGSPEAK_PERIOD;
+        if (timestamp && isClockValid()) {
+          // 最後の更新時刻から1周期後に合わせる。チャンネルが止まっていたら通常の周期
+          int32_t aligned = (int32_t)(timestamp + SCHEDULE_THINGSPEAK_PERIOD + SCHEDULE_DOC_MARGIN - time(nullptr));
+          if (aligned > SCHEDULE_DOC_MARGIN && aligned <= SCHEDULE_THINGSPEAK_PERIOD + SCHEDULE_DOC_MARGIN) {
+            delay = aligned;
+          }
+        }
+        break;
+      case SOURCE::SOURCE_DOC:
+        if (timestamp && isClockValid()) {
+          int32_t advertised = (int32_t)(timestamp - time(nullptr));
+          if (advertised > 0 && advertised < SCHEDULE_BACKOFF_MAX) {
+            delay = advertised + SCHEDULE_DOC_MARGIN + esp_random() % (SCHEDULE_DOC_SPREAD + 1);
+          }
+        }
+        break;
+      default:
+        break;
+    }
+
+    entry.next = _now() + delay;
+  }
+
+  // 指数バックオフ。同時に失敗した端末が揃って再試行しないように揺らぎを入れる
+  void failed(SOURCE source) {
+    Entry &entry = _entries[(int)source];
+    entry.errors++;
+    entry.failures++;
+
+    uint32_t shift = entry.failures > 8 ? 8 : entry.failures - 1;
+    uint32_t delay = SCHEDULE_BACKOFF_BASE << shift;
+
+    // 揺らぎを入れてから上限で切る
+    delay = delay / 2 + esp_random() % (delay + 1);
+
+    if (delay > SCHEDULE_BACKOFF_MAX) {
+      delay = SCHEDULE_BACKOFF_MAX;
+    }
+
+    entry.next = _now() + delay;
+
+    log_w("source %d failed %d times. retry in %d s", (int)source, entry.failures, delay);
+  }
+
+  // 次にどれかの取得元を取得するまでの秒数。期限を過ぎていれば0
+  uint32_t secondsToNextFetch(void) const {
+    uint32_t now     = _now();
+    uint32_t seconds = UINT32_MAX;
+
+    for (int i = 0; i < (int)SOURCE::SOURCE_MAX; i++) {
+      const Entry &entry = _entries[i];
+
+      if (!entry.enabled) {
+        continue;
+      }
+
+      int32_t in = (int32_t)(entry.next - now);
+      if (in <= 0) {
+        return 0;
+      }
+
+      if ((uint32_t)in < seconds) {
+        seconds = in;
+      }
+    }
+
+    return seconds;
+  }
+
+  // 次に新しいデータを取得する時刻(UTC epoch)。時刻が分からなければ0
+  time_t nextUpdate(void) const {
+    if (!isClockValid()) {
+      return 0;
+    }
+
+    uint32_t next  = 0;
+    bool     found = false;
+
+    for (int i = 0; i < (int)SOURCE::SOURCE_MAX; i++) {
+      const Entry &entry = _entries[i];
+
+      if (entry.enabled && (!found || (int32_t)(entry.next - next) < 0)) {
+        next  = entry.next;
+        found = true;
+      }
+    }
+
+    if (!found) {
+      return 0;
+    }
+
+    return time(nullptr) + (int32_t)(next - _now());
+  }
+
+  String toJson(void) const {
+    static const char *sourceName[] = {"jma", "thingspeak", "doc"};
+
+    DynamicJsonDocument doc(1024);
+
+    doc["uptime"]     = _now();
+    doc["time"]       = isClockValid() ? time(nullptr) : 0;
+    doc["nextUpdate"] = nextUpdate();
+
+    JsonObject sources = doc.createNestedObject("sources");
+    for (int i = 0; i < (int)SOURCE::SOURCE_MAX; i++) {
+      const Entry &entry = _entries[i];
+
+      if (!entry.enabled) {
+        continue;
+      }
+
+      JsonObject item     = sources.createNestedObject(sourceName[i]);
+      item["in"]          = (int32_t)(entry.next - _now());
+      item["requests"]    = entry.requests;
+      item["errors"]      = entry.errors;
+      item["failures"]    = entry.failures;
+      item["lastSuccess"] = entry.lastSuccess;
+    }
+
+    String json;
+    serializeJson(doc, json);
+
+    return json;
+  }
+
+  static bool isClockValid(void) {
+    return time(nullptr) > 1600000000;  // 2020-09-13
+  }
+
+  // "2022-05-06T08:00:00Z" -> UTC epoch
+  static time_t parseUtc(const char *text) {
+    int year, month, day, hour, minute, second;
+
+    if (text == nullptr || sscanf(text, "%d-%d-%dT%d:%d:%d", &year, &month, &day, &hour, &minute, &second) != 6) {
+      return 0;
+    }
+
+    // 範囲外の値で桁あふれしないように、ここで弾く。ESP32のtime_tは32bit
+    if (year < 1970 || year > 2037 || month < 1 || month > 12 || day < 1 || day > 31 ||
+        hour < 0 || hour > 23 || minute < 0 || minute > 59 || second < 0 || second > 60) {
+      return 0;
+    }
+
+    // days from civil (1970-01-01)
+    year -= month <= 2;
+    int      era  = (year >= 0 ? year : year - 399) / 400;
+    unsigned yoe  = (unsigned)(year - era * 400);
+    unsigned doy  = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    unsigned doe  = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    long     days = (long)era * 146097 + (long)doe - 719468;
+
+    return (time_t)(days * 86400 + hour * 3600 + minute * 60 + second);
+  }
+
+ private:
+  struct Entry {
+    bool     enabled;
+    uint32_t next;
+    uint32_t requests;
+    uint32_t errors;
+    uint32_t failures;
+    uint32_t lastSuccess;
+  };
+
+  // millis() / 1000は49.7日で一周するので、64bitの時計から秒を作る
+  static uint32_t _now(void) {
+    return (uint32_t)(esp_timer_get_time() / 1000000);
+  }
+
+  // 次の発表時刻 + SCHEDULE_JMA_DELAY までの秒数
+  static uint32_t _secondsToNextReport(void) {
+    static const int hours[] = SCHEDULE_JMA_REPORT_HOURS;
+
+    struct tm info;
+    time_t    now = time(nullptr);
+    localtime_r(&now, &info);
+
+    int32_t current = info.tm_hour * 3600 + info.tm_min * 60 + info.tm_sec;
+
+    for (size_t i = 0; i < sizeof(hours) / sizeof(hours[0]); i++) {
+      int32_t report = hours[i] * 3600 + SCHEDULE_JMA_DELAY;
+      if (report > current) {
+        return report - current;
+      }
+    }
+
+    // 翌日の最初の発表
+    return 24 * 3600 - current + hours[0] * 3600 + SCHEDULE_JMA_DELAY;
+  }
+
+  Entry _entries[(int)SOURCE::SOURCE_MAX];
+};
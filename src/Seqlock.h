@@ -0,0 +1,83 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <string.h>
+
+#include <atomic>
+
+// 書き込みは1タスクのみ。読み込み側はロックせず、書き込み中だったら読み直す
+// Tはmemcpyでコピーできる型(固定長のバッファ)であること
+template <typename T>
+class Seqlock {
+ public:
+  Seqlock() : _sequence(0) {
+    memset((void *)&_value, 0, sizeof(T));
+  }
+
+  void write(const T &value) {
+    uint32_t sequence = _sequence.load(std::memory_order_relaxed);
+
+    _sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    memcpy((void *)&_value, (const void *)&value, sizeof(T));
+
+    _sequence.store(sequence + 2, std::memory_order_release);
+  }
+
+  // 読み込んだ値の版数を返す
+  uint32_t read(T &value) const {
+    uint32_t before;
+    uint32_t after;
+
+    for (;;) {
+      before = _sequence.load(std::memory_order_acquire);
+
+      if ((before & 1) == 0) {
+        memcpy((void *)&value, (const void *)&_value, sizeof(T));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = _sequence.load(std::memory_order_relaxed);
+
+        if (before == after) {
+          return before >> 1;
+        }
+      }
+
+      // 同じコアの優先度の低いタスクが書き込み中かもしれないので譲る
+      vTaskDelay(1);
+    }
+  }
+
+  uint32_t version(void) const {
+    return _sequence.load(std::memory_order_acquire) >> 1;
+  }
+
+ private:
+  std::atomic<uint32_t> _sequence;
+  T                     _value;
+};
@@ -0,0 +1,105 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <Preferences.h>
+#include <esp32-hal-log.h>
+
+// 書き込みの最小間隔。NVSはウェアレベリングされるが、無駄な書き込みは避ける
+#ifndef SNAPSHOT_MIN_INTERVAL_MS
+#define SNAPSHOT_MIN_INTERVAL_MS (10 * 60 * 1000)
+#endif
+
+// この時間更新できなければ、表示を古いデータとして扱う
+#ifndef SNAPSHOT_STALE_MS
+#define SNAPSHOT_STALE_MS (60 * 60 * 1000)
+#endif
+
+// 最後に取得できた天気情報をNVSに保存しておく
+// 起動直後から、画面とAPIで前回のデータを表示できる
+class SnapshotStore {
+ public:
+  SnapshotStore(const char *name = "snapshot") : _name(name),
+                                                 _lastWrite(0),
+                                                 _writes(0) {
+  }
+
+  bool restore(String &json) {
+    Preferences prefs;
+
+    if (!prefs.begin(_name, true)) {
+      log_e("fail to open %s", _name);
+      return false;
+    }
+
+    json = prefs.getString("json", "");
+    prefs.end();
+
+    _last = json;
+
+    return !json.isEmpty();
+  }
+
+  // 内容が変わった時だけ書き込む
+  bool save(const String &json, bool force = false) {
+    if (json.isEmpty() || json == _last) {
+      return false;
+    }
+
+    if (!force && _writes && (millis() - _lastWrite) < SNAPSHOT_MIN_INTERVAL_MS) {
+      return false;
+    }
+
+    Preferences prefs;
+
+    if (!prefs.begin(_name, false)) {
+      log_e("fail to open %s", _name);
+      return false;
+    }
+
+    size_t length = prefs.putString("json", json);
+    prefs.end();
+
+    if (length == 0) {
+      log_e("fail to save snapshot.");
+      return false;
+    }
+
+    _last      = json;
+    _lastWrite = millis();
+    _writes++;
+
+    log_d("snapshot saved. %d bytes, %d writes", length, _writes);
+
+    return true;
+  }
+
+ private:
+  const char *_name;
+  String      _last;
+  uint32_t    _lastWrite;
+  uint32_t    _writes;
+};
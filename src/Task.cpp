@@ -25,21 +25,45 @@ SOFTWARE.
 #include <Task.h>
 #include <esp32-hal-log.h>
 #include <esp_log.h>
+#include <esp_timer.h>
 #include <freertos/FreeRTOS.h>
 #include <freertos/task.h>
 
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
 #include <string>
 
+Task*       Task::s_tasks[TASK_MAX] = {nullptr};
+xTaskHandle Task::s_loopHandle      = nullptr;
+
 Task::Task(std::string taskName, uint16_t taskSize, uint8_t priority) {
-  m_handle   = nullptr;
-  m_taskdata = nullptr;
-  m_taskname = taskName;
-  m_tasksize = taskSize;
-  m_priority = priority;
-  m_coreid   = tskNO_AFFINITY;
+  m_handle      = nullptr;
+  m_taskdata    = nullptr;
+  m_taskname    = taskName;
+  m_tasksize    = taskSize;
+  m_priority    = priority;
+  m_coreid      = tskNO_AFFINITY;
+  m_iterations  = 0;
+  m_lastTick    = 0;
+  m_lastPeriod  = 0;
+  m_maxPeriod   = 0;
+  m_totalPeriod = 0;
+
+  for (int i = 0; i < TASK_MAX; i++) {
+    if (s_tasks[i] == nullptr) {
+      s_tasks[i] = this;
+      break;
+    }
+  }
 }
 
 Task::~Task() {
+  for (int i = 0; i < TASK_MAX; i++) {
+    if (s_tasks[i] == this) {
+      s_tasks[i] = nullptr;
+    }
+  }
 }
 
 void Task::runTask(void* pTaskInstance) {
@@ -71,6 +95,14 @@ void Task::delay(int ms) {
   ::vTaskDelay(ms / portTICK_PERIOD_MS);
 }
 
+void Task::notify(void) {
+  if (m_handle == nullptr) {
+    return;
+  }
+
+  ::xTaskNotifyGive(m_handle);
+}
+
 void Task::setTaskSize(uint16_t size) {
   m_tasksize = size;
 }
@@ -86,3 +118,169 @@ void Task::setTaskName(std::string name) {
 void Task::setCore(BaseType_t coreID) {
   m_coreid = coreID;
 }
+
+void Task::loopTick(void) {
+  uint32_t now = (uint32_t)esp_timer_get_time();
+
+  if (m_iterations) {
+    m_lastPeriod = now - m_lastTick;
+    m_totalPeriod += m_lastPeriod;
+
+    if (m_lastPeriod > m_maxPeriod) {
+      m_maxPeriod = m_lastPeriod;
+    }
+  }
+
+  m_lastTick = now;
+  m_iterations++;
+}
+
+uint32_t Task::getStackHighWaterMark(void) {
+  if (m_handle == nullptr) {
+    return 0;
+  }
+
+  // ESP32のFreeRTOSではbyte単位
+  return ::uxTaskGetStackHighWaterMark(m_handle);
+}
+
+static void appendf(std::string& out, const char* format, ...) {
+  char    buffer[160];
+  va_list args;
+
+  va_start(args, format);
+  vsnprintf(buffer, sizeof(buffer), format, args);
+  va_end(args);
+
+  out += buffer;
+}
+
+// 全タスクの実行時間[%]。前回呼び出し時からの差分で計算する
+#if (configUSE_TRACE_FACILITY == 1) && (configGENERATE_RUN_TIME_STATS == 1)
+#define TASK_RUNTIME_STATS 1
+#define TASK_SNAPSHOT_MAX  32
+
+// 前回の値。/tasks.json(ネットワークタスク)とlogStatus(ループタスク)で別々に持つ
+struct RuntimeSnapshot {
+  TaskHandle_t handle[TASK_SNAPSHOT_MAX];
+  uint32_t     counter[TASK_SNAPSHOT_MAX];
+  uint32_t     total;
+};
+
+static RuntimeSnapshot jsonSnapshot;
+static RuntimeSnapshot logSnapshot;
+
+static void appendRuntime(std::string& out, bool json, RuntimeSnapshot& last) {
+  UBaseType_t                     count = uxTaskGetNumberOfTasks();
+  std::unique_ptr<TaskStatus_t[]> status(new TaskStatus_t[count]);
+  uint32_t                        total = 0;
+
+  count = uxTaskGetSystemState(status.get(), count, &total);
+
+  uint32_t elapsed = total - last.total;
+  last.total       = total;
+
+  for (UBaseType_t i = 0; i < count && i < TASK_SNAPSHOT_MAX; i++) {
+    uint32_t previous = 0;
+    for (int j = 0; j < TASK_SNAPSHOT_MAX; j++) {
+      if (last.handle[j] == status[i].xHandle) {
+        previous = last.counter[j];
+        break;
+      }
+    }
+
+    // 1コアあたりの割合。IDLE0/IDLE1が小さいコアが飽和している
+    uint32_t percent = elapsed ? (uint32_t)((uint64_t)(status[i].ulRunTimeCounter - previous) * 100 / elapsed) : 0;
+
+    if (json) {
+      appendf(out, "%s{\"name\":\"%s\",\"priority\":%u,\"stackFree\":%u,\"runtime\":%u}",
+              i ? "," : "",
+              status[i].pcTaskName,
+              status[i].uxCurrentPriority,
+              status[i].usStackHighWaterMark,
+              percent);
+    } else {
+      appendf(out, "  %-16s prio %2u, stack free %5u, runtime %3u%%\n",
+              status[i].pcTaskName,
+              status[i].uxCurrentPriority,
+              status[i].usStackHighWaterMark,
+              percent);
+    }
+  }
+
+  for (UBaseType_t i = 0; i < TASK_SNAPSHOT_MAX; i++) {
+    last.handle[i]  = i < count ? status[i].xHandle : nullptr;
+    last.counter[i] = i < count ? status[i].ulRunTimeCounter : 0;
+  }
+}
+#endif
+
+void Task::setLoopTask(void) {
+  s_loopHandle = ::xTaskGetCurrentTaskHandle();
+}
+
+// ネットワークタスクから呼ばれるので、loop()のタスクは覚えたハンドルで調べる
+static uint32_t loopStackFree(xTaskHandle handle) {
+  return handle ? ::uxTaskGetStackHighWaterMark(handle) : 0;
+}
+
+std::string Task::toJson(void) {
+  std::string json("{\"tasks\":[");
+
+  bool first = true;
+  for (int i = 0; i < TASK_MAX; i++) {
+    Task* task = s_tasks[i];
+    if (task == nullptr) {
+      continue;
+    }
+
+    appendf(json, "%s{\"name\":\"%s\",\"core\":%d,\"stackSize\":%u,\"stackFree\":%u,",
+            first ? "" : ",",
+            task->m_taskname.c_str(),
+            task->m_coreid,
+            task->m_tasksize,
+            task->getStackHighWaterMark());
+    appendf(json, "\"iterations\":%u,\"lastPeriod\":%u,\"maxPeriod\":%u,\"avgPeriod\":%u}",
+            task->m_iterations,
+            task->m_lastPeriod,
+            task->m_maxPeriod,
+            task->m_iterations > 1 ? (uint32_t)(task->m_totalPeriod / (task->m_iterations - 1)) : 0);
+    first = false;
+  }
+
+  appendf(json, "],\"loopStackFree\":%u", loopStackFree(s_loopHandle));
+
+#if defined(TASK_RUNTIME_STATS)
+  json += ",\"system\":[";
+  appendRuntime(json, true, jsonSnapshot);
+  json += "]";
+#endif
+
+  json += "}";
+
+  return json;
+}
+
+void Task::logStatus(void) {
+  for (int i = 0; i < TASK_MAX; i++) {
+    Task* task = s_tasks[i];
+    if (task == nullptr) {
+      continue;
+    }
+
+    log_i("Task %s : core %d, stack %u/%u free, %u loops, period last %u us max %u us",
+          task->m_taskname.c_str(),
+          task->m_coreid,
+          task->getStackHighWaterMark(),
+          task->m_tasksize,
+          task->m_iterations,
+          task->m_lastPeriod,
+          task->m_maxPeriod);
+  }
+
+#if defined(TASK_RUNTIME_STATS)
+  std::string text;
+  appendRuntime(text, false, logSnapshot);
+  log_i("Runtime stats\n%s", text.c_str());
+#endif
+}
@@ -29,6 +29,14 @@ SOFTWARE.
 
 #include <string>
 
+#ifndef TASK_MAX
+#define TASK_MAX 8
+#endif
+
+#ifndef TASK_STATUS_PERIOD_MS
+#define TASK_STATUS_PERIOD_MS (5 * 60 * 1000)
+#endif
+
 class Task {
  public:
   Task(std::string taskName = "AutoConnect", uint16_t taskSize = 4096, uint8_t priority = 5);
@@ -37,6 +45,8 @@ class Task {
   void stop();
 
   void delay(int ms);
+  // 他のタスクからrun()を起こす
+  void notify(void);
 
   virtual void run(void* data) = 0;
 
@@ -45,6 +55,15 @@ class Task {
   void setTaskName(std::string name);
   void setCore(BaseType_t coreID);
 
+  // run()のループの先頭で呼ぶ。前回からの間隔を記録する
+  void     loopTick(void);
+  uint32_t getStackHighWaterMark(void);
+
+  // loop()のタスクを覚える。setup()から呼ぶ
+  static void        setLoopTask(void);
+  static std::string toJson(void);
+  static void        logStatus(void);
+
  private:
   xTaskHandle m_handle;
   void*       m_taskdata;
@@ -53,4 +72,13 @@ class Task {
   uint16_t    m_tasksize;
   uint8_t     m_priority;
   BaseType_t  m_coreid;
+
+  uint32_t m_iterations;
+  uint32_t m_lastTick;
+  uint32_t m_lastPeriod;
+  uint32_t m_maxPeriod;
+  uint64_t m_totalPeriod;
+
+  static Task*       s_tasks[TASK_MAX];
+  static xTaskHandle s_loopHandle;
 };
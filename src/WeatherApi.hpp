@@ -0,0 +1,204 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp32-hal-log.h>
+
+#include <RateLimiter.hpp>
+#include <Seqlock.h>
+#include <WeatherSnapshot.h>
+
+// weather.jsonの受付。全体で [回/秒] と続けて受けられる回数
+#ifndef DOC_API_RATE
+#define DOC_API_RATE 20
+#endif
+
+#ifndef DOC_API_BURST
+#define DOC_API_BURST 40
+#endif
+
+// クライアントごと。Viewは数時間に1回しか取りに来ない
+#ifndef DOC_API_CLIENT_RATE
+#define DOC_API_CLIENT_RATE 1
+#endif
+
+#ifndef DOC_API_CLIENT_BURST
+#define DOC_API_CLIENT_BURST 3
+#endif
+
+// ATOM Docの /api/v1/weather.json
+// 公開中の天気情報を持ち、版ごとに作ったJSONを同じ版のViewへ使い回す
+// serve()はWebServerと同じ形(client/hasArg/arg/header/sendHeader/send)のサーバーなら何でもよいので、ホストでもビルドできる
+class WeatherApi {
+ public:
+  // baseは版の始まり。起動ごとに違う値にする
+  WeatherApi(uint32_t base) : _jsonVersion(0),
+                              _serverLimit(DOC_API_RATE, DOC_API_BURST),
+                              _clientLimit(DOC_API_CLIENT_RATE, DOC_API_CLIENT_BURST),
+                              _served(0),
+                              _notModified(0),
+                              _limited(0),
+                              _shed(0),
+                              _builds(0),
+                              _revisions(base),
+                              _deltaSince(0),
+                              _deltaRevision(0),
+                              _deltas(0),
+                              _bytesFull(0),
+                              _bytesDelta(0) {
+    clearSnapshot(_lastPublished);
+  }
+
+  // 公開する版を進め、変わったフィールドに版を付ける。書き込むのは1タスクだけ
+  void publish(const WeatherSnapshot &weather) {
+    _revisions.publish(diffSnapshot(_lastPublished, weather));
+
+    _lastPublished = weather;
+    _published.write(weather);
+  }
+
+  // 公開中の天気情報を取得する。どのタスクからでも読める
+  uint32_t read(WeatherSnapshot &snapshot) const {
+    return _published.read(snapshot);
+  }
+
+  // 公開中の版が変わった時だけJSONを作り直す
+  const String &prepareJson(void) {
+    WeatherSnapshot snapshot;
+    uint32_t        version = _published.read(snapshot);
+
+    if (version != _jsonVersion || _json.isEmpty()) {
+      if (serializeSnapshot(snapshot, _json, SNAPSHOT_ALL_FIELDS, _revisions.revision())) {
+        _jsonVersion = version;
+        _builds++;
+      }
+    }
+
+    return _json;
+  }
+
+  // 同じ版は用意済みのバッファをそのまま返す。混んでいる時はすぐに断る
+  template <typename TServer>
+  void serve(TServer &server) {
+    if (!_serverLimit.allow(0)) {
+      _shed++;
+      server.sendHeader("Retry-After", "1");
+      server.send(503, "text/plain", "busy");
+      return;
+    }
+
+    if (!_clientLimit.allow(server.client().remoteIP())) {
+      _limited++;
+      server.sendHeader("Retry-After", "1");
+      server.send(429, "text/plain", "too many requests");
+      return;
+    }
+
+    // ?since=N はViewが持っている版。同じなら変更なし、この起動中の版なら差分を返す
+    uint32_t since  = server.hasArg("since") ? strtoul(server.arg("since").c_str(), nullptr, 10) : 0;
+    uint32_t fields = _revisions.fieldsSince(since);
+    String   etag   = "\"" + String(_revisions.revision()) + "\"";
+
+    server.sendHeader("ETag", etag);
+
+    if (fields == 0 || server.header("If-None-Match") == etag) {
+      _notModified++;
+      server.send(304);
+      return;
+    }
+
+    if (fields != SNAPSHOT_ALL_FIELDS) {
+      const String &delta = _prepareDelta(since, fields);
+
+      _deltas++;
+      _bytesDelta += delta.length();
+      server.send(200, "application/json", delta);
+      return;
+    }
+
+    const String &json = prepareJson();
+
+    _served++;
+    _bytesFull += json.length();
+    server.send(200, "application/json", json);
+  }
+
+  String stats(void) {
+    DynamicJsonDocument doc(JSON_OBJECT_SIZE(9));
+
+    doc["served"]      = _served;
+    doc["notModified"] = _notModified;
+    doc["limited"]     = _limited;
+    doc["shed"]        = _shed;
+    doc["builds"]      = _builds;
+    doc["deltas"]      = _deltas;
+    doc["bytesFull"]   = _bytesFull;
+    doc["bytesDelta"]  = _bytesDelta;
+    doc["revision"]    = _revisions.revision();
+
+    String json;
+    serializeJson(doc, json);
+
+    return json;
+  }
+
+ private:
+  // 同じ版から取りに来るViewが多いので、最後に作った差分を使い回す
+  const String &_prepareDelta(uint32_t since, uint32_t fields) {
+    if (since != _deltaSince || _deltaRevision != _revisions.revision()) {
+      serializeSnapshot(_lastPublished, _delta, fields, _revisions.revision());
+      _deltaSince    = since;
+      _deltaRevision = _revisions.revision();
+    }
+
+    return _delta;
+  }
+
+  String   _json;
+  uint32_t _jsonVersion;
+
+  RateLimiter _serverLimit;
+  RateLimiter _clientLimit;
+  uint32_t    _served;
+  uint32_t    _notModified;
+  uint32_t    _limited;
+  uint32_t    _shed;
+  uint32_t    _builds;
+
+  // 差分の配信
+  WeatherSnapshot   _lastPublished;
+  SnapshotRevisions _revisions;
+  String            _delta;
+  uint32_t          _deltaSince;
+  uint32_t          _deltaRevision;
+  uint32_t          _deltas;
+  uint32_t          _bytesFull;
+  uint32_t          _bytesDelta;
+
+  // ネットワークタスクで更新し、まとめて公開する
+  Seqlock<WeatherSnapshot> _published;
+};
@@ -0,0 +1,356 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <esp32-hal-log.h>
+
+#include <cmath>
+#include <cstdio>
+
+// weather.jsonの入れ子の深さ。通常は4段
+#ifndef VIEW_DOC_NESTING
+#define VIEW_DOC_NESTING 6
+#endif
+
+// weather.jsonを読む上限。通常は600バイトほど
+#ifndef VIEW_DOC_MAX_BYTES
+#define VIEW_DOC_MAX_BYTES 2048
+#endif
+
+// 受け取った数値はこの範囲に寄せる。気温[*C]、湿度[%]、気圧[hPa](0は未取得)
+#define SNAPSHOT_DEGREE_MIN   -60.0f
+#define SNAPSHOT_DEGREE_MAX   60.0f
+#define SNAPSHOT_HUMIDITY_MIN 0.0f
+#define SNAPSHOT_HUMIDITY_MAX 100.0f
+#define SNAPSHOT_PRESSURE_MIN 0.0f
+#define SNAPSHOT_PRESSURE_MAX 1100.0f
+
+// ATOM Doc、ATOM View、Displayで共有する天気情報
+// ヒープを使わない固定長のレイアウトなので、Seqlockでそのままコピーできる
+struct WeatherSnapshot {
+  char publishingOffice[48];  // "大阪管区気象台"
+  char reportDatetime[32];    // "2022-05-06T17:00:00+09:00"
+  char timeDefines[32];
+  char area[32];              // "大阪府"
+  char weatherCodes[8];       // "100"
+  char weathersJP[64];        // "晴"
+  char weathersEN[64];        // "CLEAR"
+  char winds[128];            // "南西の風　後　北東の風"
+  char waves[64];             // "０．５メートル"
+  char iconFile[16];          // "/100.gif"
+
+  float degree;
+  float humidity;
+  float pressure;
+
+  uint32_t nextUpdate;  // ATOM Docが次に取得する時刻(UTC epoch)。不明なら0
+
+  bool stale;  // 前回起動時のデータ、または長時間更新できていない
+};
+
+// /api/v1/weather.jsonの大きさ。ルートに7つ、timeSeries[1]に2つ、areas[1]に10のフィールド
+#define SNAPSHOT_JSON_SLOTS                                               \
+  (JSON_OBJECT_SIZE(7) + JSON_ARRAY_SIZE(1) + JSON_OBJECT_SIZE(2) +       \
+   JSON_ARRAY_SIZE(1) + JSON_OBJECT_SIZE(10))
+
+// 読む時はキーと文字列をコピーする。キーは合わせて177バイト
+#define SNAPSHOT_JSON_CAPACITY (SNAPSHOT_JSON_SLOTS + 192 + sizeof(WeatherSnapshot))
+
+// 差分で送る時の単位。FIELD_STALEはATOM Docのデータが古いこと
+enum class FIELD : int {
+  FIELD_PUBLISHING_OFFICE,
+  FIELD_REPORT_DATETIME,
+  FIELD_TIME_DEFINES,
+  FIELD_AREA,
+  FIELD_WEATHER_CODES,
+  FIELD_WEATHERS_JP,
+  FIELD_WEATHERS_EN,
+  FIELD_WINDS,
+  FIELD_WAVES,
+  FIELD_ICON,
+  FIELD_DEGREE,
+  FIELD_HUMIDITY,
+  FIELD_PRESSURE,
+  FIELD_NEXT_UPDATE,
+  FIELD_STALE,
+  FIELD_MAX
+};
+
+#define SNAPSHOT_FIELD(field) (1u << (int)FIELD::field)
+#define SNAPSHOT_ALL_FIELDS ((1u << (int)FIELD::FIELD_MAX) - 1)
+
+// 文字列でなければ空にする。入りきらない時は、UTF-8の文字の途中で切らない
+template <size_t N>
+inline void setSnapshotField(char (&field)[N], const char *value) {
+  size_t length = strlcpy(field, value ? value : "", N);
+
+  if (length >= N && N > 1) {
+    size_t lead = N - 2;
+    while (lead > 0 && ((uint8_t)field[lead] & 0xC0) == 0x80) {
+      lead--;
+    }
+
+    uint8_t c    = field[lead];
+    size_t  size = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+    if (lead + size > N - 1) {
+      field[lead] = '\0';
+    }
+  }
+}
+
+// 数値でないか、有限でなければfallback
+inline float snapshotNumber(JsonVariantConst value, float fallback = 0.0f) {
+  if (!value.is<float>()) {
+    return fallback;
+  }
+
+  float number = value.as<float>();
+  return std::isfinite(number) ? number : fallback;
+}
+
+inline void clearSnapshot(WeatherSnapshot &snapshot) {
+  memset(&snapshot, 0, sizeof(snapshot));
+}
+
+inline float clampSnapshotNumber(float value, float low, float high) {
+  return value < low ? low : value > high ? high : value;
+}
+
+// 範囲外の値で、表示の文字列やグラフがあふれないようにする
+inline void clampSnapshot(WeatherSnapshot &snapshot) {
+  snapshot.degree   = clampSnapshotNumber(snapshot.degree, SNAPSHOT_DEGREE_MIN, SNAPSHOT_DEGREE_MAX);
+  snapshot.humidity = clampSnapshotNumber(snapshot.humidity, SNAPSHOT_HUMIDITY_MIN, SNAPSHOT_HUMIDITY_MAX);
+  snapshot.pressure = clampSnapshotNumber(snapshot.pressure, SNAPSHOT_PRESSURE_MIN, SNAPSHOT_PRESSURE_MAX);
+}
+
+// 画面に出す数値の文字列(Display::_drawToday)
+struct SnapshotText {
+  char degree[10];
+  char humidity[10];
+  char pressure[10];
+};
+
+// 入りきらなければ切り詰めてfalse
+inline bool formatSnapshot(const WeatherSnapshot &snapshot, SnapshotText &text) {
+  int degree   = snprintf(text.degree, sizeof(text.degree), "%2.1f", snapshot.degree);
+  int humidity = snprintf(text.humidity, sizeof(text.humidity), "%2.0f", snapshot.humidity);
+  int pressure = snprintf(text.pressure, sizeof(text.pressure), "%4.1f", snapshot.pressure);
+
+  return degree >= 0 && degree < (int)sizeof(text.degree) &&
+         humidity >= 0 && humidity < (int)sizeof(text.humidity) &&
+         pressure >= 0 && pressure < (int)sizeof(text.pressure);
+}
+
+// 変わったフィールドのビットを返す
+inline uint32_t diffSnapshot(const WeatherSnapshot &a, const WeatherSnapshot &b) {
+  uint32_t fields = 0;
+
+#define SNAPSHOT_DIFF_STRING(member, field) \
+  if (strcmp(a.member, b.member) != 0) fields |= SNAPSHOT_FIELD(field)
+#define SNAPSHOT_DIFF_VALUE(member, field) \
+  if (a.member != b.member) fields |= SNAPSHOT_FIELD(field)
+
+  SNAPSHOT_DIFF_STRING(publishingOffice, FIELD_PUBLISHING_OFFICE);
+  SNAPSHOT_DIFF_STRING(reportDatetime, FIELD_REPORT_DATETIME);
+  SNAPSHOT_DIFF_STRING(timeDefines, FIELD_TIME_DEFINES);
+  SNAPSHOT_DIFF_STRING(area, FIELD_AREA);
+  SNAPSHOT_DIFF_STRING(weatherCodes, FIELD_WEATHER_CODES);
+  SNAPSHOT_DIFF_STRING(weathersJP, FIELD_WEATHERS_JP);
+  SNAPSHOT_DIFF_STRING(weathersEN, FIELD_WEATHERS_EN);
+  SNAPSHOT_DIFF_STRING(winds, FIELD_WINDS);
+  SNAPSHOT_DIFF_STRING(waves, FIELD_WAVES);
+  SNAPSHOT_DIFF_STRING(iconFile, FIELD_ICON);
+  SNAPSHOT_DIFF_VALUE(degree, FIELD_DEGREE);
+  SNAPSHOT_DIFF_VALUE(humidity, FIELD_HUMIDITY);
+  SNAPSHOT_DIFF_VALUE(pressure, FIELD_PRESSURE);
+  SNAPSHOT_DIFF_VALUE(nextUpdate, FIELD_NEXT_UPDATE);
+  SNAPSHOT_DIFF_VALUE(stale, FIELD_STALE);
+
+#undef SNAPSHOT_DIFF_STRING
+#undef SNAPSHOT_DIFF_VALUE
+
+  return fields;
+}
+
+// /api/v1/weather.jsonの形式
+// fieldsを指定すると、そのフィールドだけを同じ形で書き出す(差分)
+// 入りきらないフィールドがあればfalse
+inline bool serializeSnapshot(const WeatherSnapshot &snapshot, String &json,
+                              uint32_t fields = SNAPSHOT_ALL_FIELDS, uint32_t revision = 0) {
+  DynamicJsonDocument doc(SNAPSHOT_JSON_CAPACITY);
+
+#define SNAPSHOT_HAS(field) (fields & SNAPSHOT_FIELD(field))
+
+  if (revision) {
+    doc["revision"] = revision;
+  }
+
+  if (fields != SNAPSHOT_ALL_FIELDS) {
+    doc["delta"] = true;
+  }
+
+  if (SNAPSHOT_HAS(FIELD_PUBLISHING_OFFICE)) doc["publishingOffice"] = snapshot.publishingOffice;
+  if (SNAPSHOT_HAS(FIELD_REPORT_DATETIME)) doc["reportDatetime"] = snapshot.reportDatetime;
+  if (SNAPSHOT_HAS(FIELD_NEXT_UPDATE)) doc["nextUpdate"] = snapshot.nextUpdate;
+  if (SNAPSHOT_HAS(FIELD_STALE)) doc["stale"] = snapshot.stale;
+
+  const uint32_t areaFields = SNAPSHOT_ALL_FIELDS &
+                              ~(SNAPSHOT_FIELD(FIELD_PUBLISHING_OFFICE) |
+                                SNAPSHOT_FIELD(FIELD_REPORT_DATETIME) |
+                                SNAPSHOT_FIELD(FIELD_NEXT_UPDATE) |
+                                SNAPSHOT_FIELD(FIELD_TIME_DEFINES) |
+                                SNAPSHOT_FIELD(FIELD_STALE));
+
+  if (fields & (areaFields | SNAPSHOT_FIELD(FIELD_TIME_DEFINES))) {
+    JsonObject timeSeries_0 = doc["timeSeries"].createNestedObject();
+    if (SNAPSHOT_HAS(FIELD_TIME_DEFINES)) timeSeries_0["timeDefines"] = snapshot.timeDefines;
+
+    if (fields & areaFields) {
+      JsonObject areas_0 = timeSeries_0["areas"].createNestedObject();
+      if (SNAPSHOT_HAS(FIELD_AREA)) areas_0["area"] = snapshot.area;
+      if (SNAPSHOT_HAS(FIELD_WEATHER_CODES)) areas_0["weatherCodes"] = snapshot.weatherCodes;
+      if (SNAPSHOT_HAS(FIELD_WEATHERS_JP)) areas_0["weathers_jp"] = snapshot.weathersJP;
+      if (SNAPSHOT_HAS(FIELD_WEATHERS_EN)) areas_0["weathers_en"] = snapshot.weathersEN;
+      if (SNAPSHOT_HAS(FIELD_WINDS)) areas_0["winds"] = snapshot.winds;
+      if (SNAPSHOT_HAS(FIELD_WAVES)) areas_0["waves"] = snapshot.waves;
+      if (SNAPSHOT_HAS(FIELD_ICON)) areas_0["icon"] = snapshot.iconFile;
+      if (SNAPSHOT_HAS(FIELD_DEGREE)) areas_0["degree"] = snapshot.degree;
+      if (SNAPSHOT_HAS(FIELD_HUMIDITY)) areas_0["humidity"] = snapshot.humidity;
+      if (SNAPSHOT_HAS(FIELD_PRESSURE)) areas_0["pressure"] = snapshot.pressure;
+    }
+  }
+
+#undef SNAPSHOT_HAS
+
+  json = "";
+  serializeJson(doc, json);
+
+  if (doc.overflowed()) {
+    log_e("snapshot does not fit in %u bytes", (unsigned)doc.capacity());
+    return false;
+  }
+
+  return true;
+}
+
+// "delta": true の時は、含まれているフィールドだけを書き換える
+inline bool deserializeSnapshot(JsonDocument &doc, WeatherSnapshot &snapshot) {
+  bool       delta   = doc["delta"] | false;
+  JsonObject areas_0 = doc["timeSeries"][0]["areas"][0];
+
+  if (!delta && areas_0.isNull()) {
+    return false;
+  }
+
+  auto apply = [delta](JsonVariant value) {
+    return !delta || !value.isNull();
+  };
+
+  if (apply(doc["publishingOffice"])) setSnapshotField(snapshot.publishingOffice, doc["publishingOffice"]);
+  if (apply(doc["reportDatetime"])) setSnapshotField(snapshot.reportDatetime, doc["reportDatetime"]);
+  if (apply(doc["timeSeries"][0]["timeDefines"])) setSnapshotField(snapshot.timeDefines, doc["timeSeries"][0]["timeDefines"]);
+  if (apply(areas_0["area"])) setSnapshotField(snapshot.area, areas_0["area"]);
+  if (apply(areas_0["weatherCodes"])) setSnapshotField(snapshot.weatherCodes, areas_0["weatherCodes"]);
+  if (apply(areas_0["weathers_jp"])) setSnapshotField(snapshot.weathersJP, areas_0["weathers_jp"]);
+  if (apply(areas_0["weathers_en"])) setSnapshotField(snapshot.weathersEN, areas_0["weathers_en"]);
+  if (apply(areas_0["winds"])) setSnapshotField(snapshot.winds, areas_0["winds"]);
+  if (apply(areas_0["waves"])) setSnapshotField(snapshot.waves, areas_0["waves"]);
+  if (apply(areas_0["icon"])) setSnapshotField(snapshot.iconFile, areas_0["icon"]);
+
+  if (apply(areas_0["degree"])) snapshot.degree = snapshotNumber(areas_0["degree"]);
+  if (apply(areas_0["humidity"])) snapshot.humidity = snapshotNumber(areas_0["humidity"]);
+  if (apply(areas_0["pressure"])) snapshot.pressure = snapshotNumber(areas_0["pressure"]);
+
+  if (apply(doc["nextUpdate"])) snapshot.nextUpdate = doc["nextUpdate"] | 0u;
+  if (apply(doc["stale"])) snapshot.stale = doc["stale"] | false;
+
+  clampSnapshot(snapshot);
+
+  return true;
+}
+
+// 公開した版の管理。フィールドごとに、最後に変わった版を持つ
+// 版は起動ごとに違う値から始めるので、前の起動の版を持つViewには全部を送る
+class SnapshotRevisions {
+ public:
+  SnapshotRevisions(uint32_t base) : _base(base),
+                                     _revision(base) {
+    for (auto &revision : _fields) {
+      revision = base;
+    }
+  }
+
+  // 変わったフィールドがあれば版を進める
+  void publish(uint32_t fields) {
+    if (fields == 0) {
+      return;
+    }
+
+    _revision++;
+
+    for (int i = 0; i < (int)FIELD::FIELD_MAX; i++) {
+      if (fields & (1u << i)) {
+        _fields[i] = _revision;
+      }
+    }
+  }
+
+  // sinceの版を持っているViewへ送るフィールド
+  // 0は変更なし、SNAPSHOT_ALL_FIELDSは全部(差分にできない)
+  uint32_t fieldsSince(uint32_t since) const {
+    if (since == 0) {
+      return SNAPSHOT_ALL_FIELDS;
+    }
+
+    if (since == _revision) {
+      return 0;
+    }
+
+    if (since <= _base || since > _revision) {
+      return SNAPSHOT_ALL_FIELDS;
+    }
+
+    uint32_t fields = 0;
+
+    for (int i = 0; i < (int)FIELD::FIELD_MAX; i++) {
+      if (_fields[i] > since) {
+        fields |= 1u << i;
+      }
+    }
+
+    return fields;
+  }
+
+  uint32_t revision(void) const {
+    return _revision;
+  }
+
+ private:
+  uint32_t _base;
+  uint32_t _revision;
+  uint32_t _fields[(int)FIELD::FIELD_MAX];
+};
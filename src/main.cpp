@@ -22,16 +22,23 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+#if defined(ATOM_BENCHMARK)
+#include <BenchmarkSuite.hpp>
+
+static BenchmarkSuite app;
+#else
 #include <Controller.hpp>
 
 static Controller app;
+#endif
 
-// CORE1
+// CORE1 描画タスク
+// CORE0 ネットワークタスク(WebServer, 天気の取得, mDNS)
+// loop()はメッセージの受け渡しと監視のみ
 void setup() {
   app.begin();
 }
 
 void loop() {
   app.update();
-  delay(1);
 }
@@ -0,0 +1,220 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+#pragma once
+
+#include <ArduinoJson.h>
+#include <JmaForecast.h>
+#include <Scheduler.hpp>
+#include <WeatherSnapshot.h>
+
+#include <cmath>
+#include <cstring>
+
+// 外から受け取るJSONを読む処理に、任意のバイト列を与えて調べる
+// 問題があればその内容を返し、なければnullptrを返す
+// fuzz_weather.cpp(libFuzzer)とtest_corpus(コーパスの再生)から使う
+
+// ATOMDoc::_codeDoc、ATOMView::_docと同じ容量
+#define FUZZ_JMA_CAPACITY  DOC_JMA_CAPACITY
+#define FUZZ_VIEW_CAPACITY SNAPSHOT_JSON_CAPACITY
+
+// 文字列のフィールドがバッファの中で終わっていること
+inline const char *fuzzCheckTerminated(const WeatherSnapshot &weather) {
+#define FUZZ_TERMINATED(field)                                   \
+  if (strnlen(weather.field, sizeof(weather.field)) >= sizeof(weather.field)) { \
+    return #field " is not terminated";                          \
+  }
+
+  FUZZ_TERMINATED(publishingOffice);
+  FUZZ_TERMINATED(reportDatetime);
+  FUZZ_TERMINATED(timeDefines);
+  FUZZ_TERMINATED(area);
+  FUZZ_TERMINATED(weatherCodes);
+  FUZZ_TERMINATED(weathersJP);
+  FUZZ_TERMINATED(weathersEN);
+  FUZZ_TERMINATED(winds);
+  FUZZ_TERMINATED(waves);
+  FUZZ_TERMINATED(iconFile);
+
+#undef FUZZ_TERMINATED
+
+  return nullptr;
+}
+
+// 画面に出す数値の文字列が、Displayのバッファに入ること
+inline const char *fuzzCheckFormat(const WeatherSnapshot &weather) {
+  SnapshotText text;
+
+  if (!formatSnapshot(weather, text)) {
+    return "number does not fit the display buffer";
+  }
+
+  return nullptr;
+}
+
+// 書き出して読み直すと、同じ値に戻ること
+// 浮動小数点は書き出しで丸められるので、有限であることだけを見る
+inline const char *fuzzCheckRoundTrip(const WeatherSnapshot &weather) {
+  const uint32_t numbers = SNAPSHOT_FIELD(FIELD_DEGREE) |
+                           SNAPSHOT_FIELD(FIELD_HUMIDITY) |
+                           SNAPSHOT_FIELD(FIELD_PRESSURE);
+
+  String              json;
+  DynamicJsonDocument doc(FUZZ_VIEW_CAPACITY);
+  WeatherSnapshot     copy;
+
+  serializeSnapshot(weather, json);
+  clearSnapshot(copy);
+
+  if (deserializeJson(doc, json, DeserializationOption::NestingLimit(VIEW_DOC_NESTING))) {
+    return "serialized snapshot does not parse";
+  }
+
+  if (!deserializeSnapshot(doc, copy)) {
+    return "serialized snapshot is rejected";
+  }
+
+  if (diffSnapshot(weather, copy) & ~numbers) {
+    return "snapshot changed in round trip";
+  }
+
+  if (!std::isfinite(copy.degree) || !std::isfinite(copy.humidity) || !std::isfinite(copy.pressure)) {
+    return "round trip produced a non-finite number";
+  }
+
+  return nullptr;
+}
+
+// 気象庁の予報。ATOMDoc::requestWeatherJson()と同じフィルタと入れ子の制限で読む
+inline const char *fuzzJmaForecast(const uint8_t *data, size_t size) {
+  StaticJsonDocument<DOC_JMA_FILTER_CAPACITY> filter;
+  DynamicJsonDocument     doc(FUZZ_JMA_CAPACITY);
+  WeatherSnapshot         weather;
+
+  deserializeJson(filter, jmaFilter());
+  clearSnapshot(weather);
+
+  if (deserializeJson(doc, (const char *)data, size,
+                      DeserializationOption::Filter(filter),
+                      DeserializationOption::NestingLimit(DOC_JMA_NESTING))) {
+    return nullptr;
+  }
+
+  if (!parseJmaForecast(doc, weather)) {
+    return nullptr;
+  }
+
+  const char *error = fuzzCheckTerminated(weather);
+  return error ? error : fuzzCheckRoundTrip(weather);
+}
+
+// ATOM Docの/api/v1/weather.json。全体と差分の両方を、前の値に重ねて適用する
+inline const char *fuzzDocSnapshot(const uint8_t *data, size_t size) {
+  DynamicJsonDocument doc(FUZZ_VIEW_CAPACITY);
+  WeatherSnapshot     weather;
+
+  clearSnapshot(weather);
+  setSnapshotField(weather.area, "大阪府");
+  setSnapshotField(weather.iconFile, "/100.gif");
+  weather.degree = 20.5f;
+
+  if (deserializeJson(doc, (const char *)data, size, DeserializationOption::NestingLimit(VIEW_DOC_NESTING))) {
+    return nullptr;
+  }
+
+  if (!deserializeSnapshot(doc, weather)) {
+    return nullptr;
+  }
+
+  if (!std::isfinite(weather.degree) || !std::isfinite(weather.humidity) || !std::isfinite(weather.pressure)) {
+    return "snapshot has a non-finite number";
+  }
+
+  const char *error = fuzzCheckTerminated(weather);
+  if (error == nullptr) {
+    error = fuzzCheckFormat(weather);
+  }
+
+  return error ? error : fuzzCheckRoundTrip(weather);
+}
+
+// ThingSpeakのfeeds.json
+// 応答はThingSpeakライブラリが読むので、ATOMDoc::requestThingSpeak()が受け取る
+// field1..3(String::toFloat)とcreated_at(Scheduler::parseUtc)を同じように扱う
+inline const char *fuzzThingSpeak(const uint8_t *data, size_t size) {
+  DynamicJsonDocument doc(FUZZ_VIEW_CAPACITY);
+  WeatherSnapshot     weather;
+
+  clearSnapshot(weather);
+
+  if (deserializeJson(doc, (const char *)data, size, DeserializationOption::NestingLimit(VIEW_DOC_NESTING))) {
+    return nullptr;
+  }
+
+  JsonArray feeds = doc["feeds"];
+
+  for (JsonObject feed : feeds) {
+    time_t entry = Scheduler::parseUtc(feed["created_at"]);
+
+    // 読めない時は0。それ以外は2038年までのepoch
+    if (entry < 0 || entry > (time_t)INT32_MAX) {
+      return "created_at is out of range";
+    }
+
+    float      *numbers[] = {&weather.degree, &weather.humidity, &weather.pressure};
+    const char *fields[]  = {feed["field1"], feed["field2"], feed["field3"]};
+
+    for (int i = 0; i < 3; i++) {
+      float value = fields[i] ? (float)atof(fields[i]) : 0.0f;
+      if (std::isfinite(value)) {
+        *numbers[i] = value;
+      }
+    }
+
+    clampSnapshot(weather);
+
+    const char *error = fuzzCheckFormat(weather);
+    if (error) {
+      return error;
+    }
+  }
+
+  return nullptr;
+}
+
+inline const char *fuzzWeather(const uint8_t *data, size_t size) {
+  const char *error = fuzzJmaForecast(data, size);
+
+  if (error == nullptr) {
+    error = fuzzDocSnapshot(data, size);
+  }
+
+  if (error == nullptr) {
+    error = fuzzThingSpeak(data, size);
+  }
+
+  return error;
+}
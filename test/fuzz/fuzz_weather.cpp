@@ -0,0 +1,52 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// libFuzzerで、気象庁・ThingSpeak・ATOM DocのJSONを読む処理を調べる
+// ArduinoJson 6を取ってきて、ホストのclangでビルドする
+//
+//   clang++ -std=gnu++17 -g -O1 -fsanitize=fuzzer,address,undefined
+//           -I include -I src -I test/host -I <ArduinoJson>/src
+//           -D ARDUINOJSON_ENABLE_ARDUINO_STRING=1 -D ARDUINOJSON_ENABLE_ARDUINO_STREAM=0
+//           -D ARDUINOJSON_ENABLE_ARDUINO_PRINT=0 -D ARDUINOJSON_ENABLE_PROGMEM=0
+//           test/fuzz/fuzz_weather.cpp -o fuzz_weather
+//   ./fuzz_weather -max_len=65536 corpus test/corpus/jma test/corpus/thingspeak test/corpus/doc
+//
+// 見つかった入力は test/corpus の該当するディレクトリに加えると、pio test -e native で再生される
+
+#include "WeatherFuzz.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  const char *error = fuzzWeather(data, size);
+
+  if (error) {
+    fprintf(stderr, "%s\n", error);
+    abort();
+  }
+
+  return 0;
+}
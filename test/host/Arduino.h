@@ -0,0 +1,255 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <string>
+
+#include <sys/time.h>
+
+// ホストでテストするための最小限のArduino互換層
+// String、Stream、時刻、タスク通知、コア、クロック、乱数、ログだけを用意する。時刻はテストから進める
+
+#define portNUM_PROCESSORS 2
+
+// newlibにあってglibcには無いことがある
+inline size_t hostStrlcpy(char *dst, const char *src, size_t size) {
+  size_t length = strlen(src);
+
+  if (size) {
+    size_t copy = length < size - 1 ? length : size - 1;
+    memcpy(dst, src, copy);
+    dst[copy] = '\0';
+  }
+
+  return length;
+}
+
+#define strlcpy hostStrlcpy
+
+class String {
+ public:
+  String(void) {}
+  String(const char *text) : _text(text ? text : "") {}
+  String(const std::string &text) : _text(text) {}
+  explicit String(char c) : _text(1, c) {}
+  explicit String(int value) : _text(std::to_string(value)) {}
+  explicit String(unsigned int value) : _text(std::to_string(value)) {}
+  explicit String(long value) : _text(std::to_string(value)) {}
+  explicit String(unsigned long value) : _text(std::to_string(value)) {}
+
+  const char *c_str(void) const { return _text.c_str(); }
+  unsigned int length(void) const { return _text.length(); }
+  bool isEmpty(void) const { return _text.empty(); }
+  void reserve(unsigned int size) { _text.reserve(size); }
+  char operator[](unsigned int index) const { return index < _text.length() ? _text[index] : '\0'; }
+
+  bool concat(const char *text) {
+    _text += text ? text : "";
+    return true;
+  }
+  bool concat(const char *text, unsigned int length) {
+    _text.append(text, length);
+    return true;
+  }
+  bool concat(char c) {
+    _text += c;
+    return true;
+  }
+  bool concat(const String &text) { return concat(text.c_str(), text.length()); }
+
+  String &operator+=(const char *text) { concat(text); return *this; }
+  String &operator+=(const String &text) { concat(text); return *this; }
+  String &operator+=(char c) { concat(c); return *this; }
+
+  bool operator==(const String &other) const { return _text == other._text; }
+  bool operator==(const char *other) const { return _text == (other ? other : ""); }
+  bool operator!=(const String &other) const { return !(*this == other); }
+  bool operator!=(const char *other) const { return !(*this == other); }
+
+  int indexOf(const char *text, unsigned int from = 0) const {
+    size_t index = _text.find(text, from);
+    return index == std::string::npos ? -1 : (int)index;
+  }
+  bool startsWith(const char *text) const { return _text.compare(0, strlen(text), text) == 0; }
+  bool endsWith(const char *text) const {
+    size_t size = strlen(text);
+    return _text.size() >= size && _text.compare(_text.size() - size, size, text) == 0;
+  }
+  String substring(unsigned int begin, unsigned int end) const { return String(_text.substr(begin, end - begin)); }
+
+  void replace(const char *find, const char *replace) {
+    size_t size = strlen(find);
+    for (size_t index = _text.find(find); size && index != std::string::npos; index = _text.find(find, index)) {
+      _text.replace(index, size, replace);
+      index += strlen(replace);
+    }
+  }
+
+ private:
+  std::string _text;
+};
+
+inline String operator+(const String &a, const String &b) {
+  String result(a);
+  result += b;
+  return result;
+}
+
+inline String operator+(const String &a, const char *b) {
+  String result(a);
+  result += b;
+  return result;
+}
+
+inline String operator+(const char *a, const String &b) {
+  String result(a);
+  result += b;
+  return result;
+}
+
+// PrintとStreamは、読み出しに使うところだけ
+class Print {
+ public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t data) = 0;
+  virtual size_t write(const uint8_t *buf, size_t size) {
+    size_t length = 0;
+    while (size--) {
+      length += write(*buf++);
+    }
+    return length;
+  }
+};
+
+class Stream : public Print {
+ public:
+  virtual int  available(void) = 0;
+  virtual int  read(void)      = 0;
+  virtual int  peek(void)      = 0;
+  virtual void flush(void) {}
+
+  // ホストでは待たない。届いていなければそこで終わる
+  size_t readBytes(char *buffer, size_t length) {
+    size_t count = 0;
+    int    data;
+    while (count < length && (data = read()) >= 0) {
+      buffer[count++] = (char)data;
+    }
+    return count;
+  }
+};
+
+// テストから進める時計 [us]
+inline uint64_t hostMicros = 0;
+
+inline void hostAdvanceMillis(uint32_t ms) {
+  hostMicros += (uint64_t)ms * 1000;
+}
+
+inline uint32_t millis(void) {
+  return (uint32_t)(hostMicros / 1000);
+}
+
+inline uint32_t micros(void) {
+  return (uint32_t)hostMicros;
+}
+
+// 壁時計とhostMicrosの差 [us]。NTPで合わせるまでは起動からの時間になる
+inline int64_t hostEpochUs = 0;
+
+inline void hostSetTime(time_t now) {
+  hostEpochUs = ((int64_t)now - (int64_t)(hostMicros / 1000000)) * 1000000;
+}
+
+// 秒の途中から始める時に使う
+inline void hostSetTimeOfDay(time_t now, long usec) {
+  hostEpochUs = (int64_t)now * 1000000 + usec - (int64_t)hostMicros;
+}
+
+inline time_t hostTime(time_t *now) {
+  time_t result = (time_t)((hostEpochUs + (int64_t)hostMicros) / 1000000);
+  if (now) {
+    *now = result;
+  }
+  return result;
+}
+
+inline int hostGettimeofday(struct timeval *tv, void *tz) {
+  int64_t now = hostEpochUs + (int64_t)hostMicros;
+
+  tv->tv_sec  = (time_t)(now / 1000000);
+  tv->tv_usec = (suseconds_t)(now % 1000000);
+  return 0;
+}
+
+#define time(now) hostTime(now)
+#define gettimeofday(tv, tz) hostGettimeofday(tv, tz)
+
+// タスク通知は回数だけ数える
+typedef void *TaskHandle_t;
+
+inline uint32_t hostNotified = 0;
+
+inline TaskHandle_t xTaskGetCurrentTaskHandle(void) {
+  return &hostNotified;
+}
+
+inline void xTaskNotifyGive(TaskHandle_t task) {
+  (*(uint32_t *)task)++;
+}
+
+inline uint32_t esp_random(void) {
+  return ((uint32_t)rand() << 16) ^ (uint32_t)rand();
+}
+
+// テストから切り替える、呼んだタスクのコア
+inline int hostCoreId = 0;
+
+inline int xPortGetCoreID(void) {
+  return hostCoreId;
+}
+
+inline uint32_t hostCpuMHz = 240;
+
+inline bool setCpuFrequencyMhz(uint32_t mhz) {
+  hostCpuMHz = mhz;
+  return true;
+}
+
+inline uint32_t getCpuFrequencyMhz(void) {
+  return hostCpuMHz;
+}
+
+#define log_e(format, ...) fprintf(stderr, "[E] " format "\n", ##__VA_ARGS__)
+#define log_w(format, ...) fprintf(stderr, "[W] " format "\n", ##__VA_ARGS__)
+#define log_i(format, ...)
+#define log_d(format, ...)
+#define log_v(format, ...)
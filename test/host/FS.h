@@ -0,0 +1,74 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <cstdio>
+#include <memory>
+
+// SPIFFSのFileの代わり。ホストのファイルを読み書きする
+// 本物と同じく、コピーしても同じファイルを指す
+class File : public Stream {
+ public:
+  File(void) {}
+  explicit File(FILE *file) : _file(file, fclose) {}
+
+  int available(void) {
+    if (!_file) {
+      return 0;
+    }
+
+    long position = ftell(_file.get());
+    fseek(_file.get(), 0, SEEK_END);
+    long size = ftell(_file.get());
+    fseek(_file.get(), position, SEEK_SET);
+
+    return (int)(size - position);
+  }
+
+  int read(void) {
+    return _file ? fgetc(_file.get()) : -1;
+  }
+
+  size_t read(uint8_t *buf, size_t size) {
+    return _file ? fread(buf, 1, size, _file.get()) : 0;
+  }
+
+  int peek(void) {
+    if (!_file) {
+      return -1;
+    }
+
+    int data = fgetc(_file.get());
+    if (data >= 0) {
+      ungetc(data, _file.get());
+    }
+    return data;
+  }
+
+  size_t write(uint8_t data) {
+    return write(&data, 1);
+  }
+
+  size_t write(const uint8_t *buf, size_t size) {
+    return _file ? fwrite(buf, 1, size, _file.get()) : 0;
+  }
+
+  size_t position(void) {
+    return _file ? (size_t)ftell(_file.get()) : 0;
+  }
+
+  bool seek(size_t position) {
+    return _file && fseek(_file.get(), (long)position, SEEK_SET) == 0;
+  }
+
+  void close(void) {
+    _file.reset();
+  }
+
+  operator bool(void) const {
+    return (bool)_file;
+  }
+
+ private:
+  std::shared_ptr<FILE> _file;
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <map>
+#include <string>
+
+// NVSの代わり。プロセスが終わるまで残るので、再起動をまたいだ値を試せる
+inline std::map<std::string, std::map<std::string, uint32_t>> hostNvs;
+
+class Preferences {
+ public:
+  bool begin(const char *name, bool readOnly = false) {
+    _name     = name;
+    _readOnly = readOnly;
+    return true;
+  }
+
+  void end(void) {
+  }
+
+  uint32_t getUInt(const char *key, uint32_t defaultValue = 0) {
+    auto &space = hostNvs[_name];
+    auto  value = space.find(key);
+    return value == space.end() ? defaultValue : value->second;
+  }
+
+  size_t putUInt(const char *key, uint32_t value) {
+    if (_readOnly) {
+      return 0;
+    }
+
+    hostNvs[_name][key] = value;
+    return sizeof(value);
+  }
+
+ private:
+  std::string _name;
+  bool        _readOnly = false;
+};
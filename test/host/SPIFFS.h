@@ -0,0 +1,22 @@
+#pragma once
+
+#include <FS.h>
+
+#include <string>
+
+// SPIFFSの代わり。"/name"をhostFsRootの下のファイルとして開く
+inline std::string hostFsRoot = ".";
+
+class HostFS {
+ public:
+  File open(const char *path, const char *mode = "r") {
+    std::string name = hostFsRoot + path;
+    return File(fopen(name.c_str(), mode[0] == 'w' ? "wb" : "rb"));
+  }
+
+  bool exists(const char *path) {
+    return (bool)open(path);
+  }
+};
+
+inline HostFS SPIFFS;
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include <algorithm>
+#include <vector>
+
+// esp_timerの代わり。hostRunTicker()が時計を期限まで進めて呼ぶ
+class Ticker {
+ public:
+  typedef void (*callback_t)(void);
+
+  Ticker(void) : _callback(nullptr),
+                 _due(0) {
+    list().push_back(this);
+  }
+
+  ~Ticker(void) {
+    list().erase(std::remove(list().begin(), list().end(), this), list().end());
+  }
+
+  void once_ms(uint32_t milliseconds, callback_t callback) {
+    _callback = callback;
+    _due      = hostMicros + (uint64_t)milliseconds * 1000;
+  }
+
+  void detach(void) {
+    _callback = nullptr;
+  }
+
+  bool active(void) {
+    return _callback != nullptr;
+  }
+
+  static std::vector<Ticker *> &list(void) {
+    static std::vector<Ticker *> tickers;
+    return tickers;
+  }
+
+  callback_t _callback;
+  uint64_t   _due;
+};
+
+// 一番早い期限まで時計を進めて呼ぶ。待っているものが無ければfalse
+inline bool hostRunTicker(void) {
+  Ticker *next = nullptr;
+
+  for (Ticker *ticker : Ticker::list()) {
+    if (ticker->_callback && (!next || ticker->_due < next->_due)) {
+      next = ticker;
+    }
+  }
+
+  if (!next) {
+    return false;
+  }
+
+  if (hostMicros < next->_due) {
+    hostMicros = next->_due;
+  }
+
+  Ticker::callback_t callback = next->_callback;
+  next->_callback             = nullptr;
+  callback();
+
+  return true;
+}
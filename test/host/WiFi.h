@@ -0,0 +1,16 @@
+#pragma once
+
+#include <Arduino.h>
+
+// モデムスリープの状態だけを覚える
+class WiFiClass {
+ public:
+  bool setSleep(bool enable) {
+    sleep = enable;
+    return true;
+  }
+
+  bool sleep = false;
+};
+
+inline WiFiClass WiFi;
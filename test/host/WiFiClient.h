@@ -0,0 +1,61 @@
+#pragma once
+
+#include <Arduino.h>
+
+// WiFiClientの代わり。接続はできず、何も受信しない
+// ReplayClientのように、これを継承して受信するものを差し替える
+class IPAddress {};
+
+class WiFiClient : public Stream {
+ public:
+  virtual int connect(IPAddress ip, uint16_t port) {
+    return 0;
+  }
+
+  virtual int connect(const char *host, uint16_t port) {
+    return 0;
+  }
+
+  virtual int connect(IPAddress ip, uint16_t port, int32_t timeout) {
+    return 0;
+  }
+
+  virtual int connect(const char *host, uint16_t port, int32_t timeout) {
+    return 0;
+  }
+
+  size_t write(uint8_t data) {
+    return 0;
+  }
+
+  size_t write(const uint8_t *buf, size_t size) {
+    return 0;
+  }
+
+  int available(void) {
+    return 0;
+  }
+
+  int read(void) {
+    return -1;
+  }
+
+  virtual int read(uint8_t *buf, size_t size) {
+    return -1;
+  }
+
+  int peek(void) {
+    return -1;
+  }
+
+  virtual void stop(void) {
+  }
+
+  virtual uint8_t connected(void) {
+    return 0;
+  }
+
+  virtual operator bool(void) {
+    return false;
+  }
+};
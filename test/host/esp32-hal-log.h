@@ -0,0 +1,4 @@
+#pragma once
+
+// ログはArduino.hで定義する
+#include <Arduino.h>
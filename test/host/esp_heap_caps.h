@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+
+#define MALLOC_CAP_INTERNAL (1 << 11)
+
+// テストから変えられるヒープの状態
+inline size_t hostFreeHeap     = 200 * 1024;
+inline size_t hostLargestBlock = 100 * 1024;
+
+inline size_t heap_caps_get_free_size(unsigned int caps) {
+  return hostFreeHeap;
+}
+
+inline size_t heap_caps_get_largest_free_block(unsigned int caps) {
+  return hostLargestBlock;
+}
+
+inline size_t heap_caps_get_minimum_free_size(unsigned int caps) {
+  return hostFreeHeap;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <Arduino.h>
+
+// hostMicrosは一周しない
+inline int64_t esp_timer_get_time(void) {
+  return (int64_t)hostMicros;
+}
@@ -0,0 +1,4 @@
+#pragma once
+
+// タスク通知と同じく、Arduino.hにまとめてある
+#include <Arduino.h>
@@ -0,0 +1,10 @@
+#pragma once
+
+#include <freertos/FreeRTOS.h>
+
+#include <thread>
+
+// ホストでは1 tick = 1 msとして、そのスレッドだけを止める
+inline void vTaskDelay(uint32_t ticks) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
@@ -0,0 +1,321 @@
+/*
+MIT License
+
+Copyright (c) 2021-2022 riraosan.github.io
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+
+// ATOM Docのweather.jsonを、ホストのソケットで動かす。tools/loadgen.pyの相手にする
+// 本物と同じWeatherApiを、同期のWebServerと同じく1つずつ処理する
+// ArduinoJson 6を取ってきて、ホストのコンパイラでビルドする
+//
+//   g++ -std=gnu++17 -O2
+//       -I include -I src -I test/host -I <ArduinoJson>/src
+//       -D ARDUINOJSON_ENABLE_ARDUINO_STRING=1 -D ARDUINOJSON_ENABLE_ARDUINO_STREAM=0
+//       -D ARDUINOJSON_ENABLE_ARDUINO_PRINT=0 -D ARDUINOJSON_ENABLE_PROGMEM=0
+//       test/loadgen/doc_api_server.cpp -o doc_api_server
+//   ./doc_api_server --port 8080 --service-ms 20
+//   python3 tools/loadgen.py --host 127.0.0.1 --port 8080 --views 60 --spread-sources
+//
+//   --backlog    listen()の待ち行列。ESP32のWiFiServerと同じ4
+//   --service-ms 1件ごとに止める時間。ESP32で応答を送り終えるまでの時間の代わり
+//   --publish-s  天気を更新する間隔。差分と作り直しを起こす
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WeatherApi.hpp>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+
+static volatile sig_atomic_t stopping = 0;
+
+static void onSignal(int) {
+  stopping = 1;
+}
+
+// hostMicrosを実際の時刻に合わせる。RateLimiterはmillis()で数える
+static void syncClock(void) {
+  static const auto start = std::chrono::steady_clock::now();
+  hostMicros              = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// WebServerの代わり。1つの接続で1つの要求を受け、応答したら閉じる
+class HostServer {
+ public:
+  struct Client {
+    uint32_t ip;
+
+    uint32_t remoteIP(void) const {
+      return ip;
+    }
+  };
+
+  HostServer(int socket, uint32_t ip) : _socket(socket),
+                                        _ip(ip) {
+  }
+
+  // 要求の行とヘッダを読む。本文は無いものとする
+  bool receive(void) {
+    std::string request;
+    char        buffer[512];
+
+    while (request.find("\r\n\r\n") == std::string::npos) {
+      ssize_t size = recv(_socket, buffer, sizeof(buffer), 0);
+      if (size <= 0 || request.size() + size > 4096) {
+        return false;
+      }
+      request.append(buffer, size);
+    }
+
+    size_t end  = request.find("\r\n");
+    size_t from = request.find(' ');
+    size_t to   = request.find(' ', from + 1);
+    if (from == std::string::npos || to == std::string::npos || to > end) {
+      return false;
+    }
+
+    std::string uri   = request.substr(from + 1, to - from - 1);
+    size_t      query = uri.find('?');
+
+    path = uri.substr(0, query);
+
+    if (query != std::string::npos) {
+      _parseQuery(uri.substr(query + 1));
+    }
+
+    for (size_t line = end + 2, next; (next = request.find("\r\n", line)) != line; line = next + 2) {
+      size_t colon = request.find(':', line);
+      if (colon == std::string::npos || colon > next) {
+        continue;
+      }
+
+      size_t value = request.find_first_not_of(' ', colon + 1);
+      _headers[request.substr(line, colon - line)] = request.substr(value, next - value);
+    }
+
+    return true;
+  }
+
+  Client client(void) {
+    return Client{_ip};
+  }
+
+  bool hasArg(const char *name) {
+    return _args.count(name) != 0;
+  }
+
+  String arg(const char *name) {
+    return hasArg(name) ? String(_args[name]) : String();
+  }
+
+  String header(const char *name) {
+    return _headers.count(name) ? String(_headers[name]) : String();
+  }
+
+  void sendHeader(const String &name, const String &value) {
+    _sendHeaders += std::string(name.c_str()) + ": " + value.c_str() + "\r\n";
+  }
+
+  void send(int code) {
+    _send(code, nullptr, "");
+  }
+
+  void send(int code, const char *type, const String &content) {
+    _send(code, type, content);
+  }
+
+  std::string path;
+
+ private:
+  void _parseQuery(const std::string &query) {
+    for (size_t from = 0; from <= query.size();) {
+      size_t to = query.find('&', from);
+      if (to == std::string::npos) {
+        to = query.size();
+      }
+
+      std::string pair  = query.substr(from, to - from);
+      size_t      equal = pair.find('=');
+      if (equal != std::string::npos) {
+        _args[pair.substr(0, equal)] = pair.substr(equal + 1);
+      }
+
+      from = to + 1;
+    }
+  }
+
+  void _send(int code, const char *type, const String &content) {
+    const char *reason = code == 200   ? "OK"
+                         : code == 304 ? "Not Modified"
+                         : code == 404 ? "Not Found"
+                         : code == 429 ? "Too Many Requests"
+                         : code == 503 ? "Service Unavailable"
+                                       : "";
+
+    char status[64];
+    snprintf(status, sizeof(status), "HTTP/1.1 %d %s\r\n", code, reason);
+
+    std::string response(status);
+    response += _sendHeaders;
+    if (type) {
+      response += std::string("Content-Type: ") + type + "\r\n";
+    }
+    response += "Content-Length: " + std::to_string(content.length()) + "\r\n";
+    response += "Connection: close\r\n\r\n";
+    response.append(content.c_str(), content.length());
+
+    for (size_t sent = 0; sent < response.size();) {
+      ssize_t size = ::send(_socket, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+      if (size <= 0) {
+        break;
+      }
+      sent += size;
+    }
+  }
+
+  int                                _socket;
+  uint32_t                           _ip;
+  std::map<std::string, std::string> _args;
+  std::map<std::string, std::string> _headers;
+  std::string                        _sendHeaders;
+};
+
+static void makeWeather(WeatherSnapshot &weather, uint32_t count) {
+  clearSnapshot(weather);
+  strlcpy(weather.publishingOffice, "大阪管区気象台", sizeof(weather.publishingOffice));
+  strlcpy(weather.reportDatetime, "2022-01-01T11:00:00+09:00", sizeof(weather.reportDatetime));
+  strlcpy(weather.area, "大阪府", sizeof(weather.area));
+  strlcpy(weather.weatherCodes, "201", sizeof(weather.weatherCodes));
+  strlcpy(weather.weathersJP, "曇時々晴", sizeof(weather.weathersJP));
+  strlcpy(weather.weathersEN, "MOSTLY CLOUDY", sizeof(weather.weathersEN));
+  strlcpy(weather.iconFile, "/201.gif", sizeof(weather.iconFile));
+  weather.degree   = 20.0f + (count % 10) * 0.1f;
+  weather.humidity = 55.0f;
+  weather.pressure = 1013.0f;
+}
+
+int main(int argc, char **argv) {
+  int      port      = 8080;
+  int      backlog   = 4;
+  uint32_t serviceMs = 0;
+  uint32_t publishS  = 0;
+
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--port")) {
+      port = atoi(argv[i + 1]);
+    } else if (!strcmp(argv[i], "--backlog")) {
+      backlog = atoi(argv[i + 1]);
+    } else if (!strcmp(argv[i], "--service-ms")) {
+      serviceMs = strtoul(argv[i + 1], nullptr, 10);
+    } else if (!strcmp(argv[i], "--publish-s")) {
+      publishS = strtoul(argv[i + 1], nullptr, 10);
+    }
+  }
+
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  int reuse    = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+  sockaddr_in address = {};
+  address.sin_family      = AF_INET;
+  address.sin_port        = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+  if (bind(listener, (sockaddr *)&address, sizeof(address)) || listen(listener, backlog)) {
+    perror("listen");
+    return 1;
+  }
+
+  // accept()から抜けるように、SA_RESTARTを付けない
+  struct sigaction action = {};
+  action.sa_handler       = onSignal;
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+
+  syncClock();
+
+  WeatherApi      api((esp_random() & 0xFFFF) << 16);
+  WeatherSnapshot weather;
+  uint32_t        published = 0;
+  uint32_t        updatedAt = millis();
+
+  makeWeather(weather, published++);
+  api.publish(weather);
+
+  printf("listening on 127.0.0.1:%d. backlog %d, service %u ms\n", port, backlog, serviceMs);
+  fflush(stdout);
+
+  while (!stopping) {
+    sockaddr_in peer = {};
+    socklen_t   size = sizeof(peer);
+    int         sock = accept(listener, (sockaddr *)&peer, &size);
+
+    if (sock < 0) {
+      continue;
+    }
+
+    timeval timeout = {1, 0};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    syncClock();
+
+    if (publishS && millis() - updatedAt >= publishS * 1000) {
+      makeWeather(weather, published++);
+      api.publish(weather);
+      updatedAt = millis();
+    }
+
+    // IPAddressと同じく、ネットワークバイトオーダーのまま
+    HostServer server(sock, peer.sin_addr.s_addr);
+
+    if (server.receive()) {
+      if (server.path == "/api/v1/weather.json") {
+        api.serve(server);
+      } else if (server.path == "/api/v1/limits.json") {
+        server.send(200, "application/json", api.stats());
+      } else {
+        server.send(404, "text/plain", "not found");
+      }
+
+      if (serviceMs) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(serviceMs));
+      }
+    }
+
+    close(sock);
+  }
+
+  printf("%s\n", api.stats().c_str());
+  close(listener);
+  return 0;
+}
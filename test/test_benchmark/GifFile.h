@@ -0,0 +1,278 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// ベンチマークでアイコンのラインを作るための、最小限のGIFの読み込み
+// AnimatedGIFが_GIFDrawへ渡すのと同じ、パレットのインデックスのラインを作る
+
+struct GifFrame {
+  int                  x;
+  int                  y;
+  int                  width;
+  int                  height;
+  bool                 hasTransparency;
+  uint8_t              transparent;
+  uint8_t              disposal;
+  std::vector<uint8_t> pixels;  // width * height。上の行から順に並べる
+};
+
+class GifFile {
+ public:
+  bool load(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+      return false;
+    }
+
+    _data.clear();
+    uint8_t buffer[512];
+    size_t  size;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      _data.insert(_data.end(), buffer, buffer + size);
+    }
+    fclose(file);
+
+    return _parse();
+  }
+
+  int width(void) const {
+    return _width;
+  }
+
+  int height(void) const {
+    return _height;
+  }
+
+  const std::vector<GifFrame> &frames(void) const {
+    return _frames;
+  }
+
+ private:
+  bool _parse(void) {
+    _pos = 0;
+    _frames.clear();
+
+    if (_data.size() < 13 || (memcmp(&_data[0], "GIF87a", 6) && memcmp(&_data[0], "GIF89a", 6))) {
+      return false;
+    }
+
+    _pos    = 6;
+    _width  = _u16();
+    _height = _u16();
+
+    uint8_t flags = _u8();
+    _pos += 2;  // 背景色、アスペクト比
+
+    if (flags & 0x80) {
+      _pos += 3 * (2 << (flags & 7));
+    }
+
+    GifFrame control = {};
+
+    while (_pos < _data.size()) {
+      uint8_t block = _u8();
+
+      if (block == 0x3B) {
+        break;
+      } else if (block == 0x21) {
+        uint8_t label = _u8();
+        if (label == 0xF9 && _pos + 5 < _data.size()) {
+          _pos++;  // 4
+          uint8_t packed          = _u8();
+          control.disposal        = (packed >> 2) & 7;
+          control.hasTransparency = packed & 1;
+          _pos += 2;  // 遅延時間
+          control.transparent = _u8();
+        }
+        _skipBlocks();
+      } else if (block == 0x2C) {
+        GifFrame frame = control;
+        frame.x        = _u16();
+        frame.y        = _u16();
+        frame.width    = _u16();
+        frame.height   = _u16();
+
+        flags = _u8();
+        if (flags & 0x80) {
+          _pos += 3 * (2 << (flags & 7));
+        }
+
+        if (!_decode(frame)) {
+          return false;
+        }
+
+        if (flags & 0x40) {
+          _deinterlace(frame);
+        }
+
+        _frames.push_back(frame);
+        control = GifFrame();
+      } else {
+        return false;
+      }
+    }
+
+    return !_frames.empty();
+  }
+
+  uint8_t _u8(void) {
+    return _pos < _data.size() ? _data[_pos++] : 0;
+  }
+
+  uint16_t _u16(void) {
+    uint16_t low = _u8();
+    return low | (_u8() << 8);
+  }
+
+  void _skipBlocks(void) {
+    while (_pos < _data.size()) {
+      uint8_t size = _u8();
+      if (size == 0) {
+        break;
+      }
+      _pos += size;
+    }
+  }
+
+  // LZWの符号を展開する
+  bool _decode(GifFrame &frame) {
+    int minimum = _u8();
+    if (minimum < 2 || minimum > 11) {
+      return false;
+    }
+
+    std::vector<uint8_t> codes;
+    while (_pos < _data.size()) {
+      uint8_t size = _u8();
+      if (size == 0) {
+        break;
+      }
+      if (_pos + size > _data.size()) {
+        return false;
+      }
+      codes.insert(codes.end(), _data.begin() + _pos, _data.begin() + _pos + size);
+      _pos += size;
+    }
+
+    const int clear = 1 << minimum;
+    const int end   = clear + 1;
+
+    std::vector<uint16_t> prefix(4096);
+    std::vector<uint8_t>  suffix(4096);
+    std::vector<uint8_t>  stack(4097);
+
+    for (int i = 0; i < clear; i++) {
+      prefix[i] = 0xFFFF;
+      suffix[i] = i;
+    }
+
+    size_t   total = (size_t)frame.width * frame.height;
+    int      bits  = minimum + 1;
+    int      next  = end + 1;
+    int      old   = -1;
+    uint8_t  first = 0;
+    uint32_t data  = 0;
+    int      count = 0;
+
+    frame.pixels.clear();
+    frame.pixels.reserve(total);
+
+    for (size_t i = 0; i < codes.size() && frame.pixels.size() < total;) {
+      while (count < bits && i < codes.size()) {
+        data |= (uint32_t)codes[i++] << count;
+        count += 8;
+      }
+      if (count < bits) {
+        break;
+      }
+
+      int code = data & ((1 << bits) - 1);
+      data >>= bits;
+      count -= bits;
+
+      if (code == clear) {
+        bits = minimum + 1;
+        next = end + 1;
+        old  = -1;
+        continue;
+      }
+      if (code == end) {
+        break;
+      }
+
+      if (old < 0) {
+        if (code >= clear) {
+          return false;
+        }
+        first = code;
+        frame.pixels.push_back(first);
+        old = code;
+        continue;
+      }
+
+      int top = 0;
+      int in  = code;
+
+      if (code >= next) {
+        if (code > next) {
+          return false;
+        }
+        stack[top++] = first;
+        code         = old;
+      }
+
+      while (code >= clear) {
+        stack[top++] = suffix[code];
+        code         = prefix[code];
+      }
+      first        = code;
+      stack[top++] = first;
+
+      while (top > 0 && frame.pixels.size() < total) {
+        frame.pixels.push_back(stack[--top]);
+      }
+
+      if (next < 4096) {
+        prefix[next] = old;
+        suffix[next] = first;
+        next++;
+        if (next == (1 << bits) && bits < 12) {
+          bits++;
+        }
+      }
+      old = in;
+    }
+
+    // 途中で切れていても、残りは透明(無ければ0)で埋める
+    frame.pixels.resize(total, frame.transparent);
+    return true;
+  }
+
+  // インターレースの4回の走査を、上からの順に並べ直す
+  static void _deinterlace(GifFrame &frame) {
+    static const int start[] = {0, 4, 2, 1};
+    static const int step[]  = {8, 8, 4, 2};
+
+    std::vector<uint8_t> pixels(frame.pixels.size());
+    const uint8_t       *s = frame.pixels.data();
+
+    for (int pass = 0; pass < 4; pass++) {
+      for (int y = start[pass]; y < frame.height; y += step[pass]) {
+        memcpy(&pixels[(size_t)y * frame.width], s, frame.width);
+        s += frame.width;
+      }
+    }
+
+    frame.pixels.swap(pixels);
+  }
+
+  std::vector<uint8_t>  _data;
+  size_t                _pos    = 0;
+  int                   _width  = 0;
+  int                   _height = 0;
+  std::vector<GifFrame> _frames;
+};
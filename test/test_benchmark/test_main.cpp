@@ -0,0 +1,353 @@
+#include <Benchmark.h>
+#include <BenchmarkCases.hpp>
+#include <GifBlit.h>
+#include <Layout.h>
+#include <unity.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "GifFile.h"
+
+// env:native_benchmarkで動かす。実機のenv:benchmarkと同じ形のJSONを出す
+// ホストの数字なので、実機と比べられるのは同じケースの相対的な変化だけ
+
+static const int WIDTH  = DisplayLayout::animation().w;
+static const int HEIGHT = DisplayLayout::animation().h;
+
+static std::mt19937 engine(20220506);
+
+static std::vector<uint8_t> frame(WIDTH *HEIGHT);
+static std::vector<uint8_t> canvas(WIDTH *HEIGHT);
+static uint16_t             palette[256];  // リトルエンディアンのRGB565
+static uint16_t             swapped[256];  // 以前のデコーダが渡していたビッグエンディアン
+static uint8_t              lut[256];
+
+static uint16_t swap16(uint16_t value) {
+  return (uint16_t)((value << 8) | (value >> 8));
+}
+
+// 以前の_GIFDraw。16bitのラインを作り、pushPixels(swap = true)で8bitのスプライトへ書いていた
+// setWindow/pushPixelsの呼び出しの分は含まないので、以前の処理を少なめに見積もる
+static void blitLine565(uint8_t *d, const uint8_t *s, int width, const uint16_t *usPalette) {
+  uint16_t usTemp[240];
+
+  for (int x = 0; x < width; x++) {
+    usTemp[x] = usPalette[s[x]];
+  }
+
+  // pushPixelsの中の変換
+  for (int x = 0; x < width; x++) {
+    d[x] = rgb332(swap16(usTemp[x]));
+  }
+}
+
+static void drawFrame565(void) {
+  for (int y = 0; y < HEIGHT; y++) {
+    blitLine565(&canvas[y * WIDTH], &frame[y * WIDTH], WIDTH, swapped);
+  }
+}
+
+// 今の_GIFDraw。パレットはフレームごとに一度だけ変換する
+static void drawFrame332(void) {
+  for (int i = 0; i < 256; i++) {
+    lut[i] = rgb332(palette[i]);
+  }
+
+  for (int y = 0; y < HEIGHT; y++) {
+    gifBlitOpaque(&canvas[y * WIDTH], &frame[y * WIDTH], WIDTH, lut);
+  }
+}
+
+// アイコンはdata/(SPIFFSに書き込むディレクトリ)から読む。ATOM_ICON_DIRで別の場所を指せる
+static std::string dataDir(void) {
+  std::string path(__FILE__);
+  path.erase(path.find_last_of('/') + 1);
+  return path + "../../data";
+}
+
+static std::string iconDir(void) {
+  const char *dir = getenv("ATOM_ICON_DIR");
+  return dir ? dir : dataDir();
+}
+
+static std::string readCodes(void) {
+  std::string text;
+  FILE       *file = fopen((dataDir() + "/codes.json").c_str(), "rb");
+
+  if (file) {
+    char   buffer[512];
+    size_t size;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      text.append(buffer, size);
+    }
+    fclose(file);
+  }
+
+  return text;
+}
+
+// 実機のアセットと同じく、メモリ上のcodes.jsonから引く
+static bool lookupCode(WeatherSnapshot &weather) {
+  static const std::string codes = readCodes();
+  return lookupWeatherCode(weather, codes.c_str(), codes.size());
+}
+
+// codes.jsonが参照するアイコンのファイル名("100.gif"など)
+static std::set<std::string> iconNames(void) {
+  std::set<std::string> names;
+  std::string           text = readCodes();
+
+  for (size_t end = text.find(".gif\""); end != std::string::npos; end = text.find(".gif\"", end + 1)) {
+    size_t begin = text.rfind('"', end);
+    names.insert(text.substr(begin + 1, end + 4 - begin - 1));
+  }
+
+  return names;
+}
+
+struct Icon {
+  std::string          name;
+  GifFile              gif;
+  std::vector<uint8_t> canvas;
+};
+
+static std::vector<Icon> icons;
+static size_t            iconPixels      = 0;
+static size_t            iconTransparent = 0;
+
+static size_t loadIcons(void) {
+  if (!icons.empty()) {
+    return icons.size();
+  }
+
+  for (const auto &name : iconNames()) {
+    Icon icon;
+    icon.name = name;
+    if (!icon.gif.load(iconDir() + "/" + name)) {
+      continue;
+    }
+    icon.canvas.resize((size_t)icon.gif.width() * icon.gif.height());
+
+    for (const auto &frame : icon.gif.frames()) {
+      iconPixels += frame.pixels.size();
+      if (frame.hasTransparency) {
+        iconTransparent += std::count(frame.pixels.begin(), frame.pixels.end(), frame.transparent);
+      }
+    }
+
+    icons.push_back(std::move(icon));
+  }
+
+  return icons.size();
+}
+
+// 以前の_GIFDrawの透明の処理。不透明な区間ごとにsetWindow/pushPixelsを呼んでいた
+__attribute__((noinline)) static void pushRun(uint8_t *d, const uint16_t *usTemp, int count) {
+  for (int x = 0; x < count; x++) {
+    d[x] = rgb332(swap16(usTemp[x]));
+  }
+}
+
+static void blitRuns565(uint8_t *d, const uint8_t *s, int width, uint8_t transparent, const uint16_t *usPalette) {
+  uint16_t usTemp[240];
+
+  for (int x = 0; x < width;) {
+    int count = 0;
+    while (x + count < width && s[x + count] != transparent) {
+      usTemp[count] = usPalette[s[x + count]];
+      count++;
+    }
+    if (count) {
+      pushRun(d + x, usTemp, count);
+      x += count;
+    }
+
+    while (x < width && s[x] == transparent) {
+      x++;
+    }
+  }
+}
+
+// 1画素ずつ調べる、4画素ずつにする前の処理
+static void blitScalar(uint8_t *d, const uint8_t *s, int width, uint8_t transparent, const uint8_t *lut) {
+  for (int x = 0; x < width; x++) {
+    if (s[x] != transparent)
+      d[x] = lut[s[x]];
+  }
+}
+
+enum class BLIT : int {
+  BLIT_RUNS565,
+  BLIT_SCALAR,
+  BLIT_WORD,
+  BLIT_MAX,
+};
+
+// すべてのアイコンのすべてのフレームを、_GIFDrawと同じように1ラインずつ書く
+static void drawIcons(BLIT blit) {
+  for (auto &icon : icons) {
+    int width = icon.gif.width();
+
+    for (const auto &frame : icon.gif.frames()) {
+      for (int y = 0; y < frame.height && frame.y + y < icon.gif.height(); y++) {
+        int iWidth = std::min(frame.width, width - frame.x);
+        if (iWidth <= 0) {
+          break;
+        }
+
+        const uint8_t *s = &frame.pixels[(size_t)y * frame.width];
+        uint8_t       *d = &icon.canvas[(size_t)(frame.y + y) * width + frame.x];
+
+        if (!frame.hasTransparency) {
+          if (blit == BLIT::BLIT_RUNS565) {
+            blitLine565(d, s, iWidth, swapped);
+          } else {
+            gifBlitOpaque(d, s, iWidth, lut);
+          }
+          continue;
+        }
+
+        switch (blit) {
+          case BLIT::BLIT_RUNS565:
+            blitRuns565(d, s, iWidth, frame.transparent, swapped);
+            break;
+          case BLIT::BLIT_SCALAR:
+            blitScalar(d, s, iWidth, frame.transparent, lut);
+            break;
+          default:
+            gifBlitTransparent(d, s, iWidth, frame.transparent, lut);
+            break;
+        }
+      }
+    }
+  }
+}
+
+static std::vector<uint8_t> drawAll(BLIT blit) {
+  std::vector<uint8_t> result;
+
+  for (auto &icon : icons) {
+    std::fill(icon.canvas.begin(), icon.canvas.end(), 0x55);
+  }
+  drawIcons(blit);
+  for (const auto &icon : icons) {
+    result.insert(result.end(), icon.canvas.begin(), icon.canvas.end());
+  }
+
+  return result;
+}
+
+static void requireIcons(void) {
+  if (loadIcons() == 0) {
+    static char message[160];
+    snprintf(message, sizeof(message), "no icon GIFs in %s (codes.json lists %d). set ATOM_ICON_DIR",
+             iconDir().c_str(), (int)iconNames().size());
+    TEST_IGNORE_MESSAGE(message);
+  }
+}
+
+void setUp(void) {
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_int_distribution<int> color(0, 0xFFFF);
+
+  for (int i = 0; i < 256; i++) {
+    palette[i] = color(engine);
+    swapped[i] = swap16(palette[i]);
+    lut[i]     = rgb332(palette[i]);
+  }
+
+  for (auto &pixel : frame) {
+    pixel = byte(engine);
+  }
+}
+
+void tearDown(void) {
+}
+
+// 比べる前に、どちらも同じ画素を書くこと
+void test_byte_path_matches_16bit_path(void) {
+  drawFrame565();
+  std::vector<uint8_t> expected(canvas);
+
+  std::fill(canvas.begin(), canvas.end(), 0);
+  drawFrame332();
+
+  TEST_ASSERT_EQUAL_MEMORY(expected.data(), canvas.data(), canvas.size());
+}
+
+void test_gif_frame_pixels_per_second(void) {
+  size_t pixels = frame.size();
+
+  Benchmark::run("gifFrame/rgb565Line", drawFrame565, BENCHMARK_ITERATIONS, pixels);
+  Benchmark::run("gifFrame/rgb332Lut", drawFrame332, BENCHMARK_ITERATIONS, pixels);
+
+  uint32_t before = Benchmark::median("gifFrame/rgb565Line");
+  uint32_t after  = Benchmark::median("gifFrame/rgb332Lut");
+
+  printf("%dx%d frame: 16-bit line %.1f Mpixel/s, byte path %.1f Mpixel/s\n",
+         WIDTH, HEIGHT,
+         before ? (float)pixels / before : 0.0f,
+         after ? (float)pixels / after : 0.0f);
+}
+
+// 3つの処理が、アイコンのすべてのフレームで同じ画素を書くこと
+void test_icon_blits_match(void) {
+  requireIcons();
+
+  std::vector<uint8_t> expected = drawAll(BLIT::BLIT_RUNS565);
+
+  std::vector<uint8_t> actual = drawAll(BLIT::BLIT_SCALAR);
+  TEST_ASSERT_EQUAL_MEMORY(expected.data(), actual.data(), expected.size());
+
+  actual = drawAll(BLIT::BLIT_WORD);
+  TEST_ASSERT_EQUAL_MEMORY(expected.data(), actual.data(), expected.size());
+}
+
+void test_icon_blits(void) {
+  requireIcons();
+
+  Benchmark::run("gifIcons/runs565", []() { drawIcons(BLIT::BLIT_RUNS565); }, BENCHMARK_ITERATIONS, iconPixels);
+  Benchmark::run("gifIcons/scalar", []() { drawIcons(BLIT::BLIT_SCALAR); }, BENCHMARK_ITERATIONS, iconPixels);
+  Benchmark::run("gifIcons/word", []() { drawIcons(BLIT::BLIT_WORD); }, BENCHMARK_ITERATIONS, iconPixels);
+
+  printf("%d icons from %s, %d pixels, %.0f%% transparent\n",
+         (int)icons.size(), iconDir().c_str(), (int)iconPixels,
+         iconPixels ? 100.0 * iconTransparent / iconPixels : 0.0);
+}
+
+// ATOM Docの取得の後と、ATOM Viewの処理。実機のenv:benchmarkと同じ名前で記録する
+void test_doc_and_view(void) {
+  WeatherSnapshot weather;
+  String          json;
+  clearSnapshot(weather);
+
+  strlcpy(weather.weatherCodes, "101", sizeof(weather.weatherCodes));
+  TEST_ASSERT_TRUE(lookupCode(weather));
+  TEST_ASSERT_EQUAL_STRING("/101.gif", weather.iconFile);
+
+  BenchmarkCases::doc(weather, json, lookupCode);
+  TEST_ASSERT_EQUAL_STRING("大阪管区気象台", weather.publishingOffice);
+  TEST_ASSERT_EQUAL_STRING("晴時々曇", weather.weathersJP);
+  TEST_ASSERT_GREATER_THAN(0, (int)json.length());
+
+  BenchmarkCases::view(json);
+  BenchmarkCases::pipeline(lookupCode);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_doc_and_view);
+  RUN_TEST(test_byte_path_matches_16bit_path);
+  RUN_TEST(test_gif_frame_pixels_per_second);
+  RUN_TEST(test_icon_blits_match);
+  RUN_TEST(test_icon_blits);
+
+  printf("BENCHMARK_BEGIN\n%s\nBENCHMARK_END\n", Benchmark::toJson().c_str());
+
+  return UNITY_END();
+}
@@ -0,0 +1,143 @@
+#include <ClockService.hpp>
+#include <unity.h>
+
+#include <cstdlib>
+
+// 2022-05-06T01:00:00Z = 10:00 JST
+static const time_t MORNING = 1651798800;
+
+// Tickerはミリ秒単位なので、発火は境界から CLOCK_EDGE_MARGIN_MS + 1ms 以内に収まるはず [us]
+static const int TICK_MARGIN_US = (CLOCK_EDGE_MARGIN_MS + 1) * 1000;
+
+// loopTaskが通知を受けてからupdate()を呼ぶまでの遅れ [us]
+static const uint32_t WAKE_LATENCY_US = 500;
+
+struct Skew {
+  int      min;
+  int      max;
+  uint32_t ticks;
+};
+
+void setUp(void) {
+  setenv("TZ", "JST-9", 1);
+  tzset();
+
+  hostAdvanceMillis(1000000);
+  // 秒の途中から始める
+  hostSetTimeOfDay(MORNING, 123456);
+  hostNotified = 0;
+
+  // 失敗したテストはデストラクタを通らないので、残ったTickerを忘れる
+  Ticker::list().clear();
+}
+
+void tearDown(void) {
+}
+
+// 時計を進めながら、発火した時の境界(period [us])からのずれを測る
+static Skew run(ClockService &clock, uint32_t seconds, int64_t period) {
+  Skew     skew = {INT32_MAX, INT32_MIN, 0};
+  uint64_t end  = hostMicros + (uint64_t)seconds * 1000000;
+
+  clock.begin();
+
+  while (true) {
+    TEST_ASSERT_TRUE(hostRunTicker());
+    if (hostMicros > end) {
+      break;
+    }
+
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+
+    int64_t wall   = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    int     offset = (int)(wall % period);
+
+    // 境界の直前に発火すると、境界のすぐ後ではなく、ほぼ1周期分のずれになる
+    skew.min = offset < skew.min ? offset : skew.min;
+    skew.max = offset > skew.max ? offset : skew.max;
+    skew.ticks++;
+
+    TEST_ASSERT_TRUE(clock.isTicked());
+
+    hostMicros += esp_random() % WAKE_LATENCY_US;
+
+    // 毎回表示が変わり、境界の時刻を表示する
+    TEST_ASSERT_TRUE(clock.update());
+
+    time_t    shown = (time_t)((wall - offset) / 1000000);
+    struct tm info;
+    char      expect[16];
+
+    localtime_r(&shown, &info);
+    if (clock.isMinutesOnly()) {
+      snprintf(expect, sizeof(expect), "%02d:%02d", info.tm_hour, info.tm_min);
+    } else {
+      snprintf(expect, sizeof(expect), "%02d:%02d:%02d", info.tm_hour, info.tm_min, info.tm_sec);
+    }
+    TEST_ASSERT_EQUAL_STRING(expect, clock.getTime());
+  }
+
+  return skew;
+}
+
+void test_seconds_for_an_hour(void) {
+  ClockService clock;
+  clock.setMinutesOnly(false);
+
+  Skew skew = run(clock, 3600, 1000000);
+
+  TEST_ASSERT_EQUAL_UINT32(3600, skew.ticks);
+  TEST_ASSERT_EQUAL_UINT32(skew.ticks + 1, hostNotified);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, skew.min);
+  TEST_ASSERT_LESS_OR_EQUAL(TICK_MARGIN_US, skew.max);
+}
+
+void test_minutes_for_an_hour(void) {
+  ClockService clock;
+  clock.setMinutesOnly(true);
+
+  Skew skew = run(clock, 3600, 60000000);
+
+  TEST_ASSERT_EQUAL_UINT32(60, skew.ticks);
+  TEST_ASSERT_GREATER_OR_EQUAL(0, skew.min);
+  TEST_ASSERT_LESS_OR_EQUAL(TICK_MARGIN_US, skew.max);
+}
+
+// NTPの同期待ちの間も刻み続け、合わせた後の次の境界に揃え直す
+void test_waits_for_ntp(void) {
+  ClockService clock;
+  clock.setMinutesOnly(false);
+
+  hostSetTimeOfDay(0, 500000);
+  clock.begin();
+
+  for (int i = 0; i < 5; i++) {
+    TEST_ASSERT_TRUE(hostRunTicker());
+    TEST_ASSERT_FALSE(clock.update());
+  }
+
+  // 前の時計で予約した発火は境界からずれる。その時の秒を表示する
+  hostSetTimeOfDay(MORNING, 999000);
+
+  TEST_ASSERT_TRUE(hostRunTicker());
+  TEST_ASSERT_TRUE(clock.update());
+  TEST_ASSERT_EQUAL_STRING("10:00:01", clock.getTime());
+
+  TEST_ASSERT_TRUE(hostRunTicker());
+
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  TEST_ASSERT_LESS_OR_EQUAL(TICK_MARGIN_US, (int)tv.tv_usec);
+
+  TEST_ASSERT_TRUE(clock.update());
+  TEST_ASSERT_EQUAL_STRING("10:00:02", clock.getTime());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_seconds_for_an_hour);
+  RUN_TEST(test_minutes_for_an_hour);
+  RUN_TEST(test_waits_for_ntp);
+  return UNITY_END();
+}
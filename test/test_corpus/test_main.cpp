@@ -0,0 +1,114 @@
+#include "../fuzz/WeatherFuzz.h"
+
+#include <unity.h>
+
+#include <dirent.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// test/corpusの入力を、ファジングと同じ確認に通す
+static std::string corpusDir(const char *name) {
+  std::string path(__FILE__);
+  path.erase(path.find_last_of('/') + 1);
+  return path + "../corpus/" + name;
+}
+
+static std::vector<uint8_t> readFile(const std::string &path) {
+  std::vector<uint8_t> data;
+  FILE                *file = fopen(path.c_str(), "rb");
+
+  if (file) {
+    uint8_t buffer[512];
+    size_t  size;
+
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      data.insert(data.end(), buffer, buffer + size);
+    }
+
+    fclose(file);
+  }
+
+  return data;
+}
+
+// ディレクトリのすべての入力を調べ、読んだ数を返す
+static int replay(const char *name, const char *(*check)(const uint8_t *, size_t)) {
+  std::string dir   = corpusDir(name);
+  DIR        *d     = opendir(dir.c_str());
+  int         count = 0;
+
+  TEST_ASSERT_NOT_NULL_MESSAGE(d, dir.c_str());
+
+  while (struct dirent *entry = readdir(d)) {
+    if (entry->d_name[0] == '.') {
+      continue;
+    }
+
+    std::string          path = dir + "/" + entry->d_name;
+    std::vector<uint8_t> data = readFile(path);
+
+    const char *error = check(data.data(), data.size());
+    if (error == nullptr) {
+      error = fuzzWeather(data.data(), data.size());
+    }
+
+    if (error) {
+      closedir(d);
+      TEST_FAIL_MESSAGE((path + ": " + error).c_str());
+    }
+
+    count++;
+  }
+
+  closedir(d);
+  return count;
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_jma_corpus(void) {
+  TEST_ASSERT_GREATER_THAN(0, replay("jma", fuzzJmaForecast));
+}
+
+void test_thingspeak_corpus(void) {
+  TEST_ASSERT_GREATER_THAN(0, replay("thingspeak", fuzzThingSpeak));
+}
+
+void test_doc_corpus(void) {
+  TEST_ASSERT_GREATER_THAN(0, replay("doc", fuzzDocSnapshot));
+}
+
+// 実際の気象庁の予報が、表示に必要な項目まで読めること
+void test_jma_forecast_is_parsed(void) {
+  std::vector<uint8_t> data = readFile(corpusDir("jma") + "/270000.json");
+
+  StaticJsonDocument<DOC_JMA_FILTER_CAPACITY> filter;
+  DynamicJsonDocument     doc(FUZZ_JMA_CAPACITY);
+  WeatherSnapshot         weather;
+
+  deserializeJson(filter, jmaFilter());
+  clearSnapshot(weather);
+
+  TEST_ASSERT_FALSE(deserializeJson(doc, (const char *)data.data(), data.size(),
+                                    DeserializationOption::Filter(filter),
+                                    DeserializationOption::NestingLimit(DOC_JMA_NESTING)));
+  TEST_ASSERT_TRUE(parseJmaForecast(doc, weather));
+  TEST_ASSERT_EQUAL_STRING("大阪管区気象台", weather.publishingOffice);
+  TEST_ASSERT_EQUAL_STRING("大阪府", weather.area);
+  TEST_ASSERT_EQUAL_STRING("201", weather.weatherCodes);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_jma_corpus);
+  RUN_TEST(test_thingspeak_corpus);
+  RUN_TEST(test_doc_corpus);
+  RUN_TEST(test_jma_forecast_is_parsed);
+  return UNITY_END();
+}
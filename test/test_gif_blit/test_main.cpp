@@ -0,0 +1,138 @@
+#include <GifBlit.h>
+#include <unity.h>
+
+#include <random>
+
+// 1画素ずつ調べる元の処理
+static void scalarBlit(uint8_t *d, const uint8_t *s, int width, uint8_t transparent, const uint8_t *lut) {
+  for (int x = 0; x < width; x++) {
+    if (s[x] != transparent) {
+      d[x] = lut[s[x]];
+    }
+  }
+}
+
+static std::mt19937 engine(20220506);
+static uint8_t      lut[256];
+
+// 透明な画素の割合と、連続する長さを変えたライン
+static void makeLine(uint8_t *s, int width, uint8_t transparent, int percent, int run) {
+  std::uniform_int_distribution<int> byte(0, 255);
+  std::uniform_int_distribution<int> chance(0, 99);
+
+  for (int x = 0; x < width;) {
+    bool clear = chance(engine) < percent;
+
+    for (int i = 0; i < run && x < width; i++, x++) {
+      uint8_t value = byte(engine);
+      if (!clear && value == transparent) {
+        value ^= 0x80;
+      }
+      s[x] = clear ? transparent : value;
+    }
+  }
+}
+
+static void compare(int width, int offset, uint8_t transparent, int percent, int run) {
+  uint8_t source[96 + 8];
+  uint8_t expected[96 + 16];
+  uint8_t actual[96 + 16];
+
+  std::uniform_int_distribution<int> byte(0, 255);
+  for (auto &b : expected) {
+    b = byte(engine);
+  }
+  memcpy(actual, expected, sizeof(actual));
+
+  // 4バイト境界に揃っていない読み書きも試す
+  makeLine(source + offset, width, transparent, percent, run);
+  scalarBlit(expected + 8 + offset, source + offset, width, transparent, lut);
+  gifBlitTransparent(actual + 8 + offset, source + offset, width, transparent, lut);
+
+  char message[96];
+  snprintf(message, sizeof(message), "width %d, offset %d, transparent %d, %d%%, run %d",
+           width, offset, transparent, percent, run);
+
+  // 書き込み先の前後も含めて一致する
+  TEST_ASSERT_EQUAL_MEMORY_MESSAGE(expected, actual, sizeof(actual), message);
+}
+
+void setUp(void) {
+  for (int i = 0; i < 256; i++) {
+    lut[i] = (uint8_t)(i * 37 + 11);
+  }
+}
+
+void tearDown(void) {
+}
+
+void test_matches_scalar_on_random_lines(void) {
+  std::uniform_int_distribution<int> width(0, 96);
+  std::uniform_int_distribution<int> offset(0, 7);
+  std::uniform_int_distribution<int> index(0, 255);
+  std::uniform_int_distribution<int> percent(0, 100);
+  std::uniform_int_distribution<int> run(1, 9);
+
+  for (int i = 0; i < 20000; i++) {
+    compare(width(engine), offset(engine), index(engine), percent(engine), run(engine));
+  }
+}
+
+// 全部透明、全部不透明、交互、境界をまたぐ並び
+void test_matches_scalar_on_edge_patterns(void) {
+  const uint8_t transparents[] = {0x00, 0x01, 0x7F, 0x80, 0xFE, 0xFF};
+
+  for (uint8_t transparent : transparents) {
+    for (int width = 0; width <= 16; width++) {
+      for (int offset = 0; offset < 4; offset++) {
+        compare(width, offset, transparent, 0, 1);
+        compare(width, offset, transparent, 100, 1);
+        compare(width, offset, transparent, 50, 1);
+        compare(width, offset, transparent, 50, 3);
+      }
+    }
+  }
+}
+
+// 透明色と1ビットだけ違う値を、4画素のどの位置でも不透明として扱う
+void test_near_transparent_values_are_opaque(void) {
+  const uint8_t transparents[] = {0x00, 0x01, 0x80, 0xFF};
+
+  for (uint8_t transparent : transparents) {
+    for (int bit = 0; bit < 8; bit++) {
+      for (int position = 0; position < 4; position++) {
+        uint8_t source[4]   = {transparent, transparent, transparent, transparent};
+        uint8_t expected[4] = {0xAA, 0xAA, 0xAA, 0xAA};
+        uint8_t actual[4]   = {0xAA, 0xAA, 0xAA, 0xAA};
+
+        source[position] ^= 1 << bit;
+        scalarBlit(expected, source, 4, transparent, lut);
+        gifBlitTransparent(actual, source, 4, transparent, lut);
+
+        TEST_ASSERT_EQUAL_MEMORY(expected, actual, 4);
+        TEST_ASSERT_EQUAL_UINT8(lut[source[position]], actual[position]);
+      }
+    }
+  }
+}
+
+void test_opaque_converts_every_pixel(void) {
+  uint8_t source[256];
+  uint8_t actual[256];
+
+  for (int i = 0; i < 256; i++) {
+    source[i] = i;
+  }
+
+  gifBlitOpaque(actual, source, 256, lut);
+  TEST_ASSERT_EQUAL_MEMORY(lut, actual, 256);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_matches_scalar_on_random_lines);
+  RUN_TEST(test_matches_scalar_on_edge_patterns);
+  RUN_TEST(test_near_transparent_values_are_opaque);
+  RUN_TEST(test_opaque_converts_every_pixel);
+  return UNITY_END();
+}
@@ -0,0 +1,116 @@
+#include <Arduino.h>
+#include <MemoryHealth.h>
+#include <Preferences.h>
+#include <esp_heap_caps.h>
+
+#include <unity.h>
+
+#include <algorithm>
+
+// 断片化したヒープ。最大連続領域が閾値より小さい
+static void fragmentHeap(void) {
+  hostFreeHeap     = 100 * 1024;
+  hostLargestBlock = 10 * 1024;
+}
+
+static void healHeap(void) {
+  hostFreeHeap     = 200 * 1024;
+  hostLargestBlock = 100 * 1024;
+}
+
+// 再起動した直後の状態にする。NVSはそのまま
+static void boot(void) {
+  hostMicros = 0;
+  MemoryHealth::begin();
+}
+
+// 再起動を要求するまで1周期ずつ進め、その時の稼働時間 [ms] を返す
+static uint64_t runUntilRestart(uint64_t limitMs) {
+  while (hostMicros / 1000 < limitMs) {
+    MemoryHealth::sample();
+
+    if (MemoryHealth::restartRequired()) {
+      return hostMicros / 1000;
+    }
+
+    hostAdvanceMillis(MEMORY_SAMPLE_PERIOD_MS);
+  }
+
+  return 0;
+}
+
+void setUp(void) {
+  hostNvs.clear();
+  healHeap();
+}
+
+void tearDown(void) {
+}
+
+// 起動直後から断片化していても、最低の稼働時間までは再起動しない
+void test_waits_for_min_uptime(void) {
+  boot();
+  fragmentHeap();
+
+  for (int i = 0; i < MEMORY_UNHEALTHY_COUNT * 2; i++) {
+    MemoryHealth::sample();
+    TEST_ASSERT_FALSE(MemoryHealth::restartRequired());
+    hostAdvanceMillis(MEMORY_SAMPLE_PERIOD_MS);
+  }
+
+  TEST_ASSERT_EQUAL(MEMORY_MIN_UPTIME_MS, runUntilRestart(MEMORY_MIN_UPTIME_MS * 2));
+}
+
+// 続けて再起動するたびに、次に再起動するまでの時間を倍にする
+void test_backs_off_after_each_restart(void) {
+  for (uint32_t restarts = 0; restarts <= MEMORY_RESTART_BACKOFF_MAX + 2; restarts++) {
+    boot();
+    fragmentHeap();
+
+    uint32_t expected = (uint32_t)MEMORY_MIN_UPTIME_MS << std::min<uint32_t>(restarts, MEMORY_RESTART_BACKOFF_MAX);
+
+    TEST_ASSERT_EQUAL(expected, MemoryHealth::minUptime());
+    TEST_ASSERT_EQUAL(expected, runUntilRestart((uint64_t)expected * 2));
+
+    MemoryHealth::restarting();
+    TEST_ASSERT_EQUAL(restarts + 1, hostNvs["memory"]["restarts"]);
+  }
+}
+
+// 長く動き続けたら、再起動の回数を0に戻す
+void test_resets_after_long_uptime(void) {
+  hostNvs["memory"]["restarts"] = 3;
+
+  boot();
+  TEST_ASSERT_EQUAL((uint32_t)MEMORY_MIN_UPTIME_MS << 3, MemoryHealth::minUptime());
+
+  while (hostMicros / 1000 < MEMORY_RESTART_RESET_MS) {
+    MemoryHealth::sample();
+    TEST_ASSERT_FALSE(MemoryHealth::restartRequired());
+    hostAdvanceMillis(MEMORY_SAMPLE_PERIOD_MS);
+  }
+
+  MemoryHealth::sample();
+  TEST_ASSERT_EQUAL(0, hostNvs["memory"]["restarts"]);
+  TEST_ASSERT_EQUAL(MEMORY_MIN_UPTIME_MS, MemoryHealth::minUptime());
+
+  // この後に断片化したら、最低の稼働時間を過ぎているのですぐに再起動する
+  fragmentHeap();
+  for (int i = 0; i < MEMORY_UNHEALTHY_COUNT - 1; i++) {
+    hostAdvanceMillis(MEMORY_SAMPLE_PERIOD_MS);
+    MemoryHealth::sample();
+    TEST_ASSERT_FALSE(MemoryHealth::restartRequired());
+  }
+
+  hostAdvanceMillis(MEMORY_SAMPLE_PERIOD_MS);
+  MemoryHealth::sample();
+  TEST_ASSERT_TRUE(MemoryHealth::restartRequired());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_waits_for_min_uptime);
+  RUN_TEST(test_backs_off_after_each_restart);
+  RUN_TEST(test_resets_after_long_uptime);
+  return UNITY_END();
+}
@@ -0,0 +1,166 @@
+#include <Metrics.h>
+#include <unity.h>
+
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static std::vector<std::string> lines;
+
+static bool isName(const std::string &name) {
+  if (name.empty() || isdigit((unsigned char)name[0])) {
+    return false;
+  }
+
+  for (char c : name) {
+    if (!isalnum((unsigned char)c) && c != '_' && c != ':') {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+// histogramの_bucket/_sum/_countは同じ名前のTYPEに属する
+static std::string familyOf(const std::string &name) {
+  for (const char *suffix : {"_bucket", "_sum", "_count"}) {
+    size_t size = strlen(suffix);
+    if (name.size() > size && name.compare(name.size() - size, size, suffix) == 0) {
+      return name.substr(0, name.size() - size);
+    }
+  }
+
+  return name;
+}
+
+// {key="value",...} を読む。閉じていなければfalse
+static bool isLabels(const std::string &labels) {
+  size_t index = 1;
+
+  while (index < labels.size() - 1) {
+    size_t equal = labels.find("=\"", index);
+    if (equal == std::string::npos || !isName(labels.substr(index, equal - index))) {
+      return false;
+    }
+
+    size_t quote = labels.find('"', equal + 2);
+    if (quote == std::string::npos) {
+      return false;
+    }
+
+    index = quote + 1;
+    if (labels[index] == ',') {
+      index++;
+    } else if (index != labels.size() - 1) {
+      return false;
+    }
+  }
+
+  return labels.back() == '}';
+}
+
+void setUp(void) {
+  String text = Metrics::toPrometheus();
+
+  lines.clear();
+
+  std::istringstream stream(text.c_str());
+  for (std::string line; std::getline(stream, line);) {
+    lines.push_back(line);
+  }
+}
+
+void tearDown(void) {
+}
+
+void test_ends_with_newline(void) {
+  String text = Metrics::toPrometheus();
+
+  TEST_ASSERT_TRUE(text.length() > 0);
+  TEST_ASSERT_EQUAL_CHAR('\n', text[text.length() - 1]);
+  TEST_ASSERT_NULL(strstr(text.c_str(), "\n\n"));
+}
+
+void test_every_line_is_well_formed(void) {
+  std::set<std::string> typed;
+
+  for (const auto &line : lines) {
+    TEST_ASSERT_FALSE_MESSAGE(line.empty(), "empty line");
+
+    if (line.compare(0, 7, "# HELP ") == 0) {
+      size_t space = line.find(' ', 7);
+      TEST_ASSERT_TRUE_MESSAGE(space != std::string::npos && isName(line.substr(7, space - 7)), line.c_str());
+      continue;
+    }
+
+    if (line.compare(0, 7, "# TYPE ") == 0) {
+      size_t      space = line.find(' ', 7);
+      std::string name  = line.substr(7, space - 7);
+      std::string type  = space == std::string::npos ? "" : line.substr(space + 1);
+
+      TEST_ASSERT_TRUE_MESSAGE(isName(name), line.c_str());
+      TEST_ASSERT_TRUE_MESSAGE(type == "histogram" || type == "counter" || type == "gauge", line.c_str());
+      typed.insert(name);
+      continue;
+    }
+
+    TEST_ASSERT_NOT_EQUAL_MESSAGE('#', line[0], line.c_str());
+
+    size_t      end  = line.find_first_of("{ ");
+    std::string name = line.substr(0, end);
+    TEST_ASSERT_TRUE_MESSAGE(isName(name), line.c_str());
+    TEST_ASSERT_TRUE_MESSAGE(typed.count(familyOf(name)) || typed.count(name), line.c_str());
+
+    size_t space = line.rfind(' ');
+    TEST_ASSERT_TRUE_MESSAGE(space != std::string::npos && space >= end, line.c_str());
+
+    if (line[end] == '{') {
+      TEST_ASSERT_TRUE_MESSAGE(isLabels(line.substr(end, space - end)), line.c_str());
+    } else {
+      TEST_ASSERT_EQUAL_MESSAGE(end, space, line.c_str());
+    }
+
+    std::string value = line.substr(space + 1);
+    char       *rest  = nullptr;
+    strtod(value.c_str(), &rest);
+    TEST_ASSERT_TRUE_MESSAGE(!value.empty() && *rest == '\0', line.c_str());
+  }
+}
+
+// 名前と説明が長いものでも、HELPとTYPEが切れずに出る
+void test_long_help_is_not_truncated(void) {
+  const char *help = "# HELP atom_present_latency_seconds Time from a clock or weather change to the frame that shows it.";
+  const char *type = "# TYPE atom_present_latency_seconds histogram";
+  bool        foundHelp = false;
+  bool        foundType = false;
+
+  for (const auto &line : lines) {
+    foundHelp |= line == help;
+    foundType |= line == type;
+  }
+
+  TEST_ASSERT_TRUE(foundHelp);
+  TEST_ASSERT_TRUE(foundType);
+}
+
+void test_observation_is_counted(void) {
+  Metrics::observe(METRIC::METRIC_RENDER_JITTER, 250);
+  setUp();
+
+  bool found = false;
+  for (const auto &line : lines) {
+    found |= line == "atom_render_jitter_seconds_bucket{le=\"0.0005\"} 1";
+  }
+
+  TEST_ASSERT_TRUE(found);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_ends_with_newline);
+  RUN_TEST(test_every_line_is_well_formed);
+  RUN_TEST(test_long_help_is_not_truncated);
+  RUN_TEST(test_observation_is_counted);
+  return UNITY_END();
+}
@@ -0,0 +1,108 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <PowerProfile.h>
+#include <WiFi.h>
+
+#include <unity.h>
+
+// ホストにはFreeRTOSの実行時間の統計が無いので、busy()で数えた時間から求める
+static void report(JsonDocument &doc) {
+  TEST_ASSERT_FALSE(deserializeJson(doc, PowerProfile::toJson()));
+}
+
+// 1区間の間に、コアごとに処理した時間 [ms] を数えてから評価する
+static void runWindow(uint32_t core0Ms, uint32_t core1Ms) {
+  hostCoreId = 0;
+  PowerProfile::busy(core0Ms * 1000);
+  hostCoreId = 1;
+  PowerProfile::busy(core1Ms * 1000);
+  hostCoreId = 0;
+
+  hostAdvanceMillis(POWER_WINDOW_MS);
+  PowerProfile::update();
+}
+
+void setUp(void) {
+  hostMicros = 0;
+  hostCpuMHz = 240;
+}
+
+void tearDown(void) {
+}
+
+// 使用率はコアごと。2つのコアを足さない
+void test_duty_is_per_core(void) {
+  PowerProfile::begin(POWER::POWER_PERFORMANCE);
+
+  runWindow(POWER_WINDOW_MS * 9 / 10, POWER_WINDOW_MS * 8 / 10);
+
+  DynamicJsonDocument doc(1024);
+  report(doc);
+  TEST_ASSERT_EQUAL_STRING("busy", doc["dutySource"].as<const char *>());
+  TEST_ASSERT_EQUAL(90, doc["duty"][0].as<uint32_t>());
+  TEST_ASSERT_EQUAL(80, doc["duty"][1].as<uint32_t>());
+}
+
+// 通信している時間はCPU使用率に含めず、別に数える
+void test_network_is_reported_separately(void) {
+  PowerProfile::begin(POWER::POWER_PERFORMANCE);
+
+  // 区間をまたいで通信しても、どちらの区間も100%を超えない
+  hostAdvanceMillis(POWER_WINDOW_MS / 2);
+  PowerProfile::beginNetwork();
+  PowerProfile::busy(POWER_WINDOW_MS * 9 / 10 * 1000);
+  hostAdvanceMillis(POWER_WINDOW_MS / 2);
+  PowerProfile::update();
+
+  DynamicJsonDocument doc(1024);
+  report(doc);
+  TEST_ASSERT_EQUAL(90, doc["duty"][0].as<uint32_t>());
+  TEST_ASSERT_EQUAL(50, doc["networkDuty"].as<uint32_t>());
+
+  hostAdvanceMillis(POWER_WINDOW_MS);
+  PowerProfile::endNetwork();
+  PowerProfile::update();
+
+  report(doc);
+  TEST_ASSERT_EQUAL(0, doc["duty"][0].as<uint32_t>());
+  TEST_ASSERT_EQUAL(100, doc["networkDuty"].as<uint32_t>());
+  TEST_ASSERT_EQUAL(75, doc["radioDuty"].as<uint32_t>());
+
+  // 1区間より長い処理を数えても100%まで
+  runWindow(POWER_WINDOW_MS * 2, 0);
+
+  report(doc);
+  TEST_ASSERT_EQUAL(100, doc["duty"][0].as<uint32_t>());
+  TEST_ASSERT_EQUAL(0, doc["networkDuty"].as<uint32_t>());
+}
+
+// 省電力では、一番忙しいコアでクロックを決める
+void test_frequency_follows_busiest_core(void) {
+  PowerProfile::begin(POWER::POWER_LOW);
+
+  runWindow(0, 0);
+  TEST_ASSERT_EQUAL(160, hostCpuMHz);
+
+  runWindow(0, 0);
+  TEST_ASSERT_EQUAL(80, hostCpuMHz);
+
+  // 片方のコアだけが忙しい。2つのコアの平均では上げないが、上げる
+  runWindow(0, POWER_WINDOW_MS * 7 / 10);
+  TEST_ASSERT_EQUAL(160, hostCpuMHz);
+
+  // 通信の間だけモデムスリープを止め、クロックを上げる
+  PowerProfile::beginNetwork();
+  TEST_ASSERT_FALSE(WiFi.sleep);
+  TEST_ASSERT_EQUAL(240, hostCpuMHz);
+
+  PowerProfile::endNetwork();
+  TEST_ASSERT_TRUE(WiFi.sleep);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_duty_is_per_core);
+  RUN_TEST(test_network_is_reported_separately);
+  RUN_TEST(test_frequency_follows_busiest_core);
+  return UNITY_END();
+}
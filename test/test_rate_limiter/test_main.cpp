@@ -0,0 +1,118 @@
+#include <RateLimiter.hpp>
+#include <unity.h>
+
+void setUp(void) {
+  hostAdvanceMillis(1000);
+}
+
+void tearDown(void) {
+}
+
+// 新しいクライアントは満タンから始まり、burst回で尽きる
+void test_new_client_starts_full(void) {
+  RateLimiter limiter(1, 3);
+
+  TEST_ASSERT_TRUE(limiter.allow(1));
+  TEST_ASSERT_TRUE(limiter.allow(1));
+  TEST_ASSERT_TRUE(limiter.allow(1));
+  TEST_ASSERT_FALSE(limiter.allow(1));
+
+  // 他のクライアントは別のバケット
+  TEST_ASSERT_TRUE(limiter.allow(2));
+}
+
+// rate [回/秒] で1トークンずつ貯まる
+void test_refill(void) {
+  RateLimiter limiter(2, 2);
+
+  TEST_ASSERT_TRUE(limiter.allow(1));
+  TEST_ASSERT_TRUE(limiter.allow(1));
+  TEST_ASSERT_FALSE(limiter.allow(1));
+
+  hostAdvanceMillis(499);
+  TEST_ASSERT_FALSE(limiter.allow(1));
+
+  hostAdvanceMillis(1);
+  TEST_ASSERT_TRUE(limiter.allow(1));
+  TEST_ASSERT_FALSE(limiter.allow(1));
+
+  // 断られた呼び出しの分も失われない
+  hostAdvanceMillis(250);
+  TEST_ASSERT_FALSE(limiter.allow(1));
+  hostAdvanceMillis(250);
+  TEST_ASSERT_TRUE(limiter.allow(1));
+}
+
+// 長く休んでもburstより多くは貯まらない
+void test_refill_is_capped_at_burst(void) {
+  RateLimiter limiter(5, 3);
+
+  TEST_ASSERT_TRUE(limiter.allow(1));
+
+  hostAdvanceMillis(10 * 60 * 1000);
+
+  for (int i = 0; i < 3; i++) {
+    TEST_ASSERT_TRUE(limiter.allow(1));
+  }
+  TEST_ASSERT_FALSE(limiter.allow(1));
+}
+
+// millis()が一周しても経過時間は正しい
+void test_millis_wrap(void) {
+  hostAdvanceMillis(UINT32_MAX - millis() - 200);
+
+  RateLimiter limiter(1, 1);
+
+  TEST_ASSERT_TRUE(limiter.allow(1));
+  TEST_ASSERT_FALSE(limiter.allow(1));
+
+  hostAdvanceMillis(1000);
+  TEST_ASSERT_LESS_THAN(1000, millis());
+  TEST_ASSERT_TRUE(limiter.allow(1));
+  TEST_ASSERT_FALSE(limiter.allow(1));
+}
+
+// 溢れたら一番長く来ていないクライアントを捨てる
+void test_evicts_least_recently_seen(void) {
+  RateLimiter limiter(1, 1);
+
+  for (uint32_t key = 1; key <= RATE_LIMIT_CLIENTS; key++) {
+    TEST_ASSERT_TRUE(limiter.allow(key));
+    hostAdvanceMillis(10);
+  }
+
+  // 1は最近来たので残る。2が一番古い
+  TEST_ASSERT_FALSE(limiter.allow(1));
+
+  TEST_ASSERT_TRUE(limiter.allow(RATE_LIMIT_CLIENTS + 1));
+
+  TEST_ASSERT_FALSE(limiter.allow(1));
+  TEST_ASSERT_FALSE(limiter.allow(3));
+
+  // 捨てられた2は満タンからやり直す
+  TEST_ASSERT_TRUE(limiter.allow(2));
+}
+
+// 多数のクライアントが入れ替わっても、残っているクライアントの残量は変わらない
+void test_churn_keeps_active_client(void) {
+  RateLimiter limiter(1, 2);
+
+  TEST_ASSERT_TRUE(limiter.allow(1));
+  TEST_ASSERT_TRUE(limiter.allow(1));
+
+  for (uint32_t key = 100; key < 100 + RATE_LIMIT_CLIENTS * 4; key++) {
+    TEST_ASSERT_TRUE(limiter.allow(key));
+    TEST_ASSERT_FALSE(limiter.allow(1));
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_new_client_starts_full);
+  RUN_TEST(test_refill);
+  RUN_TEST(test_refill_is_capped_at_burst);
+  RUN_TEST(test_millis_wrap);
+  RUN_TEST(test_evicts_least_recently_seen);
+  RUN_TEST(test_churn_keeps_active_client);
+  return UNITY_END();
+}
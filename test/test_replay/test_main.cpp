@@ -0,0 +1,141 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <BoundedStream.hpp>
+#include <JmaForecast.h>
+#include <Replay.hpp>
+
+#include <unity.h>
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// test/corpus/replayの受信記録を、ネットワーク無しで予報の読み込みに通す
+// jma_270000.binはtools/replay.py makeで、270000.jsonの応答から作った
+//   120 ms後に最初の512バイト、以後20000バイト/秒で、222 msに最後のレコード
+#define CAPTURE_PATH       "/jma_270000.bin"
+#define CAPTURE_LATENCY_MS 120
+#define CAPTURE_LAST_MS    222
+
+static std::string testDir(const char *name) {
+  std::string path(__FILE__);
+  path.erase(path.find_last_of('/') + 1);
+  return path + name;
+}
+
+static std::vector<char> readFile(const std::string &path) {
+  std::vector<char> data;
+  FILE             *file = fopen(path.c_str(), "rb");
+
+  if (file) {
+    char   buffer[512];
+    size_t size;
+
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      data.insert(data.end(), buffer, buffer + size);
+    }
+
+    fclose(file);
+  }
+
+  return data;
+}
+
+// HTTPClientの代わりに、ステータス行とヘッダを読み飛ばしてステータスコードを返す
+static int readHeaders(Stream &stream) {
+  std::string line;
+  int         status = 0;
+  int         data;
+
+  while ((data = stream.read()) >= 0) {
+    if (data != '\n') {
+      line += (char)data;
+      continue;
+    }
+
+    if (line == "\r") {
+      return status;
+    }
+
+    if (status == 0) {
+      sscanf(line.c_str(), "HTTP/1.%*d %d", &status);
+    }
+    line.clear();
+  }
+
+  return 0;
+}
+
+void setUp(void) {
+  hostMicros = 0;
+  hostFsRoot = testDir("../corpus/replay");
+}
+
+void tearDown(void) {
+}
+
+// 記録した時刻になるまで、次のバイトは届かない
+void test_capture_is_paced(void) {
+  WiFiClient   network;
+  ReplayClient client(network, CAPTURE_PATH, 1);
+
+  TEST_ASSERT_TRUE(client.connected());
+
+  hostAdvanceMillis(CAPTURE_LATENCY_MS - 1);
+  TEST_ASSERT_EQUAL(0, client.available());
+  TEST_ASSERT_EQUAL(-1, client.read());
+
+  hostAdvanceMillis(1);
+  TEST_ASSERT_EQUAL(512, client.available());
+
+  size_t bytes = 0;
+  while (client.connected()) {
+    if (client.available()) {
+      client.read();
+      bytes++;
+    } else {
+      hostAdvanceMillis(1);
+    }
+  }
+
+  TEST_ASSERT_EQUAL(CAPTURE_LAST_MS, millis());
+  TEST_ASSERT_EQUAL(2090, bytes);
+}
+
+// ATOMDoc::requestWeatherJson()/parseWeatherJson()と同じ順に読む
+void test_replayed_forecast_is_parsed(void) {
+  WiFiClient   network;
+  ReplayClient client(network, CAPTURE_PATH, 0);
+
+  TEST_ASSERT_EQUAL(200, readHeaders(client));
+
+  BoundedStream       bounded(client, DOC_JMA_MAX_BYTES, DOC_JMA_MAX_MS);
+  DynamicJsonDocument doc(DOC_JMA_CAPACITY);
+  WeatherSnapshot     weather;
+
+  clearSnapshot(weather);
+
+  DeserializationError error = readJmaForecast(doc, bounded);
+  TEST_ASSERT_FALSE_MESSAGE(error, error.c_str());
+  TEST_ASSERT_FALSE(bounded.exceeded());
+  TEST_ASSERT_EQUAL(1998, bounded.count());
+
+  TEST_ASSERT_TRUE(parseJmaForecast(doc, weather));
+  TEST_ASSERT_EQUAL_STRING("大阪管区気象台", weather.publishingOffice);
+  TEST_ASSERT_EQUAL_STRING("大阪府", weather.area);
+  TEST_ASSERT_EQUAL_STRING("201", weather.weatherCodes);
+
+  // ATOMDoc::lookupCode()がSPIFFSから読むcodes.json
+  std::vector<char> codes = readFile(testDir("../../data/codes.json"));
+  TEST_ASSERT_TRUE(lookupWeatherCode(weather, (const char *)codes.data(), codes.size()));
+  TEST_ASSERT_EQUAL_STRING("/201.gif", weather.iconFile);
+  TEST_ASSERT_EQUAL_STRING("曇時々晴", weather.weathersJP);
+  TEST_ASSERT_EQUAL_STRING("MOSTLY CLOUDY", weather.weathersEN);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_capture_is_paced);
+  RUN_TEST(test_replayed_forecast_is_parsed);
+  return UNITY_END();
+}
@@ -0,0 +1,203 @@
+#include <Scheduler.hpp>
+#include <unity.h>
+
+#include <cstdlib>
+
+// 2022-05-06T01:00:00Z = 10:00 JST
+static const time_t MORNING = 1651798800;
+
+void setUp(void) {
+  setenv("TZ", "JST-9", 1);
+  tzset();
+
+  hostAdvanceMillis(1000000);
+  hostSetTime(0);
+}
+
+void tearDown(void) {
+}
+
+void test_parse_utc(void) {
+  TEST_ASSERT_EQUAL(1651824000, Scheduler::parseUtc("2022-05-06T08:00:00Z"));
+  TEST_ASSERT_EQUAL(951782400, Scheduler::parseUtc("2000-02-29T00:00:00Z"));
+  TEST_ASSERT_EQUAL(0, Scheduler::parseUtc("2022-05-06"));
+  TEST_ASSERT_EQUAL(0, Scheduler::parseUtc(nullptr));
+  TEST_ASSERT_EQUAL(0, Scheduler::parseUtc("2022-13-06T08:00:00Z"));
+  TEST_ASSERT_EQUAL(0, Scheduler::parseUtc("2022-05-06T2147483647:00:00Z"));
+  TEST_ASSERT_EQUAL(0, Scheduler::parseUtc("99999-05-06T08:00:00Z"));
+}
+
+void test_enabled_source_is_due_at_once(void) {
+  Scheduler scheduler;
+
+  TEST_ASSERT_FALSE(scheduler.isAnyDue());
+
+  scheduler.enable(SOURCE::SOURCE_JMA);
+  TEST_ASSERT_TRUE(scheduler.isDue(SOURCE::SOURCE_JMA));
+  TEST_ASSERT_FALSE(scheduler.isDue(SOURCE::SOURCE_THINGSPEAK));
+  TEST_ASSERT_EQUAL(0, scheduler.secondsToNextFetch());
+}
+
+void test_fallback_without_clock(void) {
+  Scheduler scheduler;
+  scheduler.enable(SOURCE::SOURCE_JMA);
+
+  TEST_ASSERT_FALSE(Scheduler::isClockValid());
+
+  scheduler.succeeded(SOURCE::SOURCE_JMA);
+  TEST_ASSERT_EQUAL(SCHEDULE_FALLBACK_PERIOD, scheduler.secondsToNextFetch());
+  TEST_ASSERT_EQUAL(0, scheduler.nextUpdate());
+
+  hostAdvanceMillis((SCHEDULE_FALLBACK_PERIOD - 1) * 1000);
+  TEST_ASSERT_FALSE(scheduler.isAnyDue());
+
+  hostAdvanceMillis(1000);
+  TEST_ASSERT_TRUE(scheduler.isAnyDue());
+}
+
+// 発表時刻 + SCHEDULE_JMA_DELAY に合わせる
+void test_jma_report_slots(void) {
+  struct {
+    time_t   now;
+    uint32_t expected;
+  } cases[] = {
+      {MORNING, 3600 + SCHEDULE_JMA_DELAY},                  // 10:00 -> 11:05
+      {MORNING + 3600 + SCHEDULE_JMA_DELAY - 1, 1},          // 11:04:59 -> 11:05
+      {MORNING + 3600 + SCHEDULE_JMA_DELAY, 6 * 3600},       // 11:05 -> 17:05
+      {MORNING + 7 * 3600 + SCHEDULE_JMA_DELAY, 12 * 3600},  // 17:05 -> 05:05
+      {MORNING + 13 * 3600, 6 * 3600 + SCHEDULE_JMA_DELAY},  // 23:00 -> 05:05
+      {MORNING - 5 * 3600, SCHEDULE_JMA_DELAY},              // 05:00 -> 05:05
+  };
+
+  for (const auto &c : cases) {
+    Scheduler scheduler;
+    scheduler.enable(SOURCE::SOURCE_JMA);
+    hostSetTime(c.now);
+
+    scheduler.succeeded(SOURCE::SOURCE_JMA);
+    TEST_ASSERT_EQUAL(c.expected, scheduler.secondsToNextFetch());
+    TEST_ASSERT_EQUAL(c.now + c.expected, scheduler.nextUpdate());
+  }
+}
+
+// 最後の更新から1周期後に合わせる。止まっているチャンネルは通常の周期
+void test_thingspeak_alignment(void) {
+  Scheduler scheduler;
+  scheduler.enable(SOURCE::SOURCE_THINGSPEAK);
+  hostSetTime(MORNING);
+
+  scheduler.succeeded(SOURCE::SOURCE_THINGSPEAK, MORNING - 100);
+  TEST_ASSERT_EQUAL(SCHEDULE_THINGSPEAK_PERIOD + SCHEDULE_DOC_MARGIN - 100, scheduler.secondsToNextFetch());
+
+  scheduler.succeeded(SOURCE::SOURCE_THINGSPEAK, MORNING - 1000);
+  TEST_ASSERT_EQUAL(SCHEDULE_THINGSPEAK_PERIOD, scheduler.secondsToNextFetch());
+
+  scheduler.succeeded(SOURCE::SOURCE_THINGSPEAK, MORNING + 1000);
+  TEST_ASSERT_EQUAL(SCHEDULE_THINGSPEAK_PERIOD, scheduler.secondsToNextFetch());
+}
+
+// ATOM Docの次回更新の後に、分散させて取りに行く
+void test_doc_follows_advertised_update(void) {
+  hostSetTime(MORNING);
+
+  for (int i = 0; i < 100; i++) {
+    Scheduler scheduler;
+    scheduler.enable(SOURCE::SOURCE_DOC);
+
+    scheduler.succeeded(SOURCE::SOURCE_DOC, MORNING + 600);
+    uint32_t seconds = scheduler.secondsToNextFetch();
+
+    TEST_ASSERT_GREATER_OR_EQUAL(600 + SCHEDULE_DOC_MARGIN, seconds);
+    TEST_ASSERT_LESS_OR_EQUAL(600 + SCHEDULE_DOC_MARGIN + SCHEDULE_DOC_SPREAD, seconds);
+  }
+
+  Scheduler scheduler;
+  scheduler.enable(SOURCE::SOURCE_DOC);
+
+  scheduler.succeeded(SOURCE::SOURCE_DOC, MORNING - 10);
+  TEST_ASSERT_EQUAL(SCHEDULE_FALLBACK_PERIOD, scheduler.secondsToNextFetch());
+
+  scheduler.succeeded(SOURCE::SOURCE_DOC, MORNING + SCHEDULE_BACKOFF_MAX);
+  TEST_ASSERT_EQUAL(SCHEDULE_FALLBACK_PERIOD, scheduler.secondsToNextFetch());
+}
+
+// 失敗するたびに倍、揺らぎは[delay/2, delay*3/2]、上限はSCHEDULE_BACKOFF_MAX
+void test_backoff(void) {
+  Scheduler scheduler;
+  scheduler.enable(SOURCE::SOURCE_JMA);
+
+  for (uint32_t failures = 1; failures <= 12; failures++) {
+    uint32_t shift = failures > 8 ? 8 : failures - 1;
+    uint32_t lower = (SCHEDULE_BACKOFF_BASE << shift) / 2;
+
+    scheduler.failed(SOURCE::SOURCE_JMA);
+    uint32_t seconds = scheduler.secondsToNextFetch();
+
+    TEST_ASSERT_GREATER_OR_EQUAL(lower < SCHEDULE_BACKOFF_MAX ? lower : SCHEDULE_BACKOFF_MAX, seconds);
+    TEST_ASSERT_LESS_OR_EQUAL(SCHEDULE_BACKOFF_MAX, seconds);
+  }
+
+  // 揺らぎを入れても上限を越えない
+  for (int i = 0; i < 1000; i++) {
+    scheduler.failed(SOURCE::SOURCE_JMA);
+    TEST_ASSERT_LESS_OR_EQUAL(SCHEDULE_BACKOFF_MAX, scheduler.secondsToNextFetch());
+  }
+
+  scheduler.succeeded(SOURCE::SOURCE_JMA);
+  scheduler.failed(SOURCE::SOURCE_JMA);
+  TEST_ASSERT_LESS_OR_EQUAL(SCHEDULE_BACKOFF_BASE / 2 + SCHEDULE_BACKOFF_BASE, scheduler.secondsToNextFetch());
+}
+
+// 一番近い取得元に合わせる
+void test_next_fetch_is_the_earliest_source(void) {
+  Scheduler scheduler;
+  scheduler.enable(SOURCE::SOURCE_JMA);
+  scheduler.enable(SOURCE::SOURCE_THINGSPEAK);
+  hostSetTime(MORNING);
+
+  scheduler.succeeded(SOURCE::SOURCE_JMA);
+  TEST_ASSERT_EQUAL(0, scheduler.secondsToNextFetch());
+
+  scheduler.succeeded(SOURCE::SOURCE_THINGSPEAK);
+  TEST_ASSERT_EQUAL(SCHEDULE_THINGSPEAK_PERIOD, scheduler.secondsToNextFetch());
+  TEST_ASSERT_EQUAL(MORNING + SCHEDULE_THINGSPEAK_PERIOD, scheduler.nextUpdate());
+
+  hostAdvanceMillis(SCHEDULE_THINGSPEAK_PERIOD * 1000);
+  TEST_ASSERT_TRUE(scheduler.isDue(SOURCE::SOURCE_THINGSPEAK));
+  TEST_ASSERT_FALSE(scheduler.isDue(SOURCE::SOURCE_JMA));
+  TEST_ASSERT_EQUAL(0, scheduler.secondsToNextFetch());
+}
+
+// millis()が一周する49.7日を越えても、取得が止まらない
+void test_millis_wrap(void) {
+  Scheduler scheduler;
+
+  hostAdvanceMillis(UINT32_MAX - millis() - 30 * 1000);  // 一周する30秒前
+
+  scheduler.enable(SOURCE::SOURCE_THINGSPEAK);
+  scheduler.succeeded(SOURCE::SOURCE_THINGSPEAK);
+  TEST_ASSERT_FALSE(scheduler.isDue(SOURCE::SOURCE_THINGSPEAK));
+
+  hostAdvanceMillis((SCHEDULE_THINGSPEAK_PERIOD - 1) * 1000);
+  TEST_ASSERT_TRUE(millis() < 30 * 1000 + SCHEDULE_THINGSPEAK_PERIOD * 1000);
+  TEST_ASSERT_FALSE(scheduler.isDue(SOURCE::SOURCE_THINGSPEAK));
+  TEST_ASSERT_EQUAL(1, scheduler.secondsToNextFetch());
+
+  hostAdvanceMillis(1000);
+  TEST_ASSERT_TRUE(scheduler.isDue(SOURCE::SOURCE_THINGSPEAK));
+  TEST_ASSERT_EQUAL(0, scheduler.secondsToNextFetch());
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_parse_utc);
+  RUN_TEST(test_enabled_source_is_due_at_once);
+  RUN_TEST(test_fallback_without_clock);
+  RUN_TEST(test_jma_report_slots);
+  RUN_TEST(test_thingspeak_alignment);
+  RUN_TEST(test_doc_follows_advertised_update);
+  RUN_TEST(test_backoff);
+  RUN_TEST(test_next_fetch_is_the_earliest_source);
+  RUN_TEST(test_millis_wrap);
+  return UNITY_END();
+}
@@ -0,0 +1,268 @@
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <WeatherApi.hpp>
+
+#include <unity.h>
+
+#include <map>
+#include <string>
+
+// WebServerの代わり。要求を1つずつ渡し、最後の応答を覚えておく
+class FakeServer {
+ public:
+  struct Client {
+    uint32_t ip;
+
+    uint32_t remoteIP(void) const {
+      return ip;
+    }
+  };
+
+  void request(uint32_t ip, const char *since = nullptr, const char *ifNoneMatch = nullptr) {
+    _ip = ip;
+    _args.clear();
+    _headers.clear();
+    code = 0;
+    body = nullptr;
+    sent.clear();
+
+    if (since) {
+      _args["since"] = since;
+    }
+    if (ifNoneMatch) {
+      _headers["If-None-Match"] = ifNoneMatch;
+    }
+  }
+
+  Client client(void) {
+    return Client{_ip};
+  }
+
+  bool hasArg(const char *name) {
+    return _args.count(name) != 0;
+  }
+
+  String arg(const char *name) {
+    return hasArg(name) ? String(_args[name]) : String();
+  }
+
+  String header(const char *name) {
+    return _headers.count(name) ? String(_headers[name]) : String();
+  }
+
+  void sendHeader(const String &name, const String &value) {
+    sent[name.c_str()] = value.c_str();
+  }
+
+  void send(int status) {
+    code = status;
+  }
+
+  void send(int status, const char *type, const String &content) {
+    code = status;
+    body = &content;
+  }
+
+  int                                code;
+  const String                      *body;
+  std::map<std::string, std::string> sent;
+
+ private:
+  uint32_t                           _ip;
+  std::map<std::string, std::string> _args;
+  std::map<std::string, std::string> _headers;
+};
+
+static WeatherSnapshot makeWeather(float degree) {
+  WeatherSnapshot weather;
+
+  clearSnapshot(weather);
+  strlcpy(weather.publishingOffice, "大阪管区気象台", sizeof(weather.publishingOffice));
+  strlcpy(weather.area, "大阪府", sizeof(weather.area));
+  strlcpy(weather.weatherCodes, "201", sizeof(weather.weatherCodes));
+  weather.degree = degree;
+
+  return weather;
+}
+
+static uint32_t stat(WeatherApi &api, const char *name) {
+  StaticJsonDocument<JSON_OBJECT_SIZE(16)> doc;
+
+  TEST_ASSERT_FALSE(deserializeJson(doc, api.stats()));
+  return doc[name].as<uint32_t>();
+}
+
+void setUp(void) {
+  hostMicros = 0;
+}
+
+void tearDown(void) {
+}
+
+// 同じ版を取りに来たViewには、一度作ったJSONをそのまま返す
+void test_identical_requests_share_one_buffer(void) {
+  WeatherApi api(0x10000);
+  FakeServer server;
+
+  api.publish(makeWeather(20.5f));
+
+  server.request(1);
+  api.serve(server);
+  TEST_ASSERT_EQUAL(200, server.code);
+
+  const String *first = server.body;
+  std::string   json  = first->c_str();
+
+  for (uint32_t ip = 2; ip <= 10; ip++) {
+    server.request(ip);
+    api.serve(server);
+    TEST_ASSERT_EQUAL(200, server.code);
+    TEST_ASSERT_EQUAL_PTR(first, server.body);
+    TEST_ASSERT_EQUAL_STRING(json.c_str(), server.body->c_str());
+  }
+
+  TEST_ASSERT_EQUAL(10, stat(api, "served"));
+  TEST_ASSERT_EQUAL(1, stat(api, "builds"));
+
+  // 版が変わったら一度だけ作り直す
+  api.publish(makeWeather(21.0f));
+
+  for (uint32_t ip = 11; ip <= 12; ip++) {
+    server.request(ip);
+    api.serve(server);
+    TEST_ASSERT_EQUAL(200, server.code);
+    TEST_ASSERT_TRUE(json != server.body->c_str());
+  }
+
+  TEST_ASSERT_EQUAL(2, stat(api, "builds"));
+}
+
+void test_not_modified(void) {
+  WeatherApi api(0x10000);
+  FakeServer server;
+
+  api.publish(makeWeather(20.5f));
+
+  server.request(1);
+  api.serve(server);
+  TEST_ASSERT_EQUAL(200, server.code);
+
+  std::string etag = server.sent["ETag"];
+  TEST_ASSERT_EQUAL_STRING("\"65537\"", etag.c_str());
+
+  server.request(2, nullptr, etag.c_str());
+  api.serve(server);
+  TEST_ASSERT_EQUAL(304, server.code);
+
+  server.request(3, "65537");
+  api.serve(server);
+  TEST_ASSERT_EQUAL(304, server.code);
+
+  TEST_ASSERT_EQUAL(2, stat(api, "notModified"));
+}
+
+// 前の版を持っているViewには、変わったフィールドだけを返す
+void test_delta_is_shared(void) {
+  WeatherApi api(0x10000);
+  FakeServer server;
+
+  api.publish(makeWeather(20.5f));
+
+  server.request(1);
+  api.serve(server);
+  size_t full = server.body->length();
+
+  api.publish(makeWeather(21.0f));
+
+  server.request(2, "65537");
+  api.serve(server);
+  TEST_ASSERT_EQUAL(200, server.code);
+  TEST_ASSERT_LESS_THAN(full, server.body->length());
+
+  const String *delta = server.body;
+
+  server.request(3, "65537");
+  api.serve(server);
+  TEST_ASSERT_EQUAL(200, server.code);
+  TEST_ASSERT_EQUAL_PTR(delta, server.body);
+
+  TEST_ASSERT_EQUAL(2, stat(api, "deltas"));
+}
+
+// 1つのViewが続けて取りに来たら429で断る
+void test_client_is_limited(void) {
+  WeatherApi api(0x10000);
+  FakeServer server;
+
+  api.publish(makeWeather(20.5f));
+
+  for (int i = 0; i < DOC_API_CLIENT_BURST; i++) {
+    server.request(1);
+    api.serve(server);
+    TEST_ASSERT_EQUAL(200, server.code);
+  }
+
+  server.request(1);
+  api.serve(server);
+  TEST_ASSERT_EQUAL(429, server.code);
+  TEST_ASSERT_EQUAL_STRING("1", server.sent["Retry-After"].c_str());
+
+  // 他のViewは断らない
+  server.request(2);
+  api.serve(server);
+  TEST_ASSERT_EQUAL(200, server.code);
+
+  hostAdvanceMillis(1000 / DOC_API_CLIENT_RATE);
+
+  server.request(1);
+  api.serve(server);
+  TEST_ASSERT_EQUAL(200, server.code);
+
+  TEST_ASSERT_EQUAL(1, stat(api, "limited"));
+}
+
+// 同じ時刻にDOC_API_BURSTより多く来たら、残りは503ですぐに断る
+void test_burst_is_shed(void) {
+  WeatherApi api(0x10000);
+  FakeServer server;
+
+  api.publish(makeWeather(20.5f));
+
+  for (uint32_t ip = 1; ip <= DOC_API_BURST; ip++) {
+    server.request(ip);
+    api.serve(server);
+    TEST_ASSERT_EQUAL(200, server.code);
+  }
+
+  for (uint32_t ip = DOC_API_BURST + 1; ip <= DOC_API_BURST + 10; ip++) {
+    server.request(ip);
+    api.serve(server);
+    TEST_ASSERT_EQUAL(503, server.code);
+    TEST_ASSERT_EQUAL_STRING("1", server.sent["Retry-After"].c_str());
+    TEST_ASSERT_TRUE(server.sent.find("ETag") == server.sent.end());
+  }
+
+  TEST_ASSERT_EQUAL(10, stat(api, "shed"));
+  TEST_ASSERT_EQUAL(DOC_API_BURST, stat(api, "served"));
+
+  // 1つ分貯まったら、また受け付ける
+  hostAdvanceMillis(1000 / DOC_API_RATE);
+
+  server.request(1000);
+  api.serve(server);
+  TEST_ASSERT_EQUAL(200, server.code);
+
+  server.request(1001);
+  api.serve(server);
+  TEST_ASSERT_EQUAL(503, server.code);
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_identical_requests_share_one_buffer);
+  RUN_TEST(test_not_modified);
+  RUN_TEST(test_delta_is_shared);
+  RUN_TEST(test_client_is_limited);
+  RUN_TEST(test_burst_is_shed);
+  return UNITY_END();
+}
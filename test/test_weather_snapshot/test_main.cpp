@@ -0,0 +1,314 @@
+#include <WeatherSnapshot.h>
+#include <unity.h>
+
+static WeatherSnapshot makeSnapshot(void) {
+  WeatherSnapshot snapshot;
+  clearSnapshot(snapshot);
+
+  setSnapshotField(snapshot.publishingOffice, "大阪管区気象台");
+  setSnapshotField(snapshot.reportDatetime, "2022-05-06T17:00:00+09:00");
+  setSnapshotField(snapshot.timeDefines, "2022-05-06T17:00:00+09:00");
+  setSnapshotField(snapshot.area, "大阪府");
+  setSnapshotField(snapshot.weatherCodes, "101");
+  setSnapshotField(snapshot.weathersJP, "晴時々曇");
+  setSnapshotField(snapshot.weathersEN, "PARTLY CLOUDY");
+  setSnapshotField(snapshot.winds, "南西の風　後　北東の風");
+  setSnapshotField(snapshot.waves, "０．５メートル");
+  setSnapshotField(snapshot.iconFile, "/101.gif");
+
+  // 2進数で割り切れる値にして、JSONを通しても同じ値になるようにする
+  snapshot.degree     = 23.5f;
+  snapshot.humidity   = 61.25f;
+  snapshot.pressure   = 1013.5f;
+  snapshot.nextUpdate = 1651824300;
+  snapshot.stale      = false;
+
+  return snapshot;
+}
+
+// 書き出したJSONをsnapshotへ適用する
+static bool apply(const String &json, WeatherSnapshot &snapshot) {
+  DynamicJsonDocument doc(SNAPSHOT_JSON_CAPACITY);
+
+  if (deserializeJson(doc, json)) {
+    return false;
+  }
+
+  return deserializeSnapshot(doc, snapshot);
+}
+
+void setUp(void) {
+}
+
+void tearDown(void) {
+}
+
+void test_full_round_trip(void) {
+  WeatherSnapshot full = makeSnapshot();
+  WeatherSnapshot copy;
+  String          json;
+
+  TEST_ASSERT_TRUE(serializeSnapshot(full, json, SNAPSHOT_ALL_FIELDS, 0xFFFFFFFF));
+  clearSnapshot(copy);
+
+  TEST_ASSERT_TRUE(apply(json, copy));
+  TEST_ASSERT_EQUAL_UINT32(0, diffSnapshot(full, copy));
+}
+
+// ATOM Docが前回起動時のデータを配っていることがViewに伝わる
+void test_stale_round_trip(void) {
+  WeatherSnapshot full = makeSnapshot();
+  WeatherSnapshot copy = makeSnapshot();
+  String          json;
+
+  full.stale = true;
+  serializeSnapshot(full, json);
+
+  TEST_ASSERT_TRUE(apply(json, copy));
+  TEST_ASSERT_TRUE(copy.stale);
+
+  full.stale = false;
+  serializeSnapshot(full, json, diffSnapshot(copy, full), 2);
+
+  TEST_ASSERT_TRUE(apply(json, copy));
+  TEST_ASSERT_FALSE(copy.stale);
+  TEST_ASSERT_EQUAL_UINT32(0, diffSnapshot(full, copy));
+}
+
+// どのフィールドも一杯の時でも、書き出して読み直せる
+void test_longest_snapshot_fits(void) {
+  WeatherSnapshot full = makeSnapshot();
+  WeatherSnapshot copy;
+  String          json;
+
+#define FILL(field)                                    \
+  memset(full.field, 'x', sizeof(full.field) - 1);     \
+  full.field[sizeof(full.field) - 1] = '\0';
+
+  FILL(publishingOffice);
+  FILL(reportDatetime);
+  FILL(timeDefines);
+  FILL(area);
+  FILL(weatherCodes);
+  FILL(weathersJP);
+  FILL(weathersEN);
+  FILL(winds);
+  FILL(waves);
+  FILL(iconFile);
+
+#undef FILL
+
+  TEST_ASSERT_TRUE(serializeSnapshot(full, json, SNAPSHOT_ALL_FIELDS, 0xFFFFFFFF));
+  clearSnapshot(copy);
+
+  TEST_ASSERT_TRUE(apply(json, copy));
+  TEST_ASSERT_EQUAL_UINT32(0, diffSnapshot(full, copy));
+}
+
+// 範囲外の数値は端に寄せ、表示の文字列があふれない
+void test_numbers_are_clamped(void) {
+  WeatherSnapshot snapshot = makeSnapshot();
+  SnapshotText    text;
+
+  TEST_ASSERT_TRUE(apply(R"({"timeSeries":[{"areas":[{"degree":-1e20,"humidity":123456789,"pressure":3.0e38}]}]})", snapshot));
+  TEST_ASSERT_EQUAL_FLOAT(SNAPSHOT_DEGREE_MIN, snapshot.degree);
+  TEST_ASSERT_EQUAL_FLOAT(SNAPSHOT_HUMIDITY_MAX, snapshot.humidity);
+  TEST_ASSERT_EQUAL_FLOAT(SNAPSHOT_PRESSURE_MAX, snapshot.pressure);
+
+  TEST_ASSERT_TRUE(formatSnapshot(snapshot, text));
+  TEST_ASSERT_EQUAL_STRING("-60.0", text.degree);
+  TEST_ASSERT_EQUAL_STRING("100", text.humidity);
+  TEST_ASSERT_EQUAL_STRING("1100.0", text.pressure);
+
+  // 寄せる前の値は入りきらない
+  snapshot.pressure = 3.0e38f;
+  TEST_ASSERT_FALSE(formatSnapshot(snapshot, text));
+  TEST_ASSERT_EQUAL(sizeof(text.pressure) - 1, strlen(text.pressure));
+}
+
+// full -> delta -> apply == full
+void test_delta_round_trip(void) {
+  WeatherSnapshot before = makeSnapshot();
+  WeatherSnapshot after  = makeSnapshot();
+
+  setSnapshotField(after.reportDatetime, "2022-05-07T05:00:00+09:00");
+  setSnapshotField(after.weatherCodes, "200");
+  setSnapshotField(after.weathersJP, "曇");
+  setSnapshotField(after.iconFile, "/200.gif");
+  after.degree     = 18.75f;
+  after.nextUpdate = 1651867500;
+
+  uint32_t fields = diffSnapshot(before, after);
+  TEST_ASSERT_EQUAL_UINT32(SNAPSHOT_FIELD(FIELD_REPORT_DATETIME) |
+                               SNAPSHOT_FIELD(FIELD_WEATHER_CODES) |
+                               SNAPSHOT_FIELD(FIELD_WEATHERS_JP) |
+                               SNAPSHOT_FIELD(FIELD_ICON) |
+                               SNAPSHOT_FIELD(FIELD_DEGREE) |
+                               SNAPSHOT_FIELD(FIELD_NEXT_UPDATE),
+                           fields);
+
+  String full;
+  String delta;
+  serializeSnapshot(after, full);
+  serializeSnapshot(after, delta, fields, 2);
+  TEST_ASSERT_LESS_THAN(full.length(), delta.length());
+
+  WeatherSnapshot view = before;
+  TEST_ASSERT_TRUE(apply(delta, view));
+  TEST_ASSERT_EQUAL_UINT32(0, diffSnapshot(after, view));
+}
+
+// 1フィールドずつ変えても、差分の適用で元に戻る
+void test_each_field_delta(void) {
+  for (int i = 0; i < (int)FIELD::FIELD_MAX; i++) {
+    WeatherSnapshot before = makeSnapshot();
+    WeatherSnapshot after  = makeSnapshot();
+
+    switch ((FIELD)i) {
+      case FIELD::FIELD_PUBLISHING_OFFICE: setSnapshotField(after.publishingOffice, "気象庁"); break;
+      case FIELD::FIELD_REPORT_DATETIME: setSnapshotField(after.reportDatetime, "x"); break;
+      case FIELD::FIELD_TIME_DEFINES: setSnapshotField(after.timeDefines, "x"); break;
+      case FIELD::FIELD_AREA: setSnapshotField(after.area, "三重県"); break;
+      case FIELD::FIELD_WEATHER_CODES: setSnapshotField(after.weatherCodes, "300"); break;
+      case FIELD::FIELD_WEATHERS_JP: setSnapshotField(after.weathersJP, "雨"); break;
+      case FIELD::FIELD_WEATHERS_EN: setSnapshotField(after.weathersEN, "RAIN"); break;
+      case FIELD::FIELD_WINDS: setSnapshotField(after.winds, ""); break;
+      case FIELD::FIELD_WAVES: setSnapshotField(after.waves, "１メートル"); break;
+      case FIELD::FIELD_ICON: setSnapshotField(after.iconFile, "/300.gif"); break;
+      case FIELD::FIELD_DEGREE: after.degree = -2.5f; break;
+      case FIELD::FIELD_HUMIDITY: after.humidity = 100.0f; break;
+      case FIELD::FIELD_PRESSURE: after.pressure = 990.0f; break;
+      case FIELD::FIELD_NEXT_UPDATE: after.nextUpdate = 0; break;
+      case FIELD::FIELD_STALE: after.stale = true; break;
+      default: break;
+    }
+
+    uint32_t fields = diffSnapshot(before, after);
+    TEST_ASSERT_EQUAL_UINT32(1u << i, fields);
+
+    String delta;
+    serializeSnapshot(after, delta, fields, 2);
+
+    WeatherSnapshot view = before;
+    TEST_ASSERT_TRUE(apply(delta, view));
+    TEST_ASSERT_EQUAL_UINT32(0, diffSnapshot(after, view));
+  }
+}
+
+// 差分でない文書に地域が無ければ、壊れた文書として扱う
+void test_full_without_area_is_rejected(void) {
+  WeatherSnapshot view = makeSnapshot();
+
+  TEST_ASSERT_FALSE(apply("{\"publishingOffice\":\"x\"}", view));
+  TEST_ASSERT_EQUAL_UINT32(0, diffSnapshot(makeSnapshot(), view));
+}
+
+static const uint32_t BASE = 0x12340000;
+
+void test_since_without_revision_gets_full(void) {
+  SnapshotRevisions revisions(BASE);
+
+  TEST_ASSERT_EQUAL_UINT32(SNAPSHOT_ALL_FIELDS, revisions.fieldsSince(0));
+
+  // 起動直後の版が0でも、sinceの無い要求を変更なしにしない
+  SnapshotRevisions zero(0);
+  TEST_ASSERT_EQUAL_UINT32(SNAPSHOT_ALL_FIELDS, zero.fieldsSince(0));
+}
+
+// 前の起動の版。この起動の版より小さくても大きくても全部を送る
+void test_since_from_another_boot_gets_full(void) {
+  SnapshotRevisions revisions(BASE);
+  revisions.publish(SNAPSHOT_ALL_FIELDS);
+  revisions.publish(SNAPSHOT_FIELD(FIELD_DEGREE));
+
+  TEST_ASSERT_EQUAL_UINT32(SNAPSHOT_ALL_FIELDS, revisions.fieldsSince(BASE - 1));
+  TEST_ASSERT_EQUAL_UINT32(SNAPSHOT_ALL_FIELDS, revisions.fieldsSince(BASE));
+  TEST_ASSERT_EQUAL_UINT32(SNAPSHOT_ALL_FIELDS, revisions.fieldsSince(BASE + 3));
+  TEST_ASSERT_EQUAL_UINT32(SNAPSHOT_ALL_FIELDS, revisions.fieldsSince(0xFFFFFFFF));
+}
+
+void test_since_at_revision_is_not_modified(void) {
+  SnapshotRevisions revisions(BASE);
+
+  TEST_ASSERT_EQUAL_UINT32(0, revisions.fieldsSince(BASE));
+
+  revisions.publish(SNAPSHOT_ALL_FIELDS);
+  TEST_ASSERT_EQUAL_UINT32(BASE + 1, revisions.revision());
+  TEST_ASSERT_EQUAL_UINT32(0, revisions.fieldsSince(BASE + 1));
+
+  // 何も変わっていなければ版は進まない
+  revisions.publish(0);
+  TEST_ASSERT_EQUAL_UINT32(BASE + 1, revisions.revision());
+}
+
+// 間の版には、それ以降に変わったフィールドだけを送る
+void test_since_in_between_gets_changed_fields(void) {
+  SnapshotRevisions revisions(BASE);
+
+  revisions.publish(SNAPSHOT_ALL_FIELDS);                                             // BASE + 1
+  revisions.publish(SNAPSHOT_FIELD(FIELD_DEGREE) | SNAPSHOT_FIELD(FIELD_HUMIDITY));  // BASE + 2
+  revisions.publish(SNAPSHOT_FIELD(FIELD_DEGREE));                                   // BASE + 3
+  revisions.publish(SNAPSHOT_FIELD(FIELD_STALE));                                    // BASE + 4
+
+  TEST_ASSERT_EQUAL_UINT32(SNAPSHOT_FIELD(FIELD_DEGREE) | SNAPSHOT_FIELD(FIELD_HUMIDITY) | SNAPSHOT_FIELD(FIELD_STALE),
+                           revisions.fieldsSince(BASE + 1));
+  TEST_ASSERT_EQUAL_UINT32(SNAPSHOT_FIELD(FIELD_DEGREE) | SNAPSHOT_FIELD(FIELD_STALE),
+                           revisions.fieldsSince(BASE + 2));
+  TEST_ASSERT_EQUAL_UINT32(SNAPSHOT_FIELD(FIELD_STALE), revisions.fieldsSince(BASE + 3));
+  TEST_ASSERT_EQUAL_UINT32(0, revisions.fieldsSince(BASE + 4));
+}
+
+// 版を進めながら差分を送り、どの版のViewも最新と同じになる
+void test_delta_chain_converges(void) {
+  SnapshotRevisions revisions(BASE);
+  WeatherSnapshot   published;
+  WeatherSnapshot   history[4];
+
+  clearSnapshot(published);
+  history[0] = makeSnapshot();
+  history[1] = history[0];
+  history[1].degree = 24.0f;
+  history[2] = history[1];
+  setSnapshotField(history[2].weathersEN, "CLOUDY");
+  history[2].stale = true;
+  history[3] = history[2];
+  history[3].stale    = false;
+  history[3].humidity = 70.0f;
+
+  for (const auto &next : history) {
+    revisions.publish(diffSnapshot(published, next));
+    published = next;
+  }
+
+  for (int held = 0; held < 4; held++) {
+    WeatherSnapshot view   = history[held];
+    uint32_t        fields = revisions.fieldsSince(BASE + 1 + held);
+    String          json;
+
+    if (fields == 0) {
+      TEST_ASSERT_EQUAL_INT(3, held);
+      continue;
+    }
+
+    serializeSnapshot(published, json, fields, revisions.revision());
+    TEST_ASSERT_TRUE(apply(json, view));
+    TEST_ASSERT_EQUAL_UINT32(0, diffSnapshot(published, view));
+  }
+}
+
+int main(int argc, char **argv) {
+  UNITY_BEGIN();
+  RUN_TEST(test_full_round_trip);
+  RUN_TEST(test_longest_snapshot_fits);
+  RUN_TEST(test_stale_round_trip);
+  RUN_TEST(test_numbers_are_clamped);
+  RUN_TEST(test_delta_round_trip);
+  RUN_TEST(test_each_field_delta);
+  RUN_TEST(test_full_without_area_is_rejected);
+  RUN_TEST(test_since_without_revision_gets_full);
+  RUN_TEST(test_since_from_another_boot_gets_full);
+  RUN_TEST(test_since_at_revision_is_not_modified);
+  RUN_TEST(test_since_in_between_gets_changed_fields);
+  RUN_TEST(test_delta_chain_converges);
+  return UNITY_END();
+}
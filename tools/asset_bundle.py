@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+# MIT License
+#
+# Copyright (c) 2021-2022 riraosan.github.io
+#
+# data/ のファイルを1つの束にまとめ、assetsパーティションへ書き込む。
+# 読み出しは src/AssetBundle.cpp。形式はすべてリトルエンディアンで
+#   ヘッダ  magic "ATAB", version(u16), count(u16), size(u32), reserved(u32)
+#   索引    name[44], offset, size, rawSize, flags, crc32 (u32) を名前順にcount個
+#   データ  4バイト境界に揃えて並ぶ。flagsのbit0が立っていればzlibで圧縮
+#
+#   python3 tools/asset_bundle.py pack data assets.bin --compress "*.json"
+#   python3 tools/asset_bundle.py list assets.bin
+#   python3 tools/asset_bundle.py extract assets.bin /codes.json > codes.json
+#   python3 tools/asset_bundle.py verify assets.bin data
+#
+# extra_scripts から読み込むと buildassets と uploadassets のターゲットを加える。
+#   pio run -t uploadassets
+
+import argparse
+import csv
+import fnmatch
+import os
+import struct
+import sys
+import zlib
+
+MAGIC = b"ATAB"
+VERSION = 1
+HEADER = struct.Struct("<4sHHII")
+ENTRY = struct.Struct("<44sIIIII")
+FLAG_DEFLATE = 0x01
+ALIGN = 4
+
+
+def align(value):
+    return (value + ALIGN - 1) // ALIGN * ALIGN
+
+
+def collect(source):
+    files = []
+    for root, _, names in os.walk(source):
+        for name in names:
+            path = os.path.join(root, name)
+            asset = "/" + os.path.relpath(path, source).replace(os.sep, "/")
+            files.append((asset, path))
+
+    # 名前順。ESP32側は二分探索する
+    return sorted(files, key=lambda item: item[0].encode("utf-8"))
+
+
+def pack(source, output, compress=(), limit=0):
+    files = collect(source)
+    offset = align(HEADER.size + ENTRY.size * len(files))
+
+    entries = []
+    blobs = []
+    for name, path in files:
+        encoded = name.encode("utf-8")
+        if len(encoded) >= 44:
+            raise ValueError(f"{name}: name too long")
+
+        with open(path, "rb") as file:
+            raw = file.read()
+
+        data = raw
+        flags = 0
+        if any(fnmatch.fnmatch(name, pattern) for pattern in compress):
+            packed = zlib.compress(raw, 9)
+            if len(packed) < len(raw):
+                data = packed
+                flags |= FLAG_DEFLATE
+
+        entries.append(ENTRY.pack(encoded, offset, len(data), len(raw), flags, zlib.crc32(raw)))
+        blobs.append((offset, data))
+        offset = align(offset + len(data))
+
+    size = blobs[-1][0] + len(blobs[-1][1]) if blobs else offset
+    if limit and size > limit:
+        raise ValueError(f"bundle is {size} bytes, partition is {limit} bytes")
+
+    image = bytearray(size)
+    image[0:HEADER.size] = HEADER.pack(MAGIC, VERSION, len(entries), size, 0)
+    for i, entry in enumerate(entries):
+        start = HEADER.size + i * ENTRY.size
+        image[start:start + ENTRY.size] = entry
+    for start, data in blobs:
+        image[start:start + len(data)] = data
+
+    with open(output, "wb") as file:
+        file.write(image)
+
+    return len(entries), size
+
+
+class Bundle:
+    """On-host reader. Applies the same checks as AssetBundle::begin()."""
+
+    def __init__(self, path):
+        with open(path, "rb") as file:
+            self.image = file.read()
+
+        magic, version, count, size, _ = HEADER.unpack_from(self.image, 0)
+        if magic != MAGIC or version != VERSION:
+            raise ValueError(f"{path}: not an asset bundle")
+        if size > len(self.image):
+            raise ValueError(f"{path}: truncated")
+
+        self.entries = []
+        index = HEADER.size + count * ENTRY.size
+        previous = b""
+        for i in range(count):
+            name, offset, stored, raw, flags, crc = ENTRY.unpack_from(self.image, HEADER.size + i * ENTRY.size)
+            name = name.split(b"\0", 1)[0]
+            if offset < index or offset % ALIGN or offset + stored > size or name <= previous:
+                raise ValueError(f"{path}: broken entry {name!r}")
+            previous = name
+            self.entries.append((name.decode("utf-8"), offset, stored, raw, flags, crc))
+
+    def find(self, name):
+        for entry in self.entries:
+            if entry[0] == name:
+                return entry
+        return None
+
+    def read(self, name):
+        entry = self.find(name)
+        if entry is None:
+            raise KeyError(name)
+
+        _, offset, stored, raw, flags, crc = entry
+        data = self.image[offset:offset + stored]
+        if flags & FLAG_DEFLATE:
+            data = zlib.decompress(data)
+        if len(data) != raw or zlib.crc32(data) != crc:
+            raise ValueError(f"{name}: crc mismatch")
+        return data
+
+
+def partition(csv_path, label):
+    with open(csv_path, encoding="utf-8") as file:
+        for row in csv.reader(line for line in file if not line.lstrip().startswith("#")):
+            row = [column.strip() for column in row]
+            if row and row[0] == label:
+                return int(row[3], 0), int(row[4], 0)
+    raise ValueError(f"{label} not found in {csv_path}")
+
+
+def targets(env):
+    project = env.subst("$PROJECT_DIR")
+    table = os.path.join(project, env.GetProjectOption("board_build.partitions", "partitions_assets.csv"))
+    if not os.path.isfile(table):
+        return
+
+    try:
+        offset, limit = partition(table, "assets")
+    except ValueError:
+        return
+
+    source = os.path.join(project, env.GetProjectOption("custom_assets_dir", "data"))
+    compress = env.GetProjectOption("custom_assets_compress", "").split()
+    bundle = os.path.join(env.subst("$BUILD_DIR"), "assets.bin")
+
+    def build(*args, **kwargs):
+        count, size = pack(source, bundle, compress, limit)
+        print(f"asset_bundle: {count} assets, {size} of {limit} bytes")
+
+    env.AddCustomTarget(
+        name="buildassets",
+        dependencies=None,
+        actions=[build],
+        title="Build Assets",
+        description="Pack data/ into the assets partition image")
+
+    port = ' --port "$UPLOAD_PORT"' if env.subst("$UPLOAD_PORT") else ""
+    env.AddCustomTarget(
+        name="uploadassets",
+        dependencies=None,
+        actions=[build, f'"$PYTHONEXE" "$UPLOADER" --chip esp32{port} --baud $UPLOAD_SPEED '
+                        f'write_flash 0x{offset:x} "{bundle}"'],
+        title="Upload Assets",
+        description="Write the asset bundle to the assets partition")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    command = commands.add_parser("pack", help="pack a directory")
+    command.add_argument("source")
+    command.add_argument("output")
+    command.add_argument("--compress", action="append", default=[], help="glob of names to deflate")
+    command.add_argument("--limit", type=lambda value: int(value, 0), default=0, help="partition size")
+
+    command = commands.add_parser("list", help="list assets")
+    command.add_argument("bundle")
+
+    command = commands.add_parser("extract", help="write one asset to stdout")
+    command.add_argument("bundle")
+    command.add_argument("name")
+
+    command = commands.add_parser("verify", help="compare a bundle with its source directory")
+    command.add_argument("bundle")
+    command.add_argument("source")
+
+    args = parser.parse_args()
+
+    try:
+        if args.command == "pack":
+            count, size = pack(args.source, args.output, args.compress, args.limit)
+            print(f"{count} assets, {size} bytes")
+        elif args.command == "list":
+            for name, offset, stored, raw, flags, _ in Bundle(args.bundle).entries:
+                mark = "deflate" if flags & FLAG_DEFLATE else "stored"
+                print(f"{offset:8d} {stored:8d} {raw:8d} {mark:8} {name}")
+        elif args.command == "extract":
+            sys.stdout.buffer.write(Bundle(args.bundle).read(args.name))
+        elif args.command == "verify":
+            bundle = Bundle(args.bundle)
+            files = collect(args.source)
+            if [name for name, _ in files] != [entry[0] for entry in bundle.entries]:
+                sys.exit("asset names differ")
+            for name, path in files:
+                with open(path, "rb") as file:
+                    if bundle.read(name) != file.read():
+                        sys.exit(f"{name} differs")
+            print(f"{len(files)} assets ok")
+    except (OSError, ValueError, KeyError) as error:
+        sys.exit(f"asset_bundle: {error}")
+
+
+if __name__ == "__main__":
+    main()
+else:
+    Import("env")  # noqa: F821
+    targets(env)  # noqa: F821
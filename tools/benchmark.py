@@ -0,0 +1,88 @@
+#!/usr/bin/env python3
+# MIT License
+#
+# Copyright (c) 2021-2022 riraosan.github.io
+#
+# env:benchmark のシリアル出力から結果のJSONを取り出し、前回の結果と比べる。
+# env:native_benchmark (pio test -v の出力) も同じ形なので、そのまま読める。
+#
+#   python3 tools/benchmark.py bench.log > result.json
+#   python3 tools/benchmark.py bench.log --baseline baseline.json --threshold 10
+#   python3 tools/benchmark.py bench_native.log --baseline device.json
+#
+# 中央値が threshold [%] 以上遅くなったケースか、確保回数が増えたケースがあれば
+# 終了コード1で終わる。実機とホストのように platform が違う時は、並べて表示するだけで
+# 失敗にはしない(時間もStringの確保回数も、そのままでは比べられない)。
+
+import argparse
+import json
+import sys
+
+
+def extract(path):
+    with open(path, encoding="utf-8", errors="replace") as file:
+        lines = file.read().splitlines()
+
+    inside = False
+    for line in lines:
+        line = line.strip()
+        if line == "BENCHMARK_BEGIN":
+            inside = True
+        elif inside and line.startswith("{"):
+            return json.loads(line)
+    raise SystemExit(f"no benchmark result in {path}")
+
+
+def compare(result, baseline, threshold):
+    previous = {case["name"]: case for case in baseline["cases"]}
+    regressed = False
+
+    # platformが無いのは実機の古い結果
+    platform = result.get("platform", "esp32")
+    before_platform = baseline.get("platform", "esp32")
+    cross = platform != before_platform
+    if cross:
+        print(f"platform: {before_platform} -> {platform}. shown for reference only", file=sys.stderr)
+
+    print(f"{'case':28} {'median':>10} {'before':>10} {'change':>8} {'allocs':>8}", file=sys.stderr)
+    for case in result["cases"]:
+        before = previous.get(case["name"])
+        if before is None:
+            print(f"{case['name']:28} {case['median']:>8}us {'-':>10} {'new':>8} {case['allocsPerOp']:>8.1f}",
+                  file=sys.stderr)
+            continue
+
+        change = (case["median"] - before["median"]) * 100 / max(before["median"], 1)
+        mark = ""
+        if cross:
+            pass
+        elif change >= threshold or case["allocsPerOp"] > before["allocsPerOp"]:
+            mark = " <"
+            regressed = True
+
+        print(f"{case['name']:28} {case['median']:>8}us {before['median']:>8}us {change:>+7.1f}% "
+              f"{case['allocsPerOp']:>8.1f}{mark}", file=sys.stderr)
+
+    return regressed
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("log", help="serial log of env:benchmark")
+    parser.add_argument("--baseline", help="result JSON of a previous release")
+    parser.add_argument("--threshold", type=float, default=10.0, help="allowed slowdown of the median [%%]")
+    args = parser.parse_args()
+
+    result = extract(args.log)
+    json.dump(result, sys.stdout, indent=2, ensure_ascii=False)
+    print()
+
+    if args.baseline:
+        with open(args.baseline, encoding="utf-8") as file:
+            baseline = json.load(file)
+        if compare(result, baseline, args.threshold):
+            sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
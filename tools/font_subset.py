@@ -0,0 +1,222 @@
+#!/usr/bin/env python3
+# MIT License
+#
+# Copyright (c) 2021-2022 riraosan.github.io
+#
+# efontのグリフから、画面に出る文字だけを抜き出したefontFontData.h互換のヘッダを作る。
+# LovyanGFXの fonts::efont は efontFontList/efontFontData をそのまま使うので、
+# Display側は読み込むヘッダを替えるだけでよい(src/Font.h)。
+#
+# platformio.ini の extra_scripts = pre:tools/font_subset.py から呼ばれ、
+# $BUILD_DIR/font/efontSubset.h を作って -D FONT_SUBSET を加える。
+# 使う文字は data/codes.json、custom_font_chars のファイルと、custom_font_corpus の
+# 気象庁の予報(tools/jma_corpus.py が取ってきた NNNNNN.json)から集める。
+# 元のフォントに無い文字があれば、ビルドを止める。
+#
+# 単体でも動く。
+#   python3 tools/font_subset.py --font .pio/libdeps/atomview/efont/src/efontFontData.h \
+#       --chars tools/font_chars.txt --codes data/codes.json --corpus test/corpus/jma -o efontSubset.h
+
+import argparse
+import json
+import os
+import re
+import sys
+
+LIST_NAME = "efontFontList"
+DATA_NAME = "efontFontData"
+
+# 予報の中で、文字列を画面に出す項目。area は {"name": ...} の形
+CORPUS_KEYS = ("publishingOffice", "weathers", "winds", "waves", "name")
+# tools/jma_corpus.py が書く名前。崩れた入力(ファジングの種)は読まない
+CORPUS_NAME = re.compile(r"^\d{6}\.json$")
+
+
+def strip_comments(text):
+    text = re.sub(r"/\*.*?\*/", "", text, flags=re.S)
+    return re.sub(r"//[^\n]*", "", text)
+
+
+def parse_array(text, name):
+    match = re.search(r"\b" + name + r"\s*\[\s*\]\s*=\s*\{(.*?)\};", text, flags=re.S)
+    if match is None:
+        raise ValueError(f"{name} not found")
+
+    body = match.group(1)
+    # フォントの種類ごとの #if で囲まれている。全部を候補にする
+    if re.search(r"^\s*#\s*(else|elif)\b", body, flags=re.M):
+        raise ValueError(f"{name} has #else/#elif, unsupported layout")
+    body = re.sub(r"^\s*#[^\n]*", "", body, flags=re.M)
+
+    return [int(value, 0) for value in re.findall(r"0[xX][0-9a-fA-F]+|\d+", body)]
+
+
+def load_font(path):
+    with open(path, encoding="utf-8", errors="replace") as file:
+        raw = file.read()
+
+    guard = re.search(r"#\s*ifndef\s+(\w+)\s*\n\s*#\s*define\s+\1", raw)
+    text = strip_comments(raw)
+    codes = parse_array(text, LIST_NAME)
+    data = parse_array(text, DATA_NAME)
+
+    if not codes or len(data) % len(codes):
+        raise ValueError(f"{len(data)} bytes of glyphs for {len(codes)} codes")
+
+    stride = len(data) // len(codes)
+    glyphs = {code: data[i * stride:(i + 1) * stride] for i, code in enumerate(codes)}
+
+    return glyphs, stride, guard.group(1) if guard else "__EFONT_FONT_DATA_H__"
+
+
+def walk_strings(value, keys=None, picked=False):
+    if isinstance(value, str):
+        if picked:
+            yield value
+    elif isinstance(value, dict):
+        for key, item in value.items():
+            if keys is None:
+                yield key
+            yield from walk_strings(item, keys, picked or keys is None or key in keys)
+    elif isinstance(value, list):
+        for item in value:
+            yield from walk_strings(item, keys, picked)
+
+
+def corpus_files(corpus_dir):
+    if not corpus_dir or not os.path.isdir(corpus_dir):
+        return []
+    return sorted(os.path.join(corpus_dir, name) for name in os.listdir(corpus_dir) if CORPUS_NAME.match(name))
+
+
+def collect_chars(chars_path, codes_path, corpus_dir=None):
+    chars = {chr(c) for c in range(0x20, 0x7F)}
+
+    if codes_path:
+        with open(codes_path, encoding="utf-8") as file:
+            for text in walk_strings(json.load(file)):
+                chars.update(text)
+
+    for path in corpus_files(corpus_dir):
+        with open(path, encoding="utf-8") as file:
+            for text in walk_strings(json.load(file), CORPUS_KEYS):
+                chars.update(text)
+
+    if chars_path:
+        with open(chars_path, encoding="utf-8") as file:
+            for line in file:
+                line = line.rstrip("\r\n")
+                if not line.startswith("#"):
+                    chars.update(line)
+
+    return chars
+
+
+def write_header(path, guard, glyphs, stride, sources):
+    codes = sorted(glyphs)
+
+    lines = [
+        "// tools/font_subset.py が生成。編集しないこと",
+        f"// {len(codes)} glyphs, {len(codes) * stride} bytes from {', '.join(sources)}",
+        "",
+        f"#ifndef {guard}",
+        f"#define {guard}",
+        "",
+        "#include <Arduino.h>",
+        "",
+        f"const PROGMEM uint16_t {LIST_NAME}[] = {{",
+    ]
+    for i in range(0, len(codes), 12):
+        lines.append("  " + ", ".join(f"0x{code:04x}" for code in codes[i:i + 12]) + ",")
+    lines.append("};")
+    lines.append("")
+    lines.append(f"const PROGMEM uint8_t {DATA_NAME}[] = {{")
+    for code in codes:
+        glyph = glyphs[code]
+        # 行末の \ は次の行をコメントにしてしまう
+        label = chr(code) if code > 0x20 and code != 0x5C else ""
+        lines.append(f"  // 0x{code:04x} {label}".rstrip())
+        for i in range(0, len(glyph), 16):
+            lines.append("  " + ", ".join(f"0x{byte:02x}" for byte in glyph[i:i + 16]) + ",")
+    lines.append("};")
+    lines.append("")
+    lines.append("#endif")
+    lines.append("")
+
+    os.makedirs(os.path.dirname(os.path.abspath(path)), exist_ok=True)
+    with open(path, "w", encoding="utf-8") as file:
+        file.write("\n".join(lines))
+
+
+def subset(font_path, chars_path, codes_path, output, corpus_dir=None):
+    glyphs, stride, guard = load_font(font_path)
+    chars = collect_chars(chars_path, codes_path, corpus_dir)
+
+    # 元のフォントに無い文字は描けない
+    missing = sorted(c for c in chars if ord(c) not in glyphs)
+    if missing:
+        listing = " ".join(f"{c}(U+{ord(c):04X})" for c in missing)
+        raise ValueError(f"{len(missing)} glyphs missing in {os.path.basename(font_path)}: {listing}")
+
+    picked = {ord(c): glyphs[ord(c)] for c in chars}
+    sources = [os.path.basename(p) for p in (codes_path, chars_path) if p]
+    if corpus_files(corpus_dir):
+        sources.append(f"{len(corpus_files(corpus_dir))} forecasts")
+    write_header(output, guard, picked, stride, sources)
+
+    return len(picked), len(picked) * stride, len(glyphs) * stride
+
+
+def find_font(libdeps):
+    for root, _, files in os.walk(libdeps):
+        if "efontFontData.h" in files:
+            return os.path.join(root, "efontFontData.h")
+    return None
+
+
+def build(env):
+    project = env.subst("$PROJECT_DIR")
+    libdeps = os.path.join(env.subst("$PROJECT_LIBDEPS_DIR"), env.subst("$PIOENV"))
+    output = os.path.join(env.subst("$BUILD_DIR"), "font", "efontSubset.h")
+
+    chars = os.path.join(project, env.GetProjectOption("custom_font_chars", "tools/font_chars.txt"))
+    codes = os.path.join(project, env.GetProjectOption("custom_font_codes", "data/codes.json"))
+    corpus = os.path.join(project, env.GetProjectOption("custom_font_corpus", "test/corpus/jma"))
+
+    font = find_font(libdeps)
+    if font is None:
+        print("font_subset: efontFontData.h not found, using the full font")
+        return
+
+    try:
+        glyphs, size, full = subset(font, chars, codes, output, corpus)
+    except (OSError, ValueError) as error:
+        sys.stderr.write(f"font_subset: {error}\n")
+        env.Exit(1)
+
+    print(f"font_subset: {glyphs} glyphs, {size} of {full} bytes")
+    env.Append(CPPPATH=[os.path.dirname(output)], CPPDEFINES=["FONT_SUBSET"])
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--font", required=True, help="efontFontData.h of the efont library")
+    parser.add_argument("--chars", default="tools/font_chars.txt")
+    parser.add_argument("--codes", default="data/codes.json")
+    parser.add_argument("--corpus", default="test/corpus/jma", help="forecasts from tools/jma_corpus.py")
+    parser.add_argument("-o", "--output", default="efontSubset.h")
+    args = parser.parse_args()
+
+    try:
+        glyphs, size, full = subset(args.font, args.chars, args.codes, args.output, args.corpus)
+    except (OSError, ValueError) as error:
+        sys.exit(f"font_subset: {error}")
+
+    print(f"{glyphs} glyphs, {size} of {full} bytes")
+
+
+if __name__ == "__main__":
+    main()
+else:
+    Import("env")  # noqa: F821
+    build(env)  # noqa: F821
@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+# MIT License
+#
+# Copyright (c) 2021-2022 riraosan.github.io
+#
+# 気象庁の予報(forecast/data/forecast/NNNNNN.json)を取ってきて、test/corpus/jma に置く。
+# ファジング(test/fuzz)の種と、フォントの文字の一覧(tools/font_subset.py)に使う。
+#
+#   python3 tools/jma_corpus.py                 # すべての府県予報区
+#   python3 tools/jma_corpus.py 270000 240000   # 指定した予報区だけ
+#
+# 毎日の発表で文言が変わるので、時々取り直して増やしていく。
+
+import argparse
+import json
+import os
+import sys
+import time
+import urllib.request
+
+AREA = "https://www.jma.go.jp/bosai/common/const/area.json"
+FORECAST = "https://www.jma.go.jp/bosai/forecast/data/forecast/{}.json"
+
+
+def fetch(url):
+    request = urllib.request.Request(url, headers={"User-Agent": "ESP32_ATOM_View corpus"})
+    with urllib.request.urlopen(request, timeout=30) as response:
+        return response.read()
+
+
+def offices():
+    return sorted(json.loads(fetch(AREA))["offices"].keys())
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("codes", nargs="*", help="府県予報区のコード。省略するとすべて")
+    parser.add_argument("--out", default=os.path.join(os.path.dirname(__file__), "..", "test", "corpus", "jma"))
+    parser.add_argument("--wait", type=float, default=1.0, help="取得の間隔 [s]")
+    args = parser.parse_args()
+
+    os.makedirs(args.out, exist_ok=True)
+
+    for code in args.codes or offices():
+        try:
+            data = fetch(FORECAST.format(code))
+        except OSError as error:
+            print(f"{code}: {error}", file=sys.stderr)
+            continue
+
+        # 読めない応答も種として残す
+        with open(os.path.join(args.out, f"{code}.json"), "wb") as file:
+            file.write(data)
+
+        print(f"{code}: {len(data)} bytes")
+        time.sleep(args.wait)
+
+
+if __name__ == "__main__":
+    main()
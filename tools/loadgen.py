@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+# MIT License
+#
+# Copyright (c) 2021-2022 riraosan.github.io
+#
+# ATOM Docの /api/v1/weather.json に、多数のATOM Viewが同時に取りに来る状況を再現する。
+#
+#   python3 tools/loadgen.py --host atom_doc.local --views 50 --rounds 5
+#
+# 各Viewは同じ時刻に一斉に要求し、前回のETagをIf-None-Matchで送る。
+# ステータスごとの件数と応答時間(p50/p99/max)と、最後に /api/v1/limits.json を表示する。
+#
+# 実機が無くても、ホストでビルドした同じハンドラ(test/loadgen/doc_api_server.cpp)を相手にできる。
+# Docはクライアントごとに制限するので、--spread-sources でViewごとに 127.0.0.N から接続する。
+#
+#   ./doc_api_server --port 8080 --service-ms 20
+#   python3 tools/loadgen.py --host 127.0.0.1 --port 8080 --views 60 --spread-sources
+
+import argparse
+import http.client
+import json
+import statistics
+import threading
+import time
+from collections import Counter
+
+
+def view(host, port, path, rounds, period, source, barrier, results, lock):
+    etag = None
+
+    for _ in range(rounds):
+        barrier.wait()
+
+        headers = {"If-None-Match": etag} if etag else {}
+        start = time.monotonic()
+        try:
+            conn = http.client.HTTPConnection(host, port, timeout=10, source_address=source)
+            conn.request("GET", path, headers=headers)
+            response = conn.getresponse()
+            body = response.read()
+            status = response.status
+            etag = response.getheader("ETag", etag)
+            conn.close()
+        except OSError as error:
+            status = type(error).__name__
+            body = b""
+        elapsed = (time.monotonic() - start) * 1000
+
+        with lock:
+            results.append((status, elapsed, len(body)))
+
+        time.sleep(period)
+
+
+def stats(host, port):
+    try:
+        conn = http.client.HTTPConnection(host, port, timeout=10)
+        conn.request("GET", "/api/v1/limits.json")
+        response = conn.getresponse()
+        body = response.read()
+        conn.close()
+    except OSError:
+        return None
+    if response.status != 200:
+        return None
+    return json.loads(body)
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument("--host", default="atom_doc.local")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--path", default="/api/v1/weather.json")
+    parser.add_argument("--views", type=int, default=50)
+    parser.add_argument("--rounds", type=int, default=5)
+    parser.add_argument("--period", type=float, default=2.0, help="seconds between rounds")
+    parser.add_argument("--spread-sources", action="store_true",
+                        help="connect from 127.0.0.2, 127.0.0.3, ... (one address per view, loopback only)")
+    args = parser.parse_args()
+
+    barrier = threading.Barrier(args.views)
+    results = []
+    lock = threading.Lock()
+
+    threads = [
+        threading.Thread(target=view,
+                         args=(args.host, args.port, args.path, args.rounds, args.period,
+                               (f"127.0.{(i + 2) // 256}.{(i + 2) % 256}", 0) if args.spread_sources else None,
+                               barrier, results, lock))
+        for i in range(args.views)
+    ]
+
+    start = time.monotonic()
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    total = time.monotonic() - start
+
+    statuses = Counter(status for status, _, _ in results)
+    elapsed = [ms for _, ms, _ in results]
+    received = sum(size for _, _, size in results)
+
+    print(f"{len(results)} requests from {args.views} views in {total:.1f} s, {received} bytes")
+    for status, count in sorted(statuses.items(), key=lambda item: str(item[0])):
+        print(f"  {status}: {count}")
+    print(f"  latency p50 {percentile(elapsed, 50):.0f} ms, p99 {percentile(elapsed, 99):.0f} ms, "
+          f"max {max(elapsed, default=0):.0f} ms, mean {statistics.mean(elapsed) if elapsed else 0:.0f} ms")
+
+    limits = stats(args.host, args.port)
+    if limits:
+        print("  server " + ", ".join(f"{key} {value}" for key, value in limits.items()))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,87 @@
+#!/usr/bin/env python3
+# MIT License
+#
+# Copyright (c) 2021-2022 riraosan.github.io
+#
+# ATOM_RECORD で保存した受信記録(src/Replay.hpp)を扱う。
+#
+#   python3 tools/replay.py dump replay_jma.bin
+#   python3 tools/replay.py body replay_jma.bin > jma.http
+#   python3 tools/replay.py make jma.http data/replay_jma.bin --rate 200000
+#
+# make は生のHTTP応答(ヘッダ込み)から記録を作る。data/ に置けば uploadfs で
+# ATOM_REPLAY 用のファイルとして書き込める。test/corpus/replay に置いた記録は
+# ホストのテスト(test/test_replay)が読む。
+
+import argparse
+import struct
+import sys
+
+RECORD = struct.Struct("<IH")
+
+
+def records(path):
+    with open(path, "rb") as file:
+        data = file.read()
+
+    position = 0
+    while position + RECORD.size <= len(data):
+        offset, length = RECORD.unpack_from(data, position)
+        position += RECORD.size
+        yield offset, data[position:position + length]
+        position += length
+
+
+def dump(args):
+    total = 0
+    last = 0
+    for offset, data in records(args.capture):
+        total += len(data)
+        last = offset
+        print(f"{offset:8d} ms {len(data):5d} bytes")
+    print(f"{total} bytes in {last} ms")
+
+
+def body(args):
+    for _, data in records(args.capture):
+        sys.stdout.buffer.write(data)
+
+
+def make(args):
+    with open(args.response, "rb") as file:
+        data = file.read()
+
+    with open(args.capture, "wb") as file:
+        for position in range(0, len(data), args.chunk):
+            chunk = data[position:position + args.chunk]
+            offset = args.latency + int(position * 1000 / args.rate) if args.rate else args.latency
+            file.write(RECORD.pack(offset, len(chunk)))
+            file.write(chunk)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    commands = parser.add_subparsers(dest="command", required=True)
+
+    command = commands.add_parser("dump", help="list records")
+    command.add_argument("capture")
+    command.set_defaults(func=dump)
+
+    command = commands.add_parser("body", help="write the raw response to stdout")
+    command.add_argument("capture")
+    command.set_defaults(func=body)
+
+    command = commands.add_parser("make", help="build a capture from a raw HTTP response")
+    command.add_argument("response")
+    command.add_argument("capture")
+    command.add_argument("--chunk", type=int, default=512, help="bytes per record (REPLAY_CHUNK_SIZE)")
+    command.add_argument("--latency", type=int, default=0, help="ms before the first byte")
+    command.add_argument("--rate", type=int, default=0, help="bytes per second, 0 for no pacing")
+    command.set_defaults(func=make)
+
+    args = parser.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()